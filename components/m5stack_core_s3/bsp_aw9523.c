@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * AW9523 shadow registers
+ *
+ * The cache covers registers 0x02 to 0x11. A register is valid after it was written or read, a partial
+ * update of an invalid register reads it first. The bytes to write are always consecutive, so one
+ * transaction with the auto-incremented register address writes a whole port pair.
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+#include "bsp_aw9523.h"
+
+static const char *TAG = "M5Stack";
+
+#define BSP_AW9523_CACHE_FIRST  (BSP_AW9523_REG_OUTPUT)
+#define BSP_AW9523_CACHE_LAST   (BSP_AW9523_REG_GCR)
+#define BSP_AW9523_CACHE_SIZE   (BSP_AW9523_CACHE_LAST - BSP_AW9523_CACHE_FIRST + 1)
+
+typedef struct {
+    SemaphoreHandle_t lock;
+    const bsp_aw9523_bus_t *bus;
+    uint8_t regs[BSP_AW9523_CACHE_SIZE];
+    uint32_t valid;                 /* Bit per cached register */
+} bsp_aw9523_ctx_t;
+
+static bsp_aw9523_ctx_t aw9523;
+
+esp_err_t bsp_aw9523_init(const bsp_aw9523_bus_t *bus)
+{
+    if (aw9523.lock == NULL) {
+        aw9523.lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(aw9523.lock, ESP_ERR_NO_MEM, TAG, "Not enough memory for AW9523 lock");
+    }
+    aw9523.bus = bus;
+    return ESP_OK;
+}
+
+void bsp_aw9523_invalidate(void)
+{
+    /* Nothing is cached before init */
+    if (aw9523.lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(aw9523.lock, portMAX_DELAY);
+    aw9523.valid = 0;
+    xSemaphoreGive(aw9523.lock);
+}
+
+esp_err_t bsp_aw9523_read(bsp_i2c_lane_t lane, uint8_t reg, uint8_t *val)
+{
+    ESP_RETURN_ON_FALSE(aw9523.bus, ESP_ERR_INVALID_STATE, TAG, "AW9523 is not initialized");
+    return aw9523.bus->read_regs(lane, BSP_AW9523_ADDR, reg, val, 1);
+}
+
+static esp_err_t bsp_aw9523_update_locked(bsp_i2c_lane_t lane, uint8_t reg, uint16_t mask, uint16_t val)
+{
+    const bool pair = (reg != BSP_AW9523_REG_GCR);
+    const int first = reg - BSP_AW9523_CACHE_FIRST;
+    const int count = pair ? 2 : 1;
+    uint8_t next[2];
+    int write_from = -1;
+    int write_to = -1;
+
+    /* Partially updated registers must be known, they are read in one transaction */
+    int read_from = -1;
+    int read_to = -1;
+    for (int i = 0; i < count; i++) {
+        const uint8_t byte_mask = mask >> (8 * i);
+        if (byte_mask != 0 && byte_mask != 0xFF && !(aw9523.valid & (1U << (first + i)))) {
+            read_from = (read_from < 0) ? i : read_from;
+            read_to = i;
+        }
+    }
+    if (read_from >= 0) {
+        ESP_RETURN_ON_ERROR(aw9523.bus->read_regs(lane, BSP_AW9523_ADDR, reg + read_from, &aw9523.regs[first + read_from],
+                                                read_to - read_from + 1), TAG, "AW9523 read failed");
+        for (int i = read_from; i <= read_to; i++) {
+            aw9523.valid |= 1U << (first + i);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t byte_mask = mask >> (8 * i);
+        const uint8_t byte_val = val >> (8 * i);
+        const bool valid = aw9523.valid & (1U << (first + i));
+        next[i] = (aw9523.regs[first + i] & ~byte_mask) | (byte_val & byte_mask);
+        if (byte_mask != 0 && (!valid || next[i] != aw9523.regs[first + i])) {
+            write_from = (write_from < 0) ? i : write_from;
+            write_to = i;
+        }
+    }
+    if (write_from < 0) {
+        return ESP_OK;
+    }
+
+    bsp_i2c_xfer_t xfer = {
+        .lane = lane,
+        .addr = BSP_AW9523_ADDR,
+        .write_len = 1 + write_to - write_from + 1,
+        .write = { reg + write_from },
+    };
+    memcpy(&xfer.write[1], &next[write_from], write_to - write_from + 1);
+    ESP_RETURN_ON_ERROR(aw9523.bus->transfer(&xfer), TAG, "AW9523 write failed");
+
+    for (int i = write_from; i <= write_to; i++) {
+        aw9523.regs[first + i] = next[i];
+        aw9523.valid |= 1U << (first + i);
+    }
+    return ESP_OK;
+}
+
+esp_err_t bsp_aw9523_update(bsp_i2c_lane_t lane, uint8_t reg, uint16_t mask, uint16_t val)
+{
+    ESP_RETURN_ON_FALSE(reg == BSP_AW9523_REG_OUTPUT || reg == BSP_AW9523_REG_CONFIG || reg == BSP_AW9523_REG_INT ||
+                        (reg == BSP_AW9523_REG_GCR && (mask >> 8) == 0), ESP_ERR_INVALID_ARG, TAG, "AW9523 register not cached");
+    ESP_RETURN_ON_FALSE(aw9523.lock, ESP_ERR_INVALID_STATE, TAG, "AW9523 is not initialized");
+
+    xSemaphoreTake(aw9523.lock, portMAX_DELAY);
+    const esp_err_t ret = bsp_aw9523_update_locked(lane, reg, mask, val);
+    xSemaphoreGive(aw9523.lock);
+    return ret;
+}
+
+esp_err_t bsp_aw9523_set_outputs(bsp_i2c_lane_t lane, uint16_t outputs)
+{
+    const uint32_t both = 3U << (BSP_AW9523_REG_OUTPUT - BSP_AW9523_CACHE_FIRST);
+
+    ESP_RETURN_ON_FALSE(aw9523.lock, ESP_ERR_INVALID_STATE, TAG, "AW9523 is not initialized");
+
+    xSemaphoreTake(aw9523.lock, portMAX_DELAY);
+    const uint16_t mask = ((aw9523.valid & both) == both) ? outputs : 0xFFFF;
+    const esp_err_t ret = bsp_aw9523_update_locked(lane, BSP_AW9523_REG_OUTPUT, mask, outputs);
+    xSemaphoreGive(aw9523.lock);
+    return ret;
+}
@@ -0,0 +1,34 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * AXP2101 register decoding
+ *
+ * ADC results are big endian, VBAT has 13 bits, VBUS, VSYS and TDIE have 14 bits.
+ * No hardware access, shared by the target and host builds.
+ */
+
+#include <string.h>
+#include "bsp_axp2101.h"
+
+void bsp_axp2101_decode(const uint8_t status[2], const uint8_t adc[BSP_AXP2101_ADC_LEN], uint8_t level, bsp_power_telemetry_t *t)
+{
+    memset(t, 0, sizeof(bsp_power_telemetry_t));
+    t->battery_present = (status[0] & (1 << 3)) != 0;
+    t->vbus_good = (status[0] & (1 << 5)) != 0;
+    t->charge = (bsp_power_charge_t)((status[1] >> 5) & 0x03);
+    if (t->charge > BSP_POWER_CHARGE_DISCHARGING) {
+        t->charge = BSP_POWER_CHARGE_STANDBY;
+    }
+
+    const uint16_t tdie = ((adc[8] & 0x3F) << 8) | adc[9];
+    t->vbat_mv = t->battery_present ? ((adc[0] & 0x1F) << 8) | adc[1] : 0;
+    t->vbus_mv = t->vbus_good ? ((adc[4] & 0x3F) << 8) | adc[5] : 0;
+    t->vsys_mv = ((adc[6] & 0x3F) << 8) | adc[7];
+    /* 22 degree Celsius at 7274, 20 LSB per degree */
+    t->die_temp_dc = 220 + (7274 - (int)tdie) / 2;
+    t->battery_level = t->battery_present ? (int8_t)(level <= 100 ? level : 100) : -1;
+}
@@ -0,0 +1,166 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Dirty area coalescing
+ *
+ * Every area LVGL flushes costs one esp_lcd_panel_draw_bitmap() call: CASET, RASET and RAMWR
+ * commands are sent before the pixels. Each draw buffer band of an area is a separate call.
+ * Before rendering, the invalidated areas of the frame are merged whenever the merged area is
+ * cheaper to send than the two areas separately, and overlaps are trimmed when they are not.
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "esp_check.h"
+
+#include "bsp/m5stack_core_s3.h"
+#include "bsp_display_priv.h"
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+
+static const char *TAG = "M5Stack";
+
+static bsp_display_coalesce_stats_t coalesce_stats;
+static portMUX_TYPE coalesce_lock = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t bsp_display_coalesce_cost(const lv_area_t *area, uint32_t buf_px, uint32_t overhead)
+{
+    const uint32_t w = lv_area_get_width(area);
+    const uint32_t h = lv_area_get_height(area);
+    uint32_t max_rows = buf_px / w;
+    if (max_rows == 0) {
+        max_rows = 1;
+    }
+    /* LVGL renders and flushes the area in bands of max_rows lines */
+    const uint32_t bands = (h + max_rows - 1) / max_rows;
+    return bands * overhead + w * h * sizeof(lv_color_t);
+}
+
+static void bsp_coalesce_join(lv_area_t *res, const lv_area_t *a, const lv_area_t *b)
+{
+    res->x1 = LV_MIN(a->x1, b->x1);
+    res->y1 = LV_MIN(a->y1, b->y1);
+    res->x2 = LV_MAX(a->x2, b->x2);
+    res->y2 = LV_MAX(a->y2, b->y2);
+}
+
+/* Cut the part of b covered by a, if the rest of b stays a rectangle */
+static bool bsp_coalesce_trim(const lv_area_t *a, lv_area_t *b)
+{
+    if (a->x1 > b->x2 || a->x2 < b->x1 || a->y1 > b->y2 || a->y2 < b->y1) {
+        return false;
+    }
+    if (a->x1 <= b->x1 && a->x2 >= b->x2) {
+        if (a->y1 <= b->y1 && a->y2 < b->y2) {
+            b->y1 = a->y2 + 1;
+            return true;
+        }
+        if (a->y2 >= b->y2 && a->y1 > b->y1) {
+            b->y2 = a->y1 - 1;
+            return true;
+        }
+    }
+    if (a->y1 <= b->y1 && a->y2 >= b->y2) {
+        if (a->x1 <= b->x1 && a->x2 < b->x2) {
+            b->x1 = a->x2 + 1;
+            return true;
+        }
+        if (a->x2 >= b->x2 && a->x1 > b->x1) {
+            b->x2 = a->x1 - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+int bsp_display_coalesce(lv_area_t *areas, uint8_t *joined, int count, uint32_t buf_px, uint32_t overhead)
+{
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < count; i++) {
+            if (joined[i]) {
+                continue;
+            }
+            for (int j = i + 1; j < count; j++) {
+                if (joined[j]) {
+                    continue;
+                }
+                lv_area_t merged;
+                bsp_coalesce_join(&merged, &areas[i], &areas[j]);
+                const uint32_t separate = bsp_display_coalesce_cost(&areas[i], buf_px, overhead) +
+                                          bsp_display_coalesce_cost(&areas[j], buf_px, overhead);
+                /* Keep the later index alive, LVGL treats the last not joined area as end of the frame */
+                if (bsp_display_coalesce_cost(&merged, buf_px, overhead) <= separate) {
+                    areas[j] = merged;
+                    joined[i] = 1;
+                    changed = true;
+                    break;
+                }
+                if (bsp_coalesce_trim(&areas[i], &areas[j]) || bsp_coalesce_trim(&areas[j], &areas[i])) {
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    int remaining = 0;
+    for (int i = 0; i < count; i++) {
+        if (!joined[i]) {
+            remaining++;
+        }
+    }
+    return remaining;
+}
+
+void bsp_display_coalesce_frame(lv_disp_t *disp, uint32_t buf_px)
+{
+    const uint32_t overhead = CONFIG_BSP_DISPLAY_COALESCE_OVERHEAD;
+    uint32_t cost_before = 0;
+    uint32_t cost_after = 0;
+    int areas_in = 0;
+
+    for (int i = 0; i < disp->inv_p; i++) {
+        if (!disp->inv_area_joined[i]) {
+            cost_before += bsp_display_coalesce_cost(&disp->inv_areas[i], buf_px, overhead);
+            areas_in++;
+        }
+    }
+    if (areas_in == 0) {
+        return;
+    }
+
+    const int areas_out = bsp_display_coalesce(disp->inv_areas, disp->inv_area_joined, disp->inv_p, buf_px, overhead);
+
+    for (int i = 0; i < disp->inv_p; i++) {
+        if (!disp->inv_area_joined[i]) {
+            cost_after += bsp_display_coalesce_cost(&disp->inv_areas[i], buf_px, overhead);
+        }
+    }
+
+    portENTER_CRITICAL(&coalesce_lock);
+    coalesce_stats.frames++;
+    coalesce_stats.areas_in += areas_in;
+    coalesce_stats.areas_out += areas_out;
+    coalesce_stats.last_frame_saved = cost_before - cost_after;
+    coalesce_stats.saved += coalesce_stats.last_frame_saved;
+    portEXIT_CRITICAL(&coalesce_lock);
+}
+
+esp_err_t bsp_display_get_coalesce_stats(bsp_display_coalesce_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    portENTER_CRITICAL(&coalesce_lock);
+    memcpy(stats, &coalesce_stats, sizeof(bsp_display_coalesce_stats_t));
+    portEXIT_CRITICAL(&coalesce_lock);
+
+    return ESP_OK;
+}
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
@@ -0,0 +1,229 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * LVGL draw context of the BSP display
+ *
+ * Software renderer of LVGL with opaque fills and image copies done by the RGB565 kernels.
+ * Everything with a mask, opacity or a special blend mode is left to LVGL. So are buffers which are
+ * not plain RGB565: snapshots with alpha and transparent layers store 3 bytes per pixel, LVGL writes
+ * them through set_px_cb or with screen_transp set.
+ * The file is shared with the host build, which renders with the same draw context.
+ *
+ * With parallel rendering, large blends into plain RGB565 buffers are split into two horizontal bands. The lower band is
+ * blended by a helper task on the other core and joined before the blend returns, so LVGL sees
+ * the same ordering as with one core. Only blending is split: LVGL 8 keeps draw masks and
+ * its temporary buffers in global state, so the rest of rendering can not run concurrently.
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_idf_version.h"
+
+#include "bsp/esp-bsp.h"
+#include "bsp_display_draw.h"
+#include "bsp_rgb565.h"
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+#include "esp_heap_caps.h"
+#include "bsp_display_priv.h"
+#endif
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+
+#if LV_COLOR_DEPTH != 16
+#error "BSP display draw context supports only 16-bit colors"
+#endif
+
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER || !CONFIG_IDF_TARGET_LINUX
+static const char *TAG = "M5Stack";
+#endif
+
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+#define BSP_DRAW_WORKER_STACK   (3072)
+#define BSP_DRAW_WORKER_PSRAM   (CONFIG_BSP_DISPLAY_WORKER_STACK_PSRAM && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0))
+
+typedef struct {
+    TaskHandle_t task;
+    int core_id;
+    SemaphoreHandle_t start;
+    SemaphoreHandle_t done;
+    volatile bool enabled;
+    lv_draw_sw_ctx_t ctx;       /* Copy of the draw context clipped to the lower band */
+    lv_area_t clip;
+    const lv_draw_sw_blend_dsc_t *dsc;
+} bsp_draw_worker_t;
+
+static bsp_draw_worker_t worker;
+#endif
+
+/* Draw buffer of the display being refreshed holds plain RGB565 pixels */
+static inline bool bsp_display_buf_is_rgb565(void)
+{
+    const lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    return disp && disp->driver->set_px_cb == NULL && !disp->driver->screen_transp;
+}
+
+static void bsp_display_blend_band(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    const bool cover = (dsc->mask_buf == NULL || dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER);
+    if (!cover || dsc->opa < LV_OPA_MAX || dsc->blend_mode != LV_BLEND_MODE_NORMAL || !bsp_display_buf_is_rgb565()) {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        return;
+    }
+
+    lv_area_t blend_area;
+    if (!_lv_area_intersect(&blend_area, dsc->blend_area, draw_ctx->clip_area)) {
+        return;
+    }
+
+    const lv_coord_t dest_stride = lv_area_get_width(draw_ctx->buf_area);
+    const lv_coord_t w = lv_area_get_width(&blend_area);
+    lv_coord_t h = lv_area_get_height(&blend_area);
+    uint16_t *dest = (uint16_t *)draw_ctx->buf + dest_stride * (blend_area.y1 - draw_ctx->buf_area->y1) + (blend_area.x1 - draw_ctx->buf_area->x1);
+
+    if (dsc->src_buf == NULL) {
+        if (w == dest_stride) {
+            /* Whole lines, fill as one run */
+            bsp_rgb565_fill(dest, dsc->color.full, (size_t)w * h);
+            return;
+        }
+        for (; h > 0; h--) {
+            bsp_rgb565_fill(dest, dsc->color.full, w);
+            dest += dest_stride;
+        }
+    } else {
+        const lv_coord_t src_stride = lv_area_get_width(dsc->blend_area);
+        const uint16_t *src = (const uint16_t *)dsc->src_buf + src_stride * (blend_area.y1 - dsc->blend_area->y1) + (blend_area.x1 - dsc->blend_area->x1);
+        for (; h > 0; h--) {
+            bsp_rgb565_copy(dest, src, w);
+            dest += dest_stride;
+            src += src_stride;
+        }
+    }
+}
+
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+static void bsp_draw_worker_task(void *arg)
+{
+    while (1) {
+        xSemaphoreTake(worker.start, portMAX_DELAY);
+        bsp_display_blend_band(&worker.ctx.base_draw, worker.dsc);
+        xSemaphoreGive(worker.done);
+    }
+}
+
+static void bsp_display_blend_parallel(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc, const lv_area_t *area)
+{
+    const lv_area_t *clip_ori = draw_ctx->clip_area;
+    lv_area_t top = *area;
+
+    top.y2 = area->y1 + lv_area_get_height(area) / 2 - 1;
+    worker.clip = *area;
+    worker.clip.y1 = top.y2 + 1;
+    memcpy(&worker.ctx, draw_ctx, sizeof(lv_draw_sw_ctx_t));
+    worker.ctx.base_draw.clip_area = &worker.clip;
+    worker.dsc = dsc;
+    xSemaphoreGive(worker.start);
+
+    draw_ctx->clip_area = &top;
+    bsp_display_blend_band(draw_ctx, dsc);
+    draw_ctx->clip_area = clip_ori;
+
+    xSemaphoreTake(worker.done, portMAX_DELAY);
+}
+#endif
+
+static void bsp_display_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+    /* Pixels of snapshots and layers with alpha are written by LVGL, one band at a time */
+    lv_area_t area;
+    if (worker.enabled && bsp_display_buf_is_rgb565() && _lv_area_intersect(&area, dsc->blend_area, draw_ctx->clip_area) &&
+            lv_area_get_height(&area) >= 2 && lv_area_get_size(&area) >= CONFIG_BSP_DISPLAY_PARALLEL_MIN_PX) {
+        bsp_display_blend_parallel(draw_ctx, dsc, &area);
+        return;
+    }
+#endif
+    bsp_display_blend_band(draw_ctx, dsc);
+}
+
+void bsp_display_draw_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+    lv_draw_sw_ctx_t *sw_ctx = (lv_draw_sw_ctx_t *)draw_ctx;
+    sw_ctx->blend = bsp_display_blend;
+}
+
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+esp_err_t bsp_display_draw_parallel_init(const bsp_display_task_cfg_t *task)
+{
+    esp_err_t ret = ESP_OK;
+    BaseType_t created;
+
+    if (worker.task) {
+        return ESP_OK;
+    }
+    worker.start = xSemaphoreCreateBinary();
+    worker.done = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(worker.start && worker.done, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for render worker");
+
+    /* Pinned LVGL task gets the worker on the other core, otherwise the scheduler picks the core LVGL is not using */
+    worker.core_id = (task->core_id < 0) ? tskNO_AFFINITY : (task->core_id == 0) ? 1 : 0;
+#if BSP_DRAW_WORKER_PSRAM
+    if (task->worker_stack_psram) {
+        created = xTaskCreatePinnedToCoreWithCaps(bsp_draw_worker_task, "LVGL band", BSP_DRAW_WORKER_STACK, NULL, task->priority,
+                                                  &worker.task, worker.core_id, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    } else
+#endif
+    {
+        created = xTaskCreatePinnedToCore(bsp_draw_worker_task, "LVGL band", BSP_DRAW_WORKER_STACK, NULL, task->priority,
+                                          &worker.task, worker.core_id);
+    }
+    ESP_GOTO_ON_FALSE(created == pdPASS, ESP_ERR_NO_MEM, err, TAG, "Create render worker fail");
+    worker.enabled = true;
+    return ESP_OK;
+
+err:
+    if (worker.start) {
+        vSemaphoreDelete(worker.start);
+        worker.start = NULL;
+    }
+    if (worker.done) {
+        vSemaphoreDelete(worker.done);
+        worker.done = NULL;
+    }
+    return ret;
+}
+
+esp_err_t bsp_display_set_parallel_render(bool enable)
+{
+    ESP_RETURN_ON_FALSE(worker.task, ESP_ERR_INVALID_STATE, TAG, "Parallel rendering was not started");
+    worker.enabled = enable;
+    return ESP_OK;
+}
+
+void bsp_display_draw_get_task_info(bsp_display_task_info_t *info)
+{
+    if (worker.task == NULL) {
+        return;
+    }
+    info->worker_stack_size = BSP_DRAW_WORKER_STACK;
+    info->worker_stack_free = uxTaskGetStackHighWaterMark(worker.task);
+    info->worker_core_id = (worker.core_id == tskNO_AFFINITY) ? -1 : worker.core_id;
+}
+#elif !CONFIG_IDF_TARGET_LINUX
+esp_err_t bsp_display_set_parallel_render(bool enable)
+{
+    ESP_LOGD(TAG, "Parallel rendering is disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif // CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
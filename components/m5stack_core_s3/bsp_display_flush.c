@@ -0,0 +1,499 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Flush engine for the LCD
+ *
+ * LVGL renders into one of N buffers while the others are streamed to the panel by SPI DMA.
+ * A buffer is handed back to LVGL only after esp_lcd reports its color transfer as done,
+ * so rendering of the next area overlaps with the transfer of the previous ones.
+ *
+ * In full frame mode LVGL renders into a single frame sized buffer in PSRAM. The flushed areas are
+ * copied into small DMA capable bounce buffers in internal RAM, which are streamed the same way.
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+
+#include "bsp/m5stack_core_s3.h"
+#include "bsp_display_priv.h"
+#include "bsp_rgb565.h"
+#include "bsp_spi_arbiter.h"
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+
+static const char *TAG = "M5Stack";
+
+typedef struct {
+    uint8_t buf_idx;                /* Index of the buffer in transfer */
+    uint32_t bytes;                 /* Size of the transfer */
+    int64_t submit_us;              /* Time the buffer was submitted to esp_lcd */
+    int64_t frame_start_us;         /* Render start of the frame, set only on the last transfer of the frame */
+    int64_t touch_us;               /* Touch contact shown by the frame, set only on its last transfer */
+} bsp_flush_trans_t;
+
+typedef struct {
+    esp_lcd_panel_handle_t panel;
+    esp_lcd_panel_io_handle_t io;
+    lv_disp_drv_t disp_drv;
+    lv_disp_draw_buf_t draw_buf;
+    lv_color_t *bufs[BSP_DISPLAY_FLUSH_BUFS_MAX];   /* Render buffers, or bounce buffers in full frame mode */
+    uint8_t buf_count;
+    bool full_frame;
+    lv_disp_rot_t rotation;         /* Rotation done by the panel */
+    lv_color_t *frame;              /* Full frame render buffer in PSRAM */
+    uint32_t transfer_px;           /* Maximum number of pixels sent by one draw_bitmap call */
+    bool in_dma[BSP_DISPLAY_FLUSH_BUFS_MAX];        /* Buffer is queued or being sent to the panel */
+    bsp_flush_trans_t fifo[BSP_DISPLAY_FLUSH_BUFS_MAX]; /* Transfers in submission order */
+    uint8_t fifo_head;
+    uint8_t fifo_len;
+    int64_t last_done_us;
+    int64_t render_start_us;        /* LVGL started rendering the current frame */
+    int64_t render_flush_us;        /* Time spent in the flush callbacks during the current frame */
+    int64_t frame_end_us;           /* Last flush callback of the previous frame returned */
+    int64_t frame_touch_us;         /* Touch contact shown by the current frame, 0 if none */
+    SemaphoreHandle_t done_sem;     /* Given from ISR every time a buffer returns from DMA */
+    portMUX_TYPE lock;
+    bsp_display_flush_stats_t stats;
+} bsp_flush_ctx_t;
+
+static bsp_flush_ctx_t flush_ctx = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static int bsp_flush_buf_index(const lv_color_t *buf)
+{
+    for (int i = 0; i < flush_ctx.buf_count; i++) {
+        if (flush_ctx.bufs[i] == buf) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool bsp_flush_trans_done(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    BaseType_t need_yield = pdFALSE;
+    bool arbiter_yield = false;
+    const int64_t now = esp_timer_get_time();
+    bsp_flush_trans_t done = {0};
+
+    portENTER_CRITICAL_ISR(&flush_ctx.lock);
+    if (flush_ctx.fifo_len > 0) {
+        const bsp_flush_trans_t *trans = &flush_ctx.fifo[flush_ctx.fifo_head];
+        done = *trans;
+        const int64_t start = (trans->submit_us > flush_ctx.last_done_us) ? trans->submit_us : flush_ctx.last_done_us;
+        flush_ctx.stats.dma_busy_us += now - start;
+        flush_ctx.in_dma[trans->buf_idx] = false;
+        flush_ctx.fifo_head = (flush_ctx.fifo_head + 1) % BSP_DISPLAY_FLUSH_BUFS_MAX;
+        flush_ctx.fifo_len--;
+        flush_ctx.last_done_us = now;
+    }
+    portEXIT_CRITICAL_ISR(&flush_ctx.lock);
+
+    if (done.bytes > 0) {
+        bsp_display_latency_record(BSP_DISPLAY_LATENCY_TRANSFER, now - done.submit_us);
+        if (done.frame_start_us) {
+            bsp_display_latency_record(BSP_DISPLAY_LATENCY_FRAME, now - done.frame_start_us);
+        }
+        bsp_display_latency_touch_shown(done.touch_us, now);
+        arbiter_yield = bsp_spi_arbiter_lcd_done_isr(done.submit_us, done.bytes);
+    }
+
+    if (flush_ctx.buf_count == 1 && !flush_ctx.full_frame) {
+        /* Single buffer: LVGL waits for this very buffer */
+        lv_disp_flush_ready((lv_disp_drv_t *)user_ctx);
+    } else {
+        xSemaphoreGiveFromISR(flush_ctx.done_sem, &need_yield);
+    }
+
+    return (need_yield == pdTRUE) || arbiter_yield;
+}
+
+static void bsp_flush_account_wait(int64_t wait_start)
+{
+    const int64_t stall_us = wait_start ? (esp_timer_get_time() - wait_start) : 0;
+    portENTER_CRITICAL(&flush_ctx.lock);
+    if (wait_start) {
+        flush_ctx.stats.stalled++;
+        flush_ctx.stats.stall_us += stall_us;
+    } else {
+        flush_ctx.stats.overlapped++;
+    }
+    portEXIT_CRITICAL(&flush_ctx.lock);
+}
+
+static void bsp_flush_account_frame(lv_disp_drv_t *drv)
+{
+    if (lv_disp_flush_is_last(drv)) {
+        portENTER_CRITICAL(&flush_ctx.lock);
+        flush_ctx.stats.frames++;
+        portEXIT_CRITICAL(&flush_ctx.lock);
+    }
+}
+
+/* Called on entry of the flush callbacks, returns render start of the frame if this is its last area */
+static int64_t bsp_flush_render_done(lv_disp_drv_t *drv, int64_t entry_us)
+{
+    if (!lv_disp_flush_is_last(drv)) {
+        return 0;
+    }
+    bsp_display_latency_record(BSP_DISPLAY_LATENCY_RENDER, entry_us - flush_ctx.render_start_us - flush_ctx.render_flush_us);
+    return flush_ctx.render_start_us;
+}
+
+/* Called on exit of the flush callbacks, so that the time spent in them is not counted as rendering */
+static void bsp_flush_callback_done(bool last, int64_t entry_us)
+{
+    const int64_t now = esp_timer_get_time();
+    if (last) {
+        flush_ctx.frame_end_us = now;
+    } else {
+        flush_ctx.render_flush_us += now - entry_us;
+    }
+}
+
+/* Make sure the draw buffer slot LVGL renders into next does not hold a buffer still in transfer */
+static void bsp_flush_prepare_slot(void **slot)
+{
+    int64_t wait_start = 0;
+
+    while (true) {
+        portENTER_CRITICAL(&flush_ctx.lock);
+        const int cur = bsp_flush_buf_index(*slot);
+        if (cur < 0 || !flush_ctx.in_dma[cur]) {
+            portEXIT_CRITICAL(&flush_ctx.lock);
+            break;
+        }
+        /* Slot is still in transfer, look for a spare buffer which is neither in DMA nor in LVGL */
+        int spare = -1;
+        for (int i = 0; i < flush_ctx.buf_count; i++) {
+            if (!flush_ctx.in_dma[i] && flush_ctx.bufs[i] != flush_ctx.draw_buf.buf1 && flush_ctx.bufs[i] != flush_ctx.draw_buf.buf2) {
+                spare = i;
+                break;
+            }
+        }
+        if (spare >= 0) {
+            *slot = flush_ctx.bufs[spare];
+            portEXIT_CRITICAL(&flush_ctx.lock);
+            break;
+        }
+        portEXIT_CRITICAL(&flush_ctx.lock);
+
+        if (wait_start == 0) {
+            wait_start = esp_timer_get_time();
+        }
+        xSemaphoreTake(flush_ctx.done_sem, portMAX_DELAY);
+    }
+
+    bsp_flush_account_wait(wait_start);
+}
+
+/* Wait for a bounce buffer which is not in transfer */
+static int bsp_flush_acquire_bounce(void)
+{
+    int64_t wait_start = 0;
+    int idx = -1;
+
+    while (true) {
+        portENTER_CRITICAL(&flush_ctx.lock);
+        for (int i = 0; i < flush_ctx.buf_count; i++) {
+            if (!flush_ctx.in_dma[i]) {
+                idx = i;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&flush_ctx.lock);
+        if (idx >= 0) {
+            break;
+        }
+
+        if (wait_start == 0) {
+            wait_start = esp_timer_get_time();
+        }
+        xSemaphoreTake(flush_ctx.done_sem, portMAX_DELAY);
+    }
+
+    bsp_flush_account_wait(wait_start);
+    return idx;
+}
+
+/* Queue buffer for transfer to the panel, the buffer is marked free again in bsp_flush_trans_done() */
+static esp_err_t bsp_flush_submit(int idx, int x_start, int y_start, int x_end, int y_end, int64_t frame_start_us)
+{
+    const int64_t submit_us = esp_timer_get_time();
+    portENTER_CRITICAL(&flush_ctx.lock);
+    const uint8_t tail = (flush_ctx.fifo_head + flush_ctx.fifo_len) % BSP_DISPLAY_FLUSH_BUFS_MAX;
+    flush_ctx.fifo[tail].buf_idx = idx;
+    flush_ctx.fifo[tail].bytes = (uint32_t)(x_end - x_start) * (y_end - y_start) * sizeof(lv_color_t);
+    flush_ctx.fifo[tail].submit_us = submit_us;
+    flush_ctx.fifo[tail].frame_start_us = frame_start_us;
+    flush_ctx.fifo[tail].touch_us = frame_start_us ? flush_ctx.frame_touch_us : 0;
+    flush_ctx.fifo_len++;
+    flush_ctx.in_dma[idx] = true;
+    portEXIT_CRITICAL(&flush_ctx.lock);
+    bsp_spi_arbiter_lcd_submit();
+
+    esp_err_t ret = esp_lcd_panel_draw_bitmap(flush_ctx.panel, x_start, y_start, x_end, y_end, flush_ctx.bufs[idx]);
+    bsp_display_latency_record(BSP_DISPLAY_LATENCY_SUBMIT, esp_timer_get_time() - submit_us);
+    if (ret != ESP_OK) {
+        /* No transfer was queued, so no completion will come */
+        ESP_LOGE(TAG, "Draw bitmap failed (%s)", esp_err_to_name(ret));
+        portENTER_CRITICAL(&flush_ctx.lock);
+        flush_ctx.fifo_len--;
+        flush_ctx.in_dma[idx] = false;
+        portEXIT_CRITICAL(&flush_ctx.lock);
+        bsp_spi_arbiter_lcd_cancel();
+        return ret;
+    }
+
+    portENTER_CRITICAL(&flush_ctx.lock);
+    flush_ctx.stats.flushes++;
+    flush_ctx.stats.pixels += (uint32_t)(x_end - x_start) * (y_end - y_start);
+    portEXIT_CRITICAL(&flush_ctx.lock);
+    return ESP_OK;
+}
+
+static void bsp_flush_callback(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    const int64_t entry_us = esp_timer_get_time();
+    const int64_t frame_start_us = bsp_flush_render_done(drv, entry_us);
+    const int idx = bsp_flush_buf_index(color_map);
+    assert(idx >= 0);
+
+    if (bsp_flush_submit(idx, area->x1, area->y1, area->x2 + 1, area->y2 + 1, frame_start_us) != ESP_OK) {
+        bsp_flush_callback_done(frame_start_us != 0, entry_us);
+        lv_disp_flush_ready(drv);
+        return;
+    }
+    bsp_flush_account_frame(drv);
+
+    if (flush_ctx.buf_count == 1) {
+        /* Ready is signaled from the transfer done callback */
+        bsp_flush_callback_done(frame_start_us != 0, entry_us);
+        return;
+    }
+
+    /* LVGL swaps to the other slot right after this callback returns and starts rendering into it */
+    void **next_slot = (flush_ctx.draw_buf.buf1 == color_map) ? &flush_ctx.draw_buf.buf2 : &flush_ctx.draw_buf.buf1;
+    bsp_flush_prepare_slot(next_slot);
+    bsp_flush_callback_done(frame_start_us != 0, entry_us);
+    lv_disp_flush_ready(drv);
+}
+
+static void bsp_flush_full_frame_callback(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    const int64_t entry_us = esp_timer_get_time();
+    const int64_t frame_start_us = bsp_flush_render_done(drv, entry_us);
+    const lv_coord_t w = lv_area_get_width(area);
+    const lv_coord_t max_rows = LV_MAX(1, flush_ctx.transfer_px / w);
+    /* LVGL renders the area into the beginning of the frame buffer, line after line */
+    const uint16_t *src = (const uint16_t *)color_map;
+
+    for (lv_coord_t y = area->y1; y <= area->y2; y += max_rows) {
+        const lv_coord_t rows = LV_MIN(max_rows, area->y2 - y + 1);
+        const int idx = bsp_flush_acquire_bounce();
+        bsp_rgb565_copy((uint16_t *)flush_ctx.bufs[idx], src, (size_t)w * rows);
+        src += (size_t)w * rows;
+        const bool last_rows = (y + rows > area->y2);
+        if (bsp_flush_submit(idx, area->x1, y, area->x2 + 1, y + rows, last_rows ? frame_start_us : 0) != ESP_OK) {
+            break;
+        }
+    }
+
+    bsp_flush_account_frame(drv);
+    bsp_flush_callback_done(frame_start_us != 0, entry_us);
+
+    /* Area was copied out of the frame buffer, LVGL can render the next one while the last bounce buffers are sent */
+    lv_disp_flush_ready(drv);
+}
+
+static void bsp_flush_render_start_callback(lv_disp_drv_t *drv)
+{
+    const int64_t now = esp_timer_get_time();
+    if (flush_ctx.frame_end_us) {
+        bsp_display_latency_record(BSP_DISPLAY_LATENCY_IDLE, now - flush_ctx.frame_end_us);
+    }
+    flush_ctx.render_start_us = now;
+    flush_ctx.render_flush_us = 0;
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    flush_ctx.frame_touch_us = bsp_display_latency_touch_frame(disp);
+#if CONFIG_BSP_DISPLAY_COALESCE
+    bsp_display_coalesce_frame(disp, flush_ctx.transfer_px);
+#endif
+}
+
+/* Rotation values must be same as used in esp_lcd for initial settings of the screen */
+const bsp_display_orient_t bsp_display_orient[] = {
+    [LV_DISP_ROT_NONE] = { .swap_xy = false, .mirror_x = true,  .mirror_y = true  },
+    [LV_DISP_ROT_90]   = { .swap_xy = true,  .mirror_x = true,  .mirror_y = false },
+    [LV_DISP_ROT_180]  = { .swap_xy = false, .mirror_x = false, .mirror_y = false },
+    [LV_DISP_ROT_270]  = { .swap_xy = true,  .mirror_x = false, .mirror_y = true  },
+};
+
+static void bsp_flush_update_callback(lv_disp_drv_t *drv)
+{
+    /* LVGL sees an unrotated display, the panel scans in the rotated direction (MADCTL) */
+    const bsp_display_orient_t *orient = &bsp_display_orient[flush_ctx.rotation];
+    esp_lcd_panel_swap_xy(flush_ctx.panel, orient->swap_xy);
+    esp_lcd_panel_mirror(flush_ctx.panel, orient->mirror_x, orient->mirror_y);
+}
+
+void bsp_display_flush_set_rotation(lv_disp_t *disp, lv_disp_rot_t rotation)
+{
+    const bool portrait = (rotation == LV_DISP_ROT_90 || rotation == LV_DISP_ROT_270);
+    flush_ctx.rotation = rotation;
+    flush_ctx.disp_drv.hor_res = portrait ? BSP_LCD_V_RES : BSP_LCD_H_RES;
+    flush_ctx.disp_drv.ver_res = portrait ? BSP_LCD_H_RES : BSP_LCD_V_RES;
+    /* Resizes the screens, invalidates them and calls bsp_flush_update_callback() */
+    lv_disp_drv_update(disp, &flush_ctx.disp_drv);
+}
+
+static esp_err_t bsp_flush_alloc_bufs(uint32_t count, uint32_t size_px, uint32_t caps)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        flush_ctx.bufs[i] = heap_caps_malloc(size_px * sizeof(lv_color_t), caps);
+        ESP_RETURN_ON_FALSE(flush_ctx.bufs[i], ESP_ERR_NO_MEM, TAG, "Not enough memory for LVGL buffer %"PRIu32" allocation!", i);
+        flush_ctx.buf_count++;
+    }
+    return ESP_OK;
+}
+
+lv_disp_t *bsp_display_flush_init(const bsp_display_cfg_t *cfg, esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t io)
+{
+    assert(cfg != NULL);
+    esp_err_t ret = ESP_OK;
+    lv_disp_t *disp = NULL;
+
+    uint32_t buf_count = cfg->buffer_count;
+    if (buf_count == 0) {
+        buf_count = cfg->double_buffer ? 2 : 1;
+    }
+    ESP_RETURN_ON_FALSE(buf_count <= BSP_DISPLAY_FLUSH_BUFS_MAX, NULL, TAG, "Too many draw buffers");
+
+    flush_ctx.panel = panel;
+    flush_ctx.io = io;
+    flush_ctx.full_frame = cfg->flags.full_frame;
+    flush_ctx.done_sem = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(flush_ctx.done_sem, NULL, TAG, "Not enough memory for flush semaphore");
+
+    if (flush_ctx.full_frame) {
+        /* Frame in PSRAM, buffer_count bounce buffers in internal RAM */
+        const uint32_t frame_px = BSP_LCD_H_RES * BSP_LCD_V_RES;
+        /* Areas are copied line by line, one line of the rotated display must fit */
+        ESP_GOTO_ON_FALSE(cfg->bounce_buffer_size >= LV_MAX(BSP_LCD_H_RES, BSP_LCD_V_RES), ESP_ERR_INVALID_ARG, err, TAG,
+                          "Bounce buffer smaller than one line");
+        flush_ctx.frame = heap_caps_malloc(frame_px * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
+        ESP_GOTO_ON_FALSE(flush_ctx.frame, ESP_ERR_NO_MEM, err, TAG, "Not enough PSRAM for frame buffer");
+        ESP_GOTO_ON_ERROR(bsp_flush_alloc_bufs(LV_MAX(buf_count, 2), cfg->bounce_buffer_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL), err, TAG, "");
+        flush_ctx.transfer_px = cfg->bounce_buffer_size;
+        lv_disp_draw_buf_init(&flush_ctx.draw_buf, flush_ctx.frame, NULL, frame_px);
+    } else {
+        assert(cfg->buffer_size > 0);
+        uint32_t buff_caps = MALLOC_CAP_DEFAULT;
+        if (cfg->flags.buff_dma) {
+            buff_caps = MALLOC_CAP_DMA;
+        } else if (cfg->flags.buff_spiram) {
+            buff_caps = MALLOC_CAP_SPIRAM;
+        }
+        ESP_GOTO_ON_ERROR(bsp_flush_alloc_bufs(buf_count, cfg->buffer_size, buff_caps), err, TAG, "");
+        flush_ctx.transfer_px = cfg->buffer_size;
+        lv_disp_draw_buf_init(&flush_ctx.draw_buf, flush_ctx.bufs[0], (buf_count > 1) ? flush_ctx.bufs[1] : NULL, cfg->buffer_size);
+    }
+
+    const esp_lcd_panel_io_callbacks_t cbs = {
+        .on_color_trans_done = bsp_flush_trans_done,
+    };
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_register_event_callbacks(io, &cbs, &flush_ctx.disp_drv), err, TAG, "Register IO callbacks failed");
+
+    lv_disp_drv_init(&flush_ctx.disp_drv);
+    flush_ctx.disp_drv.hor_res = BSP_LCD_H_RES;
+    flush_ctx.disp_drv.ver_res = BSP_LCD_V_RES;
+    flush_ctx.disp_drv.flush_cb = flush_ctx.full_frame ? bsp_flush_full_frame_callback : bsp_flush_callback;
+    flush_ctx.disp_drv.drv_update_cb = bsp_flush_update_callback;
+    flush_ctx.disp_drv.draw_buf = &flush_ctx.draw_buf;
+    flush_ctx.disp_drv.draw_ctx_init = bsp_display_draw_ctx_init;
+    flush_ctx.disp_drv.render_start_cb = bsp_flush_render_start_callback;
+#if CONFIG_BSP_DISPLAY_LATENCY
+    flush_ctx.disp_drv.rounder_cb = bsp_display_latency_invalidate_cb;
+#endif
+
+    disp = lv_disp_drv_register(&flush_ctx.disp_drv);
+    ESP_GOTO_ON_FALSE(disp, ESP_ERR_NO_MEM, err, TAG, "LVGL display register failed");
+
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+    if (cfg->flags.parallel_render && bsp_display_draw_parallel_init(&cfg->task) != ESP_OK) {
+        ESP_LOGW(TAG, "Parallel rendering not available, rendering on one core");
+    }
+#endif
+
+    if (flush_ctx.full_frame) {
+        ESP_LOGI(TAG, "Flush engine: frame buffer in PSRAM, %d bounce buffers of %"PRIu32" pixels", flush_ctx.buf_count, flush_ctx.transfer_px);
+    } else {
+        ESP_LOGI(TAG, "Flush engine: %d buffers of %"PRIu32" pixels", flush_ctx.buf_count, flush_ctx.transfer_px);
+    }
+    return disp;
+
+err:
+    ESP_LOGD(TAG, "Flush engine init failed (%s)", esp_err_to_name(ret));
+    for (int i = 0; i < flush_ctx.buf_count; i++) {
+        heap_caps_free(flush_ctx.bufs[i]);
+        flush_ctx.bufs[i] = NULL;
+    }
+    flush_ctx.buf_count = 0;
+    heap_caps_free(flush_ctx.frame);
+    flush_ctx.frame = NULL;
+    vSemaphoreDelete(flush_ctx.done_sem);
+    flush_ctx.done_sem = NULL;
+    return NULL;
+}
+
+esp_err_t bsp_display_get_flush_stats(bsp_display_flush_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(flush_ctx.buf_count > 0, ESP_ERR_INVALID_STATE, TAG, "Display not initialized");
+
+    portENTER_CRITICAL(&flush_ctx.lock);
+    memcpy(stats, &flush_ctx.stats, sizeof(bsp_display_flush_stats_t));
+    stats->in_flight = flush_ctx.fifo_len;
+    portEXIT_CRITICAL(&flush_ctx.lock);
+    stats->buffer_count = flush_ctx.buf_count;
+
+    return ESP_OK;
+}
+
+esp_err_t bsp_display_get_buffer_info(bsp_display_buffer_info_t *info)
+{
+    ESP_RETURN_ON_FALSE(info, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(flush_ctx.buf_count > 0, ESP_ERR_INVALID_STATE, TAG, "Display not initialized");
+
+    memset(info, 0, sizeof(bsp_display_buffer_info_t));
+    info->buffer_size = flush_ctx.transfer_px;
+    /* Lines of the rotated display, as LVGL renders them */
+    info->buffer_lines = flush_ctx.transfer_px / flush_ctx.disp_drv.hor_res;
+    info->buffer_count = flush_ctx.buf_count;
+    info->full_frame = flush_ctx.full_frame;
+    bsp_display_tune_get_info(info);
+
+    return ESP_OK;
+}
+
+void bsp_display_reset_flush_stats(void)
+{
+    portENTER_CRITICAL(&flush_ctx.lock);
+    memset(&flush_ctx.stats, 0, sizeof(bsp_display_flush_stats_t));
+    portEXIT_CRITICAL(&flush_ctx.lock);
+}
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
@@ -0,0 +1,310 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Headless display of the host build (linux target)
+ *
+ * LVGL renders into partial draw buffers, which are copied into an in-memory framebuffer
+ * instead of being sent to the panel. LVGL task and mutex work the same way as with esp_lvgl_port.
+ *
+ * The pointer input device reports a released touch, touch recordings are replayed into it
+ * by bsp_touch_replay() the same way as on the target.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/m5stack_core_s3_host.h"
+#include "bsp/display.h"
+#include "bsp_err_check.h"
+#include "bsp_display_latency.h"
+#include "bsp_display_draw.h"
+#include "bsp_touch_record.h"
+
+static const char *TAG = "M5Stack";
+
+static int brightness;
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+
+static SemaphoreHandle_t lvgl_mux;
+static TaskHandle_t lvgl_task;
+static uint32_t lvgl_task_stack;
+static lv_color_t *framebuffer;
+static volatile uint32_t frame_count;
+static bsp_display_host_frame_cb_t frame_cb;
+static void *frame_cb_ctx;
+static int64_t frame_start_us;      /* Start of rendering the current frame */
+static int64_t frame_touch_us;      /* Touch contact shown by the frame being rendered */
+static lv_indev_t *touch_indev;
+
+static void bsp_display_host_render_start(lv_disp_drv_t *drv)
+{
+    if (frame_start_us == 0) {
+        frame_start_us = esp_timer_get_time();
+        frame_touch_us = bsp_display_latency_touch_frame(_lv_refr_get_disp_refreshing());
+    }
+}
+
+static void bsp_display_host_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    const lv_coord_t w = lv_area_get_width(area);
+
+    for (lv_coord_t y = area->y1; y <= area->y2; y++) {
+        memcpy(&framebuffer[y * BSP_LCD_H_RES + area->x1], color_map, w * sizeof(lv_color_t));
+        color_map += w;
+    }
+
+    if (lv_disp_flush_is_last(drv)) {
+        const int64_t now_us = esp_timer_get_time();
+        bsp_display_latency_record(BSP_DISPLAY_LATENCY_FRAME, now_us - frame_start_us);
+        bsp_display_latency_touch_shown(frame_touch_us, now_us);
+        frame_start_us = 0;
+        frame_touch_us = 0;
+        frame_count++;
+        if (frame_cb) {
+            frame_cb(frame_count, frame_cb_ctx);
+        }
+    }
+    lv_disp_flush_ready(drv);
+}
+
+static void bsp_display_host_touch_read(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    data->state = LV_INDEV_STATE_RELEASED;
+}
+
+static void bsp_display_host_task(void *arg)
+{
+    const TickType_t max_ticks = pdMS_TO_TICKS((int)(intptr_t)arg);
+#if !LV_TICK_CUSTOM
+    int64_t last_us = esp_timer_get_time();
+#endif
+
+    while (1) {
+#if !LV_TICK_CUSTOM
+        const int64_t now_us = esp_timer_get_time();
+        lv_tick_inc((now_us - last_us) / 1000);
+        last_us += (now_us - last_us) / 1000 * 1000;
+#endif
+        TickType_t ticks = 1;
+        if (bsp_display_lock(0)) {
+            ticks = pdMS_TO_TICKS(lv_timer_handler());
+            bsp_display_unlock();
+        }
+        vTaskDelay(LV_CLAMP(1, ticks, max_ticks));
+    }
+}
+
+lv_disp_t *bsp_display_start(void)
+{
+    const bsp_display_cfg_t cfg = {
+        .buffer_size = BSP_LCD_DRAW_BUFF_SIZE,
+        .double_buffer = BSP_LCD_DRAW_BUFF_DOUBLE,
+        .task_priority = 4,
+        .task_stack = 8192,
+        .timer_period_ms = 500,
+    };
+    return bsp_display_start_with_config(&cfg);
+}
+
+lv_disp_t *bsp_display_start_with_config(const bsp_display_cfg_t *cfg)
+{
+    static lv_disp_draw_buf_t disp_buf;
+    static lv_disp_drv_t disp_drv;
+    lv_color_t *buf1 = NULL;
+    lv_color_t *buf2 = NULL;
+    assert(cfg != NULL && cfg->buffer_size > 0);
+
+    lvgl_mux = xSemaphoreCreateRecursiveMutex();
+    BSP_NULL_CHECK(lvgl_mux, NULL);
+    lv_init();
+
+    framebuffer = calloc(BSP_LCD_H_RES * BSP_LCD_V_RES, sizeof(lv_color_t));
+    buf1 = malloc(cfg->buffer_size * sizeof(lv_color_t));
+    if (cfg->double_buffer) {
+        buf2 = malloc(cfg->buffer_size * sizeof(lv_color_t));
+    }
+    if (framebuffer == NULL || buf1 == NULL || (cfg->double_buffer && buf2 == NULL)) {
+        ESP_LOGE(TAG, "Not enough memory for LVGL buffers");
+        goto err;
+    }
+
+    lv_disp_draw_buf_init(&disp_buf, buf1, buf2, cfg->buffer_size);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = BSP_LCD_H_RES;
+    disp_drv.ver_res = BSP_LCD_V_RES;
+    disp_drv.flush_cb = bsp_display_host_flush;
+    disp_drv.render_start_cb = bsp_display_host_render_start;
+#if CONFIG_BSP_DISPLAY_LATENCY
+    disp_drv.rounder_cb = bsp_display_latency_invalidate_cb;
+#endif
+    disp_drv.draw_buf = &disp_buf;
+    /* Same draw context as the board, snapshots and layers taken on the display use it too */
+    disp_drv.draw_ctx_init = bsp_display_draw_ctx_init;
+    /* Framebuffer keeps the panel orientation */
+    disp_drv.sw_rotate = 1;
+    lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
+
+    static lv_indev_drv_t indev_drv;
+    lv_indev_drv_init(&indev_drv);
+    indev_drv.type = LV_INDEV_TYPE_POINTER;
+    indev_drv.disp = disp;
+    indev_drv.read_cb = bsp_display_host_touch_read;
+    touch_indev = lv_indev_drv_register(&indev_drv);
+    bsp_touch_record_init(touch_indev);
+
+    if (xTaskCreate(bsp_display_host_task, "LVGL task", cfg->task_stack, (void *)(intptr_t)cfg->timer_period_ms,
+                    cfg->task_priority, &lvgl_task) != pdPASS) {
+        ESP_LOGE(TAG, "Create LVGL task fail");
+        lv_indev_delete(touch_indev);
+        touch_indev = NULL;
+        lv_disp_remove(disp);
+        goto err;
+    }
+    lvgl_task_stack = cfg->task_stack;
+    return disp;
+
+err:
+    free(buf1);
+    free(buf2);
+    free(framebuffer);
+    framebuffer = NULL;
+    return NULL;
+}
+
+lv_indev_t *bsp_display_get_input_dev(void)
+{
+    return touch_indev;
+}
+
+esp_err_t bsp_display_get_task_info(bsp_display_task_info_t *info)
+{
+    ESP_RETURN_ON_FALSE(info, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(lvgl_task, ESP_ERR_INVALID_STATE, TAG, "Display was not started");
+
+    memset(info, 0, sizeof(bsp_display_task_info_t));
+    info->lvgl_stack_size = lvgl_task_stack;
+    info->lvgl_stack_free = uxTaskGetStackHighWaterMark(lvgl_task);
+    info->lvgl_core_id = -1;
+    info->lvgl_priority = uxTaskPriorityGet(lvgl_task);
+    info->worker_core_id = -1;
+    return ESP_OK;
+}
+
+bool bsp_display_lock(uint32_t timeout_ms)
+{
+    assert(lvgl_mux && "bsp_display_start must be called first");
+
+    const TickType_t timeout_ticks = (timeout_ms == 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return xSemaphoreTakeRecursive(lvgl_mux, timeout_ticks) == pdTRUE;
+}
+
+void bsp_display_unlock(void)
+{
+    assert(lvgl_mux && "bsp_display_start must be called first");
+    xSemaphoreGiveRecursive(lvgl_mux);
+}
+
+void bsp_display_rotate(lv_disp_t *disp, lv_disp_rot_t rotation)
+{
+    lv_disp_set_rotation(disp, rotation);
+}
+
+const lv_color_t *bsp_display_host_get_framebuffer(void)
+{
+    return framebuffer;
+}
+
+uint32_t bsp_display_host_get_frame_count(void)
+{
+    return frame_count;
+}
+
+void bsp_display_host_register_frame_cb(bsp_display_host_frame_cb_t cb, void *user_ctx)
+{
+    frame_cb_ctx = user_ctx;
+    frame_cb = cb;
+}
+
+esp_err_t bsp_display_host_save_ppm(const char *path)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t line[BSP_LCD_H_RES * 3];
+
+    ESP_RETURN_ON_FALSE(framebuffer, ESP_ERR_INVALID_STATE, TAG, "Display is not started");
+    FILE *f = fopen(path, "wb");
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "Failed to open %s", path);
+
+    bsp_display_lock(0);
+    fprintf(f, "P6\n%d %d\n255\n", BSP_LCD_H_RES, BSP_LCD_V_RES);
+    for (int y = 0; y < BSP_LCD_V_RES && ret == ESP_OK; y++) {
+        for (int x = 0; x < BSP_LCD_H_RES; x++) {
+            const uint32_t c = lv_color_to32(framebuffer[y * BSP_LCD_H_RES + x]);
+            line[x * 3 + 0] = (c >> 16) & 0xFF;
+            line[x * 3 + 1] = (c >> 8) & 0xFF;
+            line[x * 3 + 2] = c & 0xFF;
+        }
+        if (fwrite(line, 1, sizeof(line), f) != sizeof(line)) {
+            ret = ESP_FAIL;
+        }
+    }
+    bsp_display_unlock();
+
+    if (fclose(f) != 0 || ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write %s", path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+int8_t bsp_get_battery_level(void)
+{
+    return 100;
+}
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+
+esp_err_t bsp_display_new(const bsp_display_config_t *config, esp_lcd_panel_handle_t *ret_panel, esp_lcd_panel_io_handle_t *ret_io)
+{
+    ESP_LOGE(TAG, "esp_lcd is not available in the host build");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+uint32_t bsp_display_get_pclk_hz(void)
+{
+    return 0;
+}
+
+esp_err_t bsp_display_pclk_forget(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t bsp_display_brightness_set(int brightness_percent)
+{
+    ESP_RETURN_ON_FALSE(brightness_percent >= 0 && brightness_percent <= 100, ESP_ERR_INVALID_ARG, TAG, "Invalid brightness");
+    brightness = brightness_percent;
+    ESP_LOGD(TAG, "Setting LCD backlight: %d%%", brightness);
+    return ESP_OK;
+}
+
+esp_err_t bsp_display_backlight_off(void)
+{
+    return bsp_display_brightness_set(0);
+}
+
+esp_err_t bsp_display_backlight_on(void)
+{
+    return bsp_display_brightness_set(100);
+}
@@ -0,0 +1,247 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Latency histograms of the display pipeline
+ *
+ * Every stage has a log-linear histogram: values below 16 us are counted exactly, above that every
+ * power of two is split into 4 buckets. Samples are added with relaxed atomics only, so the flush
+ * engine can record from the DMA completion interrupt and the application task from bsp_display_lock().
+ *
+ * Touch to photon latency follows a new contact to the first frame with areas invalidated after it.
+ * Invalidations are seen in the rounder callback, which LVGL calls for every invalidated area,
+ * also for areas merged into one invalidated earlier. Counting the invalidated areas would miss those.
+ * Contact, invalidation and render start are all reported with the LVGL mutex taken, only the
+ * tagged frame carries the contact time further to the DMA completion interrupt.
+ * The file is shared with the host build, which has no console.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_console.h"
+#endif
+
+#include "bsp/esp-bsp.h"
+#include "bsp_display_latency.h"
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+
+static const char *TAG = "M5Stack";
+
+#if CONFIG_BSP_DISPLAY_LATENCY
+#define BSP_LAT_TOUCH_TIMEOUT_US    (1000000)   /* Contacts without a visible change are dropped */
+
+typedef struct {
+    atomic_uint max;
+    atomic_uint buckets[BSP_LAT_BUCKETS];
+} bsp_lat_hist_t;
+
+typedef struct {
+    int64_t contact_us;             /* Contact waiting for its frame, 0 if none */
+    lv_disp_t *disp;                /* Display of the contact */
+    bool invalidated;               /* Something was invalidated after the contact */
+    lv_indev_read_cb_t read_cb;     /* Original read callback of a polled touch */
+    bool pressed;
+} bsp_lat_touch_t;
+
+static bsp_lat_hist_t lat_hist[BSP_DISPLAY_LATENCY_MAX];
+static bsp_lat_touch_t lat_touch;
+
+/* Largest value counted in the bucket */
+uint32_t bsp_lat_bucket_upper(int bucket)
+{
+    if (bucket < BSP_LAT_LINEAR) {
+        return bucket;
+    }
+    const int msb = ((bucket - BSP_LAT_LINEAR) >> BSP_LAT_SUB_BITS) + BSP_LAT_LINEAR_BITS;
+    const int sub = (bucket - BSP_LAT_LINEAR) & ((1 << BSP_LAT_SUB_BITS) - 1);
+    const uint64_t upper = ((uint64_t)((1 << BSP_LAT_SUB_BITS) + sub + 1) << (msb - BSP_LAT_SUB_BITS)) - 1;
+    return (upper > UINT32_MAX) ? UINT32_MAX : (uint32_t)upper;
+}
+
+void bsp_display_latency_record(bsp_display_latency_stage_t stage, uint32_t us)
+{
+    bsp_lat_hist_t *hist = &lat_hist[stage];
+
+    atomic_fetch_add_explicit(&hist->buckets[bsp_lat_bucket(us)], 1, memory_order_relaxed);
+    unsigned int max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    while (us > max && !atomic_compare_exchange_weak_explicit(&hist->max, &max, us, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void bsp_display_latency_touch(lv_disp_t *disp, int64_t contact_us)
+{
+    if (lat_touch.contact_us && contact_us - lat_touch.contact_us < BSP_LAT_TOUCH_TIMEOUT_US) {
+        return;
+    }
+    lat_touch.contact_us = contact_us;
+    lat_touch.disp = disp;
+    lat_touch.invalidated = false;
+}
+
+void bsp_display_latency_invalidate_cb(lv_disp_drv_t *drv, lv_area_t *area)
+{
+    /* LVGL rounds the render buffer height with the same callback while rendering */
+    if (lat_touch.contact_us && lat_touch.disp && lat_touch.disp->driver == drv && !lat_touch.disp->rendering_in_progress) {
+        lat_touch.invalidated = true;
+    }
+}
+
+int64_t bsp_display_latency_touch_frame(lv_disp_t *disp)
+{
+    const int64_t contact_us = lat_touch.contact_us;
+
+    if (contact_us == 0) {
+        return 0;
+    }
+    if (esp_timer_get_time() - contact_us >= BSP_LAT_TOUCH_TIMEOUT_US) {
+        /* Nothing visible happened */
+        lat_touch.contact_us = 0;
+        return 0;
+    }
+    if (lat_touch.invalidated && disp == lat_touch.disp) {
+        lat_touch.contact_us = 0;
+        return contact_us;
+    }
+    /* Frame shows only what was invalidated before the contact */
+    return 0;
+}
+
+static void bsp_lat_touch_read_cb(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    const int64_t poll_us = esp_timer_get_time();
+
+    lat_touch.read_cb(drv, data);
+    const bool pressed = (data->state == LV_INDEV_STATE_PRESSED);
+    if (pressed && !lat_touch.pressed) {
+        bsp_display_latency_touch(drv->disp, poll_us);
+    }
+    lat_touch.pressed = pressed;
+}
+
+void bsp_display_latency_touch_poll(lv_indev_t *indev)
+{
+    bsp_display_lock(0);
+    lat_touch.read_cb = indev->driver->read_cb;
+    indev->driver->read_cb = bsp_lat_touch_read_cb;
+    bsp_display_unlock();
+}
+
+uint32_t bsp_lat_percentile(const uint32_t *buckets, uint32_t count, uint32_t max, uint32_t pct)
+{
+    const uint32_t rank = ((uint64_t)count * pct + 99) / 100;
+    uint32_t seen = 0;
+
+    for (int i = 0; i < BSP_LAT_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            const uint32_t upper = bsp_lat_bucket_upper(i);
+            return (upper < max) ? upper : max;
+        }
+    }
+    return max;
+}
+
+esp_err_t bsp_display_get_latency(bsp_display_latency_stage_t stage, bsp_display_latency_t *lat)
+{
+    uint32_t buckets[BSP_LAT_BUCKETS];
+    uint32_t count = 0;
+
+    ESP_RETURN_ON_FALSE(stage < BSP_DISPLAY_LATENCY_MAX && lat, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    /* Snapshot, so that the percentiles are consistent with the count */
+    for (int i = 0; i < BSP_LAT_BUCKETS; i++) {
+        buckets[i] = atomic_load_explicit(&lat_hist[stage].buckets[i], memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    lat->count = count;
+    lat->max_us = (count > 0) ? atomic_load_explicit(&lat_hist[stage].max, memory_order_relaxed) : 0;
+    lat->p50_us = (count > 0) ? bsp_lat_percentile(buckets, count, lat->max_us, 50) : 0;
+    lat->p95_us = (count > 0) ? bsp_lat_percentile(buckets, count, lat->max_us, 95) : 0;
+    lat->p99_us = (count > 0) ? bsp_lat_percentile(buckets, count, lat->max_us, 99) : 0;
+    return ESP_OK;
+}
+
+void bsp_display_reset_latency(void)
+{
+    for (int stage = 0; stage < BSP_DISPLAY_LATENCY_MAX; stage++) {
+        for (int i = 0; i < BSP_LAT_BUCKETS; i++) {
+            atomic_store_explicit(&lat_hist[stage].buckets[i], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&lat_hist[stage].max, 0, memory_order_relaxed);
+    }
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+static const char *const lat_names[BSP_DISPLAY_LATENCY_MAX] = {
+    [BSP_DISPLAY_LATENCY_RENDER]    = "render",
+    [BSP_DISPLAY_LATENCY_SUBMIT]    = "submit",
+    [BSP_DISPLAY_LATENCY_TRANSFER]  = "transfer",
+    [BSP_DISPLAY_LATENCY_FRAME]     = "frame",
+    [BSP_DISPLAY_LATENCY_IDLE]      = "idle",
+    [BSP_DISPLAY_LATENCY_LOCK_WAIT] = "lock_wait",
+    [BSP_DISPLAY_LATENCY_TOUCH]     = "touch",
+};
+
+static int bsp_lat_cmd(int argc, char **argv)
+{
+    if (argc > 1) {
+        if (strcmp(argv[1], "reset") != 0) {
+            printf("Usage: %s [reset]\n", argv[0]);
+            return 1;
+        }
+        bsp_display_reset_latency();
+        return 0;
+    }
+
+    printf("%-10s %10s %10s %10s %10s %10s\n", "stage", "count", "p50 [us]", "p95 [us]", "p99 [us]", "max [us]");
+    for (int stage = 0; stage < BSP_DISPLAY_LATENCY_MAX; stage++) {
+        bsp_display_latency_t lat;
+        bsp_display_get_latency(stage, &lat);
+        printf("%-10s %10"PRIu32" %10"PRIu32" %10"PRIu32" %10"PRIu32" %10"PRIu32"\n",
+               lat_names[stage], lat.count, lat.p50_us, lat.p95_us, lat.p99_us, lat.max_us);
+    }
+    return 0;
+}
+
+esp_err_t bsp_display_latency_register_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "display_latency",
+        .help = "Print latency percentiles of the display pipeline stages, 'reset' clears them",
+        .hint = "[reset]",
+        .func = bsp_lat_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+#endif // !CONFIG_IDF_TARGET_LINUX
+#else
+esp_err_t bsp_display_get_latency(bsp_display_latency_stage_t stage, bsp_display_latency_t *lat)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void bsp_display_reset_latency(void)
+{
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+esp_err_t bsp_display_latency_register_cmd(void)
+{
+    ESP_LOGW(TAG, "Latency histograms are disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
+#endif // CONFIG_BSP_DISPLAY_LATENCY
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
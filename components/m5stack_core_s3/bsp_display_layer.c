@@ -0,0 +1,404 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Layer cache of static widget subtrees
+ *
+ * A cached subtree is rendered once with lv_snapshot and hidden. An image proxy right above it in
+ * the z-order draws the snapshot instead, so invalidations of overlapping objects cost one blit.
+ * Snapshots are stored as plain RGB565 when they are fully opaque, or when only the plain background
+ * color of an ancestor is behind them, which their transparent pixels are then composited onto.
+ * Other snapshots keep an alpha byte per pixel and are blended on every draw.
+ *
+ * All objects of the subtree report their changes with events. A change marks the layer stale and
+ * it is rendered again by a timer, which runs before the next refresh.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#if CONFIG_SPIRAM
+#include "esp_heap_caps.h"
+#endif
+
+#include "bsp/esp-bsp.h"
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+
+static const char *TAG = "M5Stack";
+
+#if CONFIG_BSP_DISPLAY_LAYER_CACHE && LV_USE_SNAPSHOT
+#define BSP_LAYER_MAX   (8)
+
+typedef struct {
+    lv_obj_t *root;             /* Cached subtree, NULL for free slot */
+    lv_obj_t *proxy;            /* Image drawing the snapshot */
+    lv_obj_t *bg;               /* Ancestor the snapshot is composited onto, NULL if it keeps alpha */
+    lv_img_dsc_t img;
+    void *buf;
+    size_t buf_size;
+    bool stale;
+} bsp_layer_t;
+
+static bsp_layer_t layers[BSP_LAYER_MAX];
+static lv_timer_t *layer_timer;
+static bsp_display_layer_stats_t layer_stats;
+
+static void bsp_layer_event_cb(lv_event_t *e);
+static void bsp_layer_proxy_event_cb(lv_event_t *e);
+static void bsp_layer_bg_event_cb(lv_event_t *e);
+
+static void *bsp_layer_alloc(size_t size)
+{
+#if CONFIG_SPIRAM
+    void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (p) {
+        return p;
+    }
+#endif
+    return malloc(size);
+}
+
+static bsp_layer_t *bsp_layer_find(const lv_obj_t *root)
+{
+    for (int i = 0; i < BSP_LAYER_MAX; i++) {
+        if (layers[i].root == root) {
+            return &layers[i];
+        }
+    }
+    return NULL;
+}
+
+/* Nothing is drawn by a transparent ancestor, so whatever is behind it shows through */
+static bool bsp_layer_is_transparent(lv_obj_t *obj)
+{
+    return lv_obj_get_style_bg_opa(obj, LV_PART_MAIN) <= LV_OPA_MIN &&
+           (lv_obj_get_style_border_width(obj, LV_PART_MAIN) == 0 || lv_obj_get_style_border_opa(obj, LV_PART_MAIN) <= LV_OPA_MIN) &&
+           (lv_obj_get_style_outline_width(obj, LV_PART_MAIN) == 0 || lv_obj_get_style_outline_opa(obj, LV_PART_MAIN) <= LV_OPA_MIN) &&
+           (lv_obj_get_style_shadow_width(obj, LV_PART_MAIN) == 0 || lv_obj_get_style_shadow_opa(obj, LV_PART_MAIN) <= LV_OPA_MIN);
+}
+
+/*
+ * Ancestor with a plain background color right behind the snapshot area, NULL when anything else is drawn
+ * there: older siblings of the subtree or of any ancestor up to it, or an ancestor with visible parts.
+ */
+static lv_obj_t *bsp_layer_find_bg(lv_obj_t *root, const lv_area_t *area)
+{
+    lv_obj_t *child = root;
+
+    for (lv_obj_t *parent = lv_obj_get_parent(root); parent; child = parent, parent = lv_obj_get_parent(parent)) {
+        /* Older siblings are drawn first */
+        const uint32_t index = lv_obj_get_index(child);
+        for (uint32_t i = 0; i < index; i++) {
+            lv_obj_t *sibling = lv_obj_get_child(parent, i);
+            lv_area_t sibling_area;
+            lv_area_t common;
+            lv_obj_get_coords(sibling, &sibling_area);
+            lv_area_increase(&sibling_area, _lv_obj_get_ext_draw_size(sibling), _lv_obj_get_ext_draw_size(sibling));
+            if (!lv_obj_has_flag(sibling, LV_OBJ_FLAG_HIDDEN) && _lv_area_intersect(&common, &sibling_area, area)) {
+                return NULL;
+            }
+        }
+
+        if (lv_obj_get_style_bg_opa(parent, LV_PART_MAIN) >= LV_OPA_MAX) {
+            const bool plain = lv_obj_get_style_bg_grad_dir(parent, LV_PART_MAIN) == LV_GRAD_DIR_NONE &&
+                               lv_obj_get_style_bg_img_src(parent, LV_PART_MAIN) == NULL;
+            lv_area_t parent_area;
+            lv_obj_get_coords(parent, &parent_area);
+            return (plain && _lv_area_is_in(area, &parent_area, lv_obj_get_style_radius(parent, LV_PART_MAIN))) ? parent : NULL;
+        }
+        if (!bsp_layer_is_transparent(parent)) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Snapshot is converted in place to RGB565 without alpha when it is opaque or composited onto bg_color,
+ * LVGL then copies it without blending. Each pixel moves to a lower offset, so no pixel is overwritten before it is read.
+ */
+static void bsp_layer_flatten(lv_img_dsc_t *img, const lv_color_t *bg_color)
+{
+    const uint32_t px = (uint32_t)img->header.w * img->header.h;
+    uint8_t *data = (uint8_t *)img->data;
+
+    for (uint32_t i = 0; i < px && bg_color == NULL; i++) {
+        if (data[i * LV_IMG_PX_SIZE_ALPHA_BYTE + LV_IMG_PX_SIZE_ALPHA_BYTE - 1] != LV_OPA_COVER) {
+            return;
+        }
+    }
+    for (uint32_t i = 0; i < px; i++) {
+        const uint8_t *in = &data[i * LV_IMG_PX_SIZE_ALPHA_BYTE];
+        const lv_opa_t opa = in[LV_IMG_PX_SIZE_ALPHA_BYTE - 1];
+        lv_color_t c;
+        memcpy(&c, in, sizeof(lv_color_t));
+        if (opa < LV_OPA_COVER) {
+            c = lv_color_mix(c, *bg_color, opa);
+        }
+        memcpy(&data[i * sizeof(lv_color_t)], &c, sizeof(lv_color_t));
+    }
+    img->header.cf = LV_IMG_CF_TRUE_COLOR;
+    img->data_size = px * sizeof(lv_color_t);
+}
+
+static void bsp_layer_set_bg(bsp_layer_t *layer, lv_obj_t *bg)
+{
+    if (layer->bg == bg) {
+        return;
+    }
+    if (layer->bg) {
+        lv_obj_remove_event_cb_with_user_data(layer->bg, bsp_layer_bg_event_cb, layer);
+    }
+    if (bg) {
+        lv_obj_add_event_cb(bg, bsp_layer_bg_event_cb, LV_EVENT_STYLE_CHANGED, layer);
+    }
+    layer->bg = bg;
+}
+
+static esp_err_t bsp_layer_render(bsp_layer_t *layer)
+{
+    lv_obj_update_layout(layer->root);
+    const uint32_t size = lv_snapshot_buf_size_needed(layer->root, LV_IMG_CF_TRUE_COLOR_ALPHA);
+    ESP_RETURN_ON_FALSE(size > 0, ESP_ERR_INVALID_SIZE, TAG, "Layer has no area");
+
+    if (size > layer->buf_size) {
+        free(layer->buf);
+        layer->buf_size = 0;
+        layer->buf = bsp_layer_alloc(size);
+        ESP_RETURN_ON_FALSE(layer->buf, ESP_ERR_NO_MEM, TAG, "Not enough memory for layer snapshot");
+        layer->buf_size = size;
+    }
+    ESP_RETURN_ON_FALSE(lv_snapshot_take_to_buf(layer->root, LV_IMG_CF_TRUE_COLOR_ALPHA, &layer->img, layer->buf, size) == LV_RES_OK,
+                        ESP_FAIL, TAG, "Layer snapshot failed");
+
+    /* Snapshot area, the same as lv_snapshot uses */
+    lv_area_t area;
+    const lv_coord_t ext = _lv_obj_get_ext_draw_size(layer->root);
+    lv_obj_get_coords(layer->root, &area);
+    lv_area_increase(&area, ext, ext);
+    lv_obj_t *bg = bsp_layer_find_bg(layer->root, &area);
+    const lv_color_t bg_color = bg ? lv_obj_get_style_bg_color(bg, LV_PART_MAIN) : lv_color_black();
+    bsp_layer_set_bg(layer, bg);
+    bsp_layer_flatten(&layer->img, bg ? &bg_color : NULL);
+    layer_stats.misses++;
+    layer->stale = false;
+
+    /* Snapshot covers the extended draw area, which is symmetric around the object */
+    lv_img_cache_invalidate_src(&layer->img);
+    lv_img_set_src(layer->proxy, &layer->img);
+    lv_obj_align_to(layer->proxy, layer->root, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_invalidate(layer->proxy);
+    return ESP_OK;
+}
+
+/* Rendered again by the timer, before the next refresh */
+static void bsp_layer_mark_stale(bsp_layer_t *layer)
+{
+    if (!layer->stale) {
+        layer->stale = true;
+        layer_stats.invalidations++;
+        lv_timer_resume(layer_timer);
+    }
+}
+
+static void bsp_layer_timer_cb(lv_timer_t *timer)
+{
+    for (int i = 0; i < BSP_LAYER_MAX; i++) {
+        if (layers[i].root && layers[i].stale && bsp_layer_render(&layers[i]) != ESP_OK) {
+            /* Keep drawing the old snapshot, next change retries */
+            layers[i].stale = false;
+        }
+    }
+    lv_timer_pause(timer);
+}
+
+static lv_obj_tree_walk_res_t bsp_layer_watch_cb(lv_obj_t *obj, void *user_data)
+{
+    lv_obj_add_event_cb(obj, bsp_layer_event_cb, LV_EVENT_ALL, user_data);
+    return LV_OBJ_TREE_WALK_NEXT;
+}
+
+static lv_obj_tree_walk_res_t bsp_layer_unwatch_cb(lv_obj_t *obj, void *user_data)
+{
+    lv_obj_remove_event_cb_with_user_data(obj, bsp_layer_event_cb, user_data);
+    return LV_OBJ_TREE_WALK_NEXT;
+}
+
+static void bsp_layer_release(bsp_layer_t *layer)
+{
+    bsp_layer_set_bg(layer, NULL);
+    if (layer->proxy) {
+        lv_obj_remove_event_cb_with_user_data(layer->proxy, bsp_layer_proxy_event_cb, layer);
+        lv_obj_del(layer->proxy);
+    }
+    free(layer->buf);
+    memset(layer, 0, sizeof(bsp_layer_t));
+}
+
+static void bsp_layer_event_cb(lv_event_t *e)
+{
+    bsp_layer_t *layer = lv_event_get_user_data(e);
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_DELETE:
+        if (lv_event_get_target(e) == layer->root) {
+            bsp_layer_release(layer);
+        }
+        return;
+    case LV_EVENT_CHILD_CREATED:
+        if (lv_event_get_param(e)) {
+            lv_obj_tree_walk(lv_event_get_param(e), bsp_layer_watch_cb, layer);
+        }
+        break;
+    case LV_EVENT_STYLE_CHANGED:
+    case LV_EVENT_SIZE_CHANGED:
+    case LV_EVENT_CHILD_CHANGED:
+    case LV_EVENT_VALUE_CHANGED:
+        break;
+    default:
+        return;
+    }
+
+    bsp_layer_mark_stale(layer);
+}
+
+static void bsp_layer_bg_event_cb(lv_event_t *e)
+{
+    bsp_layer_t *layer = lv_event_get_user_data(e);
+
+    /* Background color is part of the composited snapshot */
+    bsp_layer_mark_stale(layer);
+}
+
+static void bsp_layer_proxy_event_cb(lv_event_t *e)
+{
+    bsp_layer_t *layer = lv_event_get_user_data(e);
+
+    if (lv_event_get_code(e) == LV_EVENT_DRAW_MAIN_BEGIN) {
+        layer_stats.hits++;
+        if (layer->img.header.cf == LV_IMG_CF_TRUE_COLOR) {
+            layer_stats.blits++;
+        } else {
+            layer_stats.blends++;
+        }
+    } else if (lv_event_get_code(e) == LV_EVENT_DELETE) {
+        /* Deleted together with the parent of the cached subtree */
+        layer->proxy = NULL;
+    }
+}
+
+esp_err_t bsp_display_layer_cache(lv_obj_t *obj)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(obj && lv_obj_get_parent(obj), ESP_ERR_INVALID_ARG, TAG, "Screens can not be cached");
+    if (bsp_layer_find(obj)) {
+        return ESP_OK;
+    }
+    bsp_layer_t *layer = bsp_layer_find(NULL);
+    ESP_RETURN_ON_FALSE(layer, ESP_ERR_NO_MEM, TAG, "Too many cached layers");
+
+    if (layer_timer == NULL) {
+        layer_timer = lv_timer_create(bsp_layer_timer_cb, 0, NULL);
+        ESP_RETURN_ON_FALSE(layer_timer, ESP_ERR_NO_MEM, TAG, "Layer timer create fail");
+        lv_timer_pause(layer_timer);
+    }
+
+    layer->proxy = lv_img_create(lv_obj_get_parent(obj));
+    ESP_RETURN_ON_FALSE(layer->proxy, ESP_ERR_NO_MEM, TAG, "Layer proxy create fail");
+    lv_obj_move_to_index(layer->proxy, lv_obj_get_index(obj) + 1);
+    lv_obj_add_flag(layer->proxy, LV_OBJ_FLAG_IGNORE_LAYOUT);
+    lv_obj_clear_flag(layer->proxy, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(layer->proxy, bsp_layer_proxy_event_cb, LV_EVENT_ALL, layer);
+    layer->root = obj;
+
+    ESP_GOTO_ON_ERROR(bsp_layer_render(layer), err, TAG, "");
+    lv_obj_tree_walk(obj, bsp_layer_watch_cb, layer);
+    lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    return ESP_OK;
+
+err:
+    bsp_layer_release(layer);
+    return ret;
+}
+
+esp_err_t bsp_display_layer_invalidate(lv_obj_t *obj)
+{
+    bsp_layer_t *layer = obj ? bsp_layer_find(obj) : NULL;
+    ESP_RETURN_ON_FALSE(layer, ESP_ERR_NOT_FOUND, TAG, "Object is not cached");
+
+    bsp_layer_mark_stale(layer);
+    return ESP_OK;
+}
+
+esp_err_t bsp_display_layer_uncache(lv_obj_t *obj)
+{
+    bsp_layer_t *layer = obj ? bsp_layer_find(obj) : NULL;
+    ESP_RETURN_ON_FALSE(layer, ESP_ERR_NOT_FOUND, TAG, "Object is not cached");
+
+    lv_obj_tree_walk(obj, bsp_layer_unwatch_cb, layer);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    bsp_layer_release(layer);
+    return ESP_OK;
+}
+
+esp_err_t bsp_display_get_layer_stats(bsp_display_layer_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    *stats = layer_stats;
+    stats->layers = 0;
+    stats->opaque_layers = 0;
+    stats->bytes = 0;
+    for (int i = 0; i < BSP_LAYER_MAX; i++) {
+        if (layers[i].root) {
+            stats->layers++;
+            stats->opaque_layers += (layers[i].img.header.cf == LV_IMG_CF_TRUE_COLOR);
+            stats->bytes += layers[i].buf_size;
+        }
+    }
+    return ESP_OK;
+}
+
+void bsp_display_reset_layer_stats(void)
+{
+    layer_stats.hits = 0;
+    layer_stats.blits = 0;
+    layer_stats.blends = 0;
+    layer_stats.misses = 0;
+    layer_stats.invalidations = 0;
+}
+#else
+esp_err_t bsp_display_layer_cache(lv_obj_t *obj)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_display_layer_invalidate(lv_obj_t *obj)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_display_layer_uncache(lv_obj_t *obj)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_display_get_layer_stats(bsp_display_layer_stats_t *stats)
+{
+    ESP_LOGD(TAG, "Layer cache is disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void bsp_display_reset_layer_stats(void)
+{
+}
+#endif // CONFIG_BSP_DISPLAY_LAYER_CACHE && LV_USE_SNAPSHOT
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Adaptive frame pacing
+ *
+ * The LVGL refresh and touch read timers are wrapped, so their periods follow what is on the screen:
+ *  - animations, touch drags and areas invalidated frame after frame: short refresh and read period,
+ *  - single updates: default LVGL periods,
+ *  - nothing invalidated: refresh timer is paused until LVGL resumes it on the next invalidation,
+ *    and after an idle timeout the touch is read only rarely. With CONFIG_BSP_TOUCH_INTERRUPT
+ *    the touch read timer is paused after release and resumed by the touch interrupt.
+ * With CONFIG_LV_TICK_CUSTOM LVGL reads time from esp_timer, so the periodic tick interrupt of
+ * esp_lvgl_port is stopped too. The LVGL task is woken when something is invalidated under bsp_display_lock(),
+ * when idle it still runs every task_max_sleep_ms, esp_lvgl_port does not sleep longer.
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_lvgl_port.h"
+
+#include "bsp/m5stack_core_s3.h"
+#include "bsp_display_priv.h"
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0) && CONFIG_BSP_DISPLAY_PACING
+
+static const char *TAG = "M5Stack";
+
+/* Number of frames in a row with invalidated areas, after which the screen is treated as animating */
+#define BSP_PACING_ANIM_STREAK  (2)
+
+typedef struct {
+    lv_disp_t *disp;
+    lv_indev_t *indev;
+    lv_indev_read_cb_t read_cb;     /* Original touch read callback */
+    TaskHandle_t task;              /* LVGL task, known after the first refresh */
+    uint32_t last_activity;         /* LVGL tick of the last invalidation or touch */
+    uint8_t dirty_streak;
+    bool pressed;
+} bsp_pacing_ctx_t;
+
+static bsp_pacing_ctx_t pacing;
+
+static void bsp_pacing_set_period(lv_timer_t *timer, uint32_t period)
+{
+    if (timer->period != period) {
+        lv_timer_set_period(timer, period);
+    }
+}
+
+static void bsp_pacing_update_indev(void)
+{
+    if (pacing.indev == NULL) {
+        return;
+    }
+
+    uint32_t period = CONFIG_BSP_DISPLAY_PACING_IDLE_TOUCH_PERIOD;
+    if (pacing.pressed) {
+        period = CONFIG_BSP_DISPLAY_PACING_ACTIVE_PERIOD;
+    } else if (lv_tick_elaps(pacing.last_activity) < CONFIG_BSP_DISPLAY_PACING_IDLE_TIMEOUT) {
+        period = LV_INDEV_DEF_READ_PERIOD;
+    }
+    bsp_pacing_set_period(pacing.indev->driver->read_timer, period);
+}
+
+static void bsp_pacing_refr_timer_cb(lv_timer_t *timer)
+{
+    const bool dirty = (pacing.disp->inv_p > 0);
+    pacing.task = xTaskGetCurrentTaskHandle();
+
+    _lv_disp_refr_timer(timer);
+
+    pacing.dirty_streak = dirty ? LV_MIN(pacing.dirty_streak + 1, UINT8_MAX) : 0;
+    const bool animating = pacing.pressed || lv_anim_count_running() > 0 || pacing.dirty_streak >= BSP_PACING_ANIM_STREAK;
+    if (dirty || animating) {
+        pacing.last_activity = lv_tick_get();
+    }
+
+    bsp_pacing_set_period(timer, animating ? CONFIG_BSP_DISPLAY_PACING_ACTIVE_PERIOD : LV_DISP_DEF_REFR_PERIOD);
+    if (!animating && pacing.disp->inv_p == 0) {
+        /* Nothing to render, LVGL resumes the timer on the next invalidation */
+        lv_timer_pause(timer);
+    }
+    bsp_pacing_update_indev();
+}
+
+static void bsp_pacing_read_cb(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    pacing.read_cb(drv, data);
+
+    pacing.pressed = (data->state == LV_INDEV_STATE_PRESSED);
+    if (pacing.pressed) {
+        pacing.last_activity = lv_tick_get();
+    }
+    bsp_pacing_update_indev();
+}
+
+esp_err_t bsp_display_pacing_init(lv_disp_t *disp, lv_indev_t *indev)
+{
+    ESP_RETURN_ON_FALSE(disp && disp->refr_timer, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    bsp_display_lock(0);
+    pacing.disp = disp;
+    pacing.last_activity = lv_tick_get();
+    lv_timer_set_cb(disp->refr_timer, bsp_pacing_refr_timer_cb);
+    if (indev) {
+        pacing.indev = indev;
+        pacing.read_cb = indev->driver->read_cb;
+        indev->driver->read_cb = bsp_pacing_read_cb;
+    }
+#if CONFIG_LV_TICK_CUSTOM
+    /* LVGL reads the time from esp_timer, the periodic tick interrupt of the port is not needed */
+    lvgl_port_stop();
+    lv_timer_enable(true);
+#endif
+    bsp_display_unlock();
+
+    return ESP_OK;
+}
+
+void bsp_display_pacing_unlock(void)
+{
+    /* LVGL task may be sleeping through idle, wake it if something was invalidated under the lock */
+    const bool wake = pacing.disp && pacing.task && pacing.disp->inv_p > 0;
+    lvgl_port_unlock();
+    if (wake && pacing.task != xTaskGetCurrentTaskHandle()) {
+        xTaskAbortDelay(pacing.task);
+    }
+}
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0) && CONFIG_BSP_DISPLAY_PACING
@@ -0,0 +1,244 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * LCD SPI clock calibration
+ *
+ * Test patterns are written to a small window of the frame memory at increasing SPI clocks
+ * and read back (RAMRD) at a slow clock. The reference readback is taken with patterns written at
+ * BSP_LCD_PIXEL_CLOCK_HZ, so the pixel format of RAMRD does not need to be decoded.
+ * The clock one step below the fastest one, for which all lower clocks passed too, is stored in NVS
+ * and used on next boots. A panel which cannot be read back is stored as well, so it is not probed again.
+ * Boards with MISO on the D/C pin (BSP_LCD_MISO_IS_DC) have no readback, the calibration is not compiled there.
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_commands.h"
+#include "driver/spi_master.h"
+#include "nvs.h"
+
+#include "bsp/m5stack_core_s3.h"
+#include "bsp/display.h"
+#include "bsp_display_priv.h"
+
+static const char *TAG = "M5Stack";
+
+#define BSP_PCLK_NVS_NAMESPACE  "bsp_lcd"
+#define BSP_PCLK_NVS_KEY        "pclk_hz"
+#define BSP_PCLK_SRC_HZ         (80 * 1000 * 1000)
+#define BSP_PCLK_READ_HZ        (5 * 1000 * 1000)   /* ILI9341 read cycle is at least 150 ns */
+#define BSP_PCLK_STEP_HZ        (1 * 1000 * 1000)
+#define BSP_PCLK_ROUNDS         (3)
+#define BSP_PCLK_TEST_W         (32)
+#define BSP_PCLK_TEST_H         (2)
+#define BSP_PCLK_TEST_PX        (BSP_PCLK_TEST_W * BSP_PCLK_TEST_H)
+#define BSP_PCLK_READ_LEN       (1 + BSP_PCLK_TEST_PX * 3)  /* Dummy byte and 3 bytes per pixel */
+#define BSP_PCLK_UNSUPPORTED    (0)     /* Stored instead of a clock when the readback does not work */
+
+static uint32_t pclk_hz = BSP_LCD_PIXEL_CLOCK_HZ;
+
+#if BSP_DISPLAY_PCLK_CALIBRATION
+static esp_err_t bsp_pclk_new_io(const esp_lcd_panel_io_spi_config_t *io_config, uint32_t hz, esp_lcd_panel_io_handle_t *io)
+{
+    esp_lcd_panel_io_spi_config_t cfg = *io_config;
+    cfg.pclk_hz = hz;
+    cfg.on_color_trans_done = NULL;
+    return esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)BSP_LCD_SPI_NUM, &cfg, io);
+}
+
+static esp_err_t bsp_pclk_set_window(esp_lcd_panel_io_handle_t io)
+{
+    const uint8_t caset[] = {0, 0, 0, BSP_PCLK_TEST_W - 1};
+    const uint8_t raset[] = {0, 0, 0, BSP_PCLK_TEST_H - 1};
+    ESP_RETURN_ON_ERROR(esp_lcd_panel_io_tx_param(io, LCD_CMD_CASET, caset, sizeof(caset)), TAG, "");
+    return esp_lcd_panel_io_tx_param(io, LCD_CMD_RASET, raset, sizeof(raset));
+}
+
+static void bsp_pclk_pattern(uint16_t *px, uint32_t seed)
+{
+    /* xorshift32, every round covers different bit transitions */
+    uint32_t x = seed * 2654435761u + 1;
+    for (int i = 0; i < BSP_PCLK_TEST_PX; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        px[i] = (uint16_t)x;
+    }
+}
+
+static esp_err_t bsp_pclk_write(const esp_lcd_panel_io_spi_config_t *io_config, uint32_t hz, const uint16_t *px)
+{
+    esp_err_t ret = ESP_OK;
+    esp_lcd_panel_io_handle_t io = NULL;
+
+    ESP_RETURN_ON_ERROR(bsp_pclk_new_io(io_config, hz, &io), TAG, "New panel IO failed");
+    ESP_GOTO_ON_ERROR(bsp_pclk_set_window(io), err, TAG, "");
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_tx_color(io, LCD_CMD_RAMWR, px, BSP_PCLK_TEST_PX * sizeof(uint16_t)), err, TAG, "");
+    /* Parameter transfers wait for the queued color transfer */
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_tx_param(io, LCD_CMD_NOP, NULL, 0), err, TAG, "");
+err:
+    esp_lcd_panel_io_del(io);
+    return ret;
+}
+
+static esp_err_t bsp_pclk_read(const esp_lcd_panel_io_spi_config_t *io_config, uint8_t *data)
+{
+    esp_err_t ret = ESP_OK;
+    esp_lcd_panel_io_handle_t io = NULL;
+
+    ESP_RETURN_ON_ERROR(bsp_pclk_new_io(io_config, BSP_PCLK_READ_HZ, &io), TAG, "New panel IO failed");
+    ESP_GOTO_ON_ERROR(bsp_pclk_set_window(io), err, TAG, "");
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_rx_param(io, LCD_CMD_RAMRD, data, BSP_PCLK_READ_LEN), err, TAG, "");
+err:
+    esp_lcd_panel_io_del(io);
+    return ret;
+}
+
+/* Controller must be awake and in 16-bit pixel format to accept RAMWR */
+static esp_err_t bsp_pclk_wake_controller(const esp_lcd_panel_io_spi_config_t *io_config)
+{
+    esp_err_t ret = ESP_OK;
+    esp_lcd_panel_io_handle_t io = NULL;
+    const uint8_t colmod = 0x55;
+
+    ESP_RETURN_ON_ERROR(bsp_pclk_new_io(io_config, io_config->pclk_hz, &io), TAG, "New panel IO failed");
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_tx_param(io, LCD_CMD_SWRESET, NULL, 0), err, TAG, "");
+    vTaskDelay(pdMS_TO_TICKS(120));
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_tx_param(io, LCD_CMD_SLPOUT, NULL, 0), err, TAG, "");
+    vTaskDelay(pdMS_TO_TICKS(120));
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_tx_param(io, LCD_CMD_COLMOD, &colmod, 1), err, TAG, "");
+err:
+    esp_lcd_panel_io_del(io);
+    return ret;
+}
+
+static esp_err_t bsp_pclk_calibrate(const esp_lcd_panel_io_spi_config_t *io_config, uint32_t *best_hz)
+{
+    esp_err_t ret = ESP_OK;
+    uint16_t *px = heap_caps_malloc(BSP_PCLK_TEST_PX * sizeof(uint16_t), MALLOC_CAP_DMA);
+    uint8_t *ref = heap_caps_malloc(BSP_PCLK_ROUNDS * BSP_PCLK_READ_LEN, MALLOC_CAP_DMA);
+    uint8_t *data = heap_caps_malloc(BSP_PCLK_READ_LEN, MALLOC_CAP_DMA);
+    ESP_GOTO_ON_FALSE(px && ref && data, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for calibration");
+
+    ESP_GOTO_ON_ERROR(bsp_pclk_wake_controller(io_config), err, TAG, "");
+
+    /* Reference readback of patterns written at the default clock */
+    for (int r = 0; r < BSP_PCLK_ROUNDS; r++) {
+        bsp_pclk_pattern(px, r);
+        ESP_GOTO_ON_ERROR(bsp_pclk_write(io_config, io_config->pclk_hz, px), err, TAG, "");
+        ESP_GOTO_ON_ERROR(bsp_pclk_read(io_config, ref + r * BSP_PCLK_READ_LEN), err, TAG, "");
+    }
+    /* Without a working MISO line every readback is the same */
+    ESP_GOTO_ON_FALSE(memcmp(ref, ref + BSP_PCLK_READ_LEN, BSP_PCLK_READ_LEN) != 0, ESP_ERR_NOT_SUPPORTED, err, TAG,
+                      "LCD readback does not work");
+
+    /* The last stable clock has no margin, the one below it is used */
+    uint32_t stable_hz = io_config->pclk_hz;
+    *best_hz = io_config->pclk_hz;
+    int last_hz = spi_get_actual_clock(BSP_PCLK_SRC_HZ, io_config->pclk_hz, 128);
+    for (int hz = io_config->pclk_hz + BSP_PCLK_STEP_HZ; hz <= CONFIG_BSP_DISPLAY_PCLK_MAX_MHZ * 1000 * 1000; hz += BSP_PCLK_STEP_HZ) {
+        const int actual_hz = spi_get_actual_clock(BSP_PCLK_SRC_HZ, hz, 128);
+        if (actual_hz <= last_hz) {
+            continue;
+        }
+        last_hz = actual_hz;
+
+        bool stable = true;
+        for (int r = 0; r < BSP_PCLK_ROUNDS && stable; r++) {
+            bsp_pclk_pattern(px, r);
+            ESP_GOTO_ON_ERROR(bsp_pclk_write(io_config, actual_hz, px), err, TAG, "");
+            ESP_GOTO_ON_ERROR(bsp_pclk_read(io_config, data), err, TAG, "");
+            stable = (memcmp(data, ref + r * BSP_PCLK_READ_LEN, BSP_PCLK_READ_LEN) == 0);
+        }
+        ESP_LOGD(TAG, "LCD clock %d Hz: %s", actual_hz, stable ? "stable" : "corrupted");
+        if (!stable) {
+            break;
+        }
+        *best_hz = stable_hz;
+        stable_hz = actual_hz;
+    }
+
+err:
+    heap_caps_free(px);
+    heap_caps_free(ref);
+    heap_caps_free(data);
+    return ret;
+}
+
+uint32_t bsp_display_pclk_select(const esp_lcd_panel_io_spi_config_t *io_config)
+{
+    nvs_handle_t nvs;
+    uint32_t hz = io_config->pclk_hz;
+
+    esp_err_t ret = nvs_open(BSP_PCLK_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK && nvs_get_u32(nvs, BSP_PCLK_NVS_KEY, &hz) == ESP_OK) {
+        nvs_close(nvs);
+        if (hz == BSP_PCLK_UNSUPPORTED) {
+            hz = io_config->pclk_hz;
+            ESP_LOGI(TAG, "LCD clock %"PRIu32" Hz (readback not supported)", hz);
+        } else {
+            ESP_LOGI(TAG, "LCD clock %"PRIu32" Hz (calibrated)", hz);
+        }
+        pclk_hz = hz;
+        return hz;
+    }
+
+    uint32_t stored_hz = BSP_PCLK_UNSUPPORTED;
+    bool store = true;
+    const esp_err_t cal_ret = bsp_pclk_calibrate(io_config, &hz);
+    if (cal_ret == ESP_OK) {
+        ESP_LOGI(TAG, "LCD clock calibrated to %"PRIu32" Hz", hz);
+        stored_hz = hz;
+    } else {
+        /* Other failures may be temporary, calibration runs again on next boot */
+        store = (cal_ret == ESP_ERR_NOT_SUPPORTED);
+        hz = io_config->pclk_hz;
+        ESP_LOGW(TAG, "LCD clock calibration failed (%s), using %"PRIu32" Hz", esp_err_to_name(cal_ret), hz);
+    }
+    if (store) {
+        if (ret == ESP_OK) {
+            nvs_set_u32(nvs, BSP_PCLK_NVS_KEY, stored_hz);
+            nvs_commit(nvs);
+        } else {
+            ESP_LOGW(TAG, "NVS not available (%s), calibration is not stored", esp_err_to_name(ret));
+        }
+    }
+    if (ret == ESP_OK) {
+        nvs_close(nvs);
+    }
+
+    pclk_hz = hz;
+    return hz;
+}
+#endif // BSP_DISPLAY_PCLK_CALIBRATION
+
+uint32_t bsp_display_get_pclk_hz(void)
+{
+    return pclk_hz;
+}
+
+esp_err_t bsp_display_pclk_forget(void)
+{
+    nvs_handle_t nvs;
+
+    ESP_RETURN_ON_ERROR(nvs_open(BSP_PCLK_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "NVS open failed");
+    esp_err_t ret = nvs_erase_key(nvs, BSP_PCLK_NVS_KEY);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs);
+    } else if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        ret = ESP_OK;
+    }
+    nvs_close(nvs);
+    return ret;
+}
@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Draw buffer auto tuning
+ *
+ * Free DMA capable memory is probed before the SPI bus is initialized, so that max_transfer_sz
+ * covers the largest buffer which fits into the memory budget. Once the panel is initialized, before LVGL
+ * draws anything, a full frame is sent in bands of several candidate heights. The smallest height which is within
+ * a few percent of the fastest one is chosen and the rest of the budget is spent on more buffers.
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+
+#include "bsp/m5stack_core_s3.h"
+#include "bsp_display_priv.h"
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+
+static const char *TAG = "M5Stack";
+
+/* Buffers never take more than 1/BSP_TUNE_HEAP_SHARE of free DMA memory, the rest is left to the application */
+#define BSP_TUNE_HEAP_SHARE     (2)
+/* Smaller buffer is chosen when its frame time is within this many percent of the fastest one */
+#define BSP_TUNE_TOLERANCE_PCT  (5)
+#define BSP_TUNE_TIMEOUT_MS     (1000)
+#define BSP_TUNE_LINE_BYTES     (BSP_LCD_H_RES * sizeof(lv_color_t))
+
+/* Candidate buffer heights in lines */
+static const uint16_t bsp_tune_lines[] = {10, 16, 20, 24, 30, 40, 48, 60, 80, 120};
+
+static bsp_display_buffer_info_t tune_info;
+
+static bool bsp_tune_trans_done(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    BaseType_t need_yield = pdFALSE;
+    xSemaphoreGiveFromISR((SemaphoreHandle_t)user_ctx, &need_yield);
+    return (need_yield == pdTRUE);
+}
+
+uint32_t bsp_display_tune_probe(uint32_t budget)
+{
+    const size_t dma_free = heap_caps_get_free_size(MALLOC_CAP_DMA);
+    const size_t dma_largest = heap_caps_get_largest_free_block(MALLOC_CAP_DMA);
+
+    tune_info.budget = LV_MIN(budget, dma_free / BSP_TUNE_HEAP_SHARE);
+    tune_info.dma_free = dma_free;
+    tune_info.dma_largest = dma_largest;
+
+    /* At least two buffers must fit, so that rendering overlaps with the transfer */
+    uint32_t max_lines = tune_info.budget / 2 / BSP_TUNE_LINE_BYTES;
+    max_lines = LV_MIN(max_lines, dma_largest / BSP_TUNE_LINE_BYTES);
+    max_lines = LV_MIN(max_lines, BSP_LCD_V_RES);
+
+    ESP_LOGD(TAG, "DMA memory: %u free, %u largest block, up to %"PRIu32" lines per buffer",
+             (unsigned)dma_free, (unsigned)dma_largest, max_lines);
+    return max_lines;
+}
+
+/* Send one full frame in bands of the given height and wait until all of them are transferred */
+static esp_err_t bsp_tune_measure(esp_lcd_panel_handle_t panel, SemaphoreHandle_t done, const void *buf, uint32_t lines, uint32_t *frame_us)
+{
+    const int64_t start = esp_timer_get_time();
+    uint32_t bands = 0;
+
+    for (uint32_t y = 0; y < BSP_LCD_V_RES; y += lines) {
+        const uint32_t y_end = LV_MIN(y + lines, BSP_LCD_V_RES);
+        ESP_RETURN_ON_ERROR(esp_lcd_panel_draw_bitmap(panel, 0, y, BSP_LCD_H_RES, y_end, buf), TAG, "Draw bitmap failed");
+        bands++;
+    }
+    for (uint32_t i = 0; i < bands; i++) {
+        ESP_RETURN_ON_FALSE(xSemaphoreTake(done, pdMS_TO_TICKS(BSP_TUNE_TIMEOUT_MS)) == pdTRUE, ESP_ERR_TIMEOUT, TAG, "Calibration flush timeout");
+    }
+
+    *frame_us = (uint32_t)(esp_timer_get_time() - start);
+    return ESP_OK;
+}
+
+esp_err_t bsp_display_tune(esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t io, uint32_t max_lines, bsp_display_cfg_t *cfg)
+{
+    esp_err_t ret = ESP_OK;
+    const esp_lcd_panel_io_callbacks_t no_cbs = {0};
+    uint32_t best_us = UINT32_MAX;
+    uint32_t frame_us[sizeof(bsp_tune_lines) / sizeof(bsp_tune_lines[0]) + 1] = {0};
+    uint16_t lines[sizeof(bsp_tune_lines) / sizeof(bsp_tune_lines[0]) + 1];
+    int candidates = 0;
+
+    ESP_RETURN_ON_FALSE(cfg && max_lines > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    for (size_t i = 0; i < sizeof(bsp_tune_lines) / sizeof(bsp_tune_lines[0]) && bsp_tune_lines[i] < max_lines; i++) {
+        lines[candidates++] = bsp_tune_lines[i];
+    }
+    /* Always try the largest buffer which fits */
+    lines[candidates++] = max_lines;
+
+    /* Panel init already turned the display on, the zeroed calibration frames show as a black screen */
+    void *buf = heap_caps_calloc(max_lines, BSP_TUNE_LINE_BYTES, MALLOC_CAP_DMA);
+    ESP_RETURN_ON_FALSE(buf, ESP_ERR_NO_MEM, TAG, "Not enough memory for calibration buffer");
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(BSP_LCD_V_RES, 0);
+    ESP_GOTO_ON_FALSE(done, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for calibration semaphore");
+
+    const esp_lcd_panel_io_callbacks_t cbs = {
+        .on_color_trans_done = bsp_tune_trans_done,
+    };
+    ESP_GOTO_ON_ERROR(esp_lcd_panel_io_register_event_callbacks(io, &cbs, done), err, TAG, "Register IO callbacks failed");
+
+    for (int i = 0; i < candidates; i++) {
+        ESP_GOTO_ON_ERROR(bsp_tune_measure(panel, done, buf, lines[i], &frame_us[i]), err, TAG, "");
+        best_us = LV_MIN(best_us, frame_us[i]);
+        ESP_LOGD(TAG, "%u lines: %"PRIu32" us per frame", lines[i], frame_us[i]);
+    }
+
+    /* Smallest buffer which is about as fast as the fastest one leaves more of the budget for buffers in flight */
+    int chosen = candidates - 1;
+    for (int i = 0; i < candidates; i++) {
+        if ((uint64_t)frame_us[i] * 100 <= (uint64_t)best_us * (100 + BSP_TUNE_TOLERANCE_PCT)) {
+            chosen = i;
+            break;
+        }
+    }
+
+    const uint32_t buf_bytes = lines[chosen] * BSP_TUNE_LINE_BYTES;
+    const uint32_t count = LV_MAX(1, LV_MIN(BSP_DISPLAY_FLUSH_BUFS_MAX, tune_info.budget / buf_bytes));
+    if (cfg->flags.full_frame) {
+        cfg->bounce_buffer_size = lines[chosen] * BSP_LCD_H_RES;
+    } else {
+        cfg->buffer_size = lines[chosen] * BSP_LCD_H_RES;
+    }
+    cfg->buffer_count = count;
+
+    tune_info.auto_tuned = true;
+    tune_info.frame_us = frame_us[chosen];
+    ESP_LOGI(TAG, "Draw buffers tuned: %"PRIu32" x %u lines, %"PRIu32" us per frame (budget %"PRIu32" B)",
+             count, lines[chosen], frame_us[chosen], tune_info.budget);
+
+err:
+    /* Flush engine registers its own callbacks */
+    esp_lcd_panel_io_register_event_callbacks(io, &no_cbs, NULL);
+    if (done) {
+        vSemaphoreDelete(done);
+    }
+    heap_caps_free(buf);
+    return ret;
+}
+
+void bsp_display_tune_get_info(bsp_display_buffer_info_t *info)
+{
+    info->auto_tuned = tune_info.auto_tuned;
+    info->budget = tune_info.budget;
+    info->dma_free = tune_info.dma_free;
+    info->dma_largest = tune_info.dma_largest;
+    info->frame_us = tune_info.frame_us;
+}
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
@@ -0,0 +1,440 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * I2C transaction engine
+ *
+ * Register accesses of the BSP are queued per priority lane and executed by the I2C task, a counting
+ * semaphore holds the number of queued transactions of all lanes. Every transaction is bounded by
+ * CONFIG_BSP_I2C_TIMEOUT_MS, so a NACKing or clock stretching device delays only its own callers.
+ * Synchronous calls wait on a semaphore which is given by the completion of their transaction.
+ *
+ * Init and deinit are serialized by a mutex. Callers which passed the initialized check are counted
+ * until they are done with the queues, deinit waits for them before the queues are deleted.
+ *
+ * Other drivers on the bus (touch panel IO, codecs, camera) use the I2C driver directly,
+ * the driver serializes them with the I2C task.
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/i2c.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/m5stack_core_s3.h"
+#include "bsp_err_check.h"
+#include "bsp_aw9523.h"
+
+static const char *TAG = "M5Stack";
+
+#define BSP_I2C_TASK_STACK      (3072)
+#define BSP_I2C_STATS_DEVICES   (8)
+
+typedef struct {
+    bsp_i2c_xfer_t xfer;
+    int64_t submit_us;
+} bsp_i2c_req_t;
+
+typedef struct {
+    uint8_t addr;                   /* 0 for an unused entry */
+    bsp_i2c_dev_stats_t stats;
+} bsp_i2c_dev_t;
+
+typedef struct {
+    bool initialized;
+    uint32_t inflight;              /* Callers of bsp_i2c_queue using the queues */
+    SemaphoreHandle_t init_lock;    /* Serializes bsp_i2c_init and bsp_i2c_deinit */
+    volatile bool stop;
+    TaskHandle_t task;
+    QueueHandle_t lanes[BSP_I2C_LANE_MAX];
+    SemaphoreHandle_t pending;      /* Number of queued transactions of all lanes */
+    SemaphoreHandle_t stopped;
+    portMUX_TYPE lock;              /* Protects the statistics, initialized and inflight */
+    bsp_i2c_dev_t devs[BSP_I2C_STATS_DEVICES];
+} bsp_i2c_ctx_t;
+
+static bsp_i2c_ctx_t i2c_ctx = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+typedef struct {
+    SemaphoreHandle_t done;
+    StaticSemaphore_t done_buf;
+    esp_err_t result;
+} bsp_i2c_wait_t;
+
+/* Must be called with the lock taken, the entry is claimed for a new address */
+static bsp_i2c_dev_stats_t *bsp_i2c_stats_find(uint8_t addr)
+{
+    bsp_i2c_dev_t *free_dev = NULL;
+    for (int i = 0; i < BSP_I2C_STATS_DEVICES; i++) {
+        if (i2c_ctx.devs[i].addr == addr) {
+            return &i2c_ctx.devs[i].stats;
+        }
+        if (free_dev == NULL && i2c_ctx.devs[i].addr == 0) {
+            free_dev = &i2c_ctx.devs[i];
+        }
+    }
+    if (free_dev == NULL) {
+        return NULL;
+    }
+    free_dev->addr = addr;
+    memset(&free_dev->stats, 0, sizeof(bsp_i2c_dev_stats_t));
+    return &free_dev->stats;
+}
+
+static esp_err_t bsp_i2c_execute(const bsp_i2c_req_t *req)
+{
+    const bsp_i2c_xfer_t *xfer = &req->xfer;
+    const TickType_t ticks = pdMS_TO_TICKS(CONFIG_BSP_I2C_TIMEOUT_MS) + 1;
+    const int64_t start_us = esp_timer_get_time();
+    esp_err_t ret;
+
+    if (xfer->read_len == 0) {
+        ret = i2c_master_write_to_device(BSP_I2C_NUM, xfer->addr, xfer->write, xfer->write_len, ticks);
+    } else if (xfer->write_len == 0) {
+        ret = i2c_master_read_from_device(BSP_I2C_NUM, xfer->addr, xfer->read, xfer->read_len, ticks);
+    } else {
+        ret = i2c_master_write_read_device(BSP_I2C_NUM, xfer->addr, xfer->write, xfer->write_len, xfer->read, xfer->read_len, ticks);
+    }
+    const int64_t end_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&i2c_ctx.lock);
+    bsp_i2c_dev_stats_t *stats = bsp_i2c_stats_find(xfer->addr);
+    if (stats) {
+        const uint32_t bus_us = end_us - start_us;
+        const uint32_t wait_us = start_us - req->submit_us;
+        stats->transfers++;
+        stats->errors += (ret != ESP_OK);
+        stats->timeouts += (ret == ESP_ERR_TIMEOUT);
+        stats->bus_us += bus_us;
+        if (bus_us > stats->max_us) {
+            stats->max_us = bus_us;
+        }
+        if (wait_us > stats->max_wait_us) {
+            stats->max_wait_us = wait_us;
+        }
+    }
+    portEXIT_CRITICAL(&i2c_ctx.lock);
+
+    if (xfer->done_cb) {
+        xfer->done_cb(ret, xfer->user_ctx);
+    }
+    return ret;
+}
+
+static bool bsp_i2c_next(bsp_i2c_req_t *req)
+{
+    for (int lane = 0; lane < BSP_I2C_LANE_MAX; lane++) {
+        if (xQueueReceive(i2c_ctx.lanes[lane], req, 0) == pdTRUE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void bsp_i2c_task(void *arg)
+{
+    bsp_i2c_req_t req;
+
+    while (!i2c_ctx.stop) {
+        xSemaphoreTake(i2c_ctx.pending, portMAX_DELAY);
+        if (!i2c_ctx.stop && bsp_i2c_next(&req)) {
+            bsp_i2c_execute(&req);
+        }
+    }
+    /* Waiting callers must not hang */
+    while (bsp_i2c_next(&req)) {
+        if (req.xfer.done_cb) {
+            req.xfer.done_cb(ESP_ERR_INVALID_STATE, req.xfer.user_ctx);
+        }
+    }
+    xSemaphoreGive(i2c_ctx.stopped);
+    vTaskDelete(NULL);
+}
+
+static void bsp_i2c_engine_free(void)
+{
+    for (int lane = 0; lane < BSP_I2C_LANE_MAX; lane++) {
+        if (i2c_ctx.lanes[lane]) {
+            vQueueDelete(i2c_ctx.lanes[lane]);
+            i2c_ctx.lanes[lane] = NULL;
+        }
+    }
+    if (i2c_ctx.pending) {
+        vSemaphoreDelete(i2c_ctx.pending);
+        i2c_ctx.pending = NULL;
+    }
+    if (i2c_ctx.stopped) {
+        vSemaphoreDelete(i2c_ctx.stopped);
+        i2c_ctx.stopped = NULL;
+    }
+}
+
+static esp_err_t bsp_i2c_engine_start(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    for (int lane = 0; lane < BSP_I2C_LANE_MAX; lane++) {
+        i2c_ctx.lanes[lane] = xQueueCreate(CONFIG_BSP_I2C_QUEUE_LEN, sizeof(bsp_i2c_req_t));
+        ESP_GOTO_ON_FALSE(i2c_ctx.lanes[lane], ESP_ERR_NO_MEM, err, TAG, "Not enough memory for I2C queues");
+    }
+    i2c_ctx.pending = xSemaphoreCreateCounting(CONFIG_BSP_I2C_QUEUE_LEN * BSP_I2C_LANE_MAX, 0);
+    i2c_ctx.stopped = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(i2c_ctx.pending && i2c_ctx.stopped, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for I2C semaphores");
+
+    i2c_ctx.stop = false;
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(bsp_i2c_task, "BSP I2C", BSP_I2C_TASK_STACK, NULL, CONFIG_BSP_I2C_TASK_PRIORITY,
+                      &i2c_ctx.task, tskNO_AFFINITY) == pdPASS, ESP_ERR_NO_MEM, err, TAG, "Create I2C task fail");
+    return ESP_OK;
+
+err:
+    bsp_i2c_engine_free();
+    return ret;
+}
+
+static void bsp_i2c_engine_stop(void)
+{
+    i2c_ctx.stop = true;
+    xSemaphoreGive(i2c_ctx.pending);
+    xSemaphoreTake(i2c_ctx.stopped, portMAX_DELAY);
+    i2c_ctx.task = NULL;
+    bsp_i2c_engine_free();
+}
+
+/* Created on first use, concurrent first calls keep only one mutex */
+static SemaphoreHandle_t bsp_i2c_init_lock(void)
+{
+    if (i2c_ctx.init_lock == NULL) {
+        SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+        if (lock == NULL) {
+            return NULL;
+        }
+        portENTER_CRITICAL(&i2c_ctx.lock);
+        if (i2c_ctx.init_lock == NULL) {
+            i2c_ctx.init_lock = lock;
+            lock = NULL;
+        }
+        portEXIT_CRITICAL(&i2c_ctx.lock);
+        if (lock) {
+            vSemaphoreDelete(lock);
+        }
+    }
+    return i2c_ctx.init_lock;
+}
+
+/* The expander cache goes through the I2C task as well */
+static const bsp_aw9523_bus_t aw9523_bus = {
+    .read_regs = bsp_i2c_read_regs,
+    .transfer = bsp_i2c_transfer,
+};
+
+static esp_err_t bsp_i2c_install(void)
+{
+    /* I2C was initialized before */
+    if (i2c_ctx.initialized) {
+        return ESP_OK;
+    }
+
+    const i2c_config_t i2c_conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = BSP_I2C_SDA,
+        .sda_pullup_en = GPIO_PULLUP_DISABLE,
+        .scl_io_num = BSP_I2C_SCL,
+        .scl_pullup_en = GPIO_PULLUP_DISABLE,
+        .master.clk_speed = CONFIG_BSP_I2C_CLK_SPEED_HZ
+    };
+    BSP_ERROR_CHECK_RETURN_ERR(i2c_param_config(BSP_I2C_NUM, &i2c_conf));
+    BSP_ERROR_CHECK_RETURN_ERR(i2c_driver_install(BSP_I2C_NUM, i2c_conf.mode, 0, 0, 0));
+    if (bsp_aw9523_init(&aw9523_bus) != ESP_OK || bsp_i2c_engine_start() != ESP_OK) {
+        i2c_driver_delete(BSP_I2C_NUM);
+        BSP_ERROR_CHECK_RETURN_ERR(ESP_ERR_NO_MEM);
+    }
+
+    portENTER_CRITICAL(&i2c_ctx.lock);
+    i2c_ctx.initialized = true;
+    portEXIT_CRITICAL(&i2c_ctx.lock);
+
+    return ESP_OK;
+}
+
+esp_err_t bsp_i2c_init(void)
+{
+    SemaphoreHandle_t lock = bsp_i2c_init_lock();
+    if (lock == NULL) {
+        BSP_ERROR_CHECK_RETURN_ERR(ESP_ERR_NO_MEM);
+    }
+
+    /* Display and telemetry may start concurrently, only one of them installs the driver */
+    xSemaphoreTake(lock, portMAX_DELAY);
+    const esp_err_t ret = bsp_i2c_install();
+    xSemaphoreGive(lock);
+    return ret;
+}
+
+esp_err_t bsp_i2c_deinit(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    /* Never initialized */
+    if (i2c_ctx.init_lock == NULL) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(i2c_ctx.init_lock, portMAX_DELAY);
+    portENTER_CRITICAL(&i2c_ctx.lock);
+    const bool initialized = i2c_ctx.initialized;
+    i2c_ctx.initialized = false;
+    portEXIT_CRITICAL(&i2c_ctx.lock);
+
+    if (initialized) {
+        /* New transactions are refused. Callers already past the check finish their enqueue,
+         * the I2C task keeps running, so a full lane drains within the timeout of the caller. */
+        while (1) {
+            portENTER_CRITICAL(&i2c_ctx.lock);
+            const uint32_t inflight = i2c_ctx.inflight;
+            portEXIT_CRITICAL(&i2c_ctx.lock);
+            if (inflight == 0) {
+                break;
+            }
+            vTaskDelay(1);
+        }
+        /* Queued transactions fail */
+        bsp_i2c_engine_stop();
+        ret = i2c_driver_delete(BSP_I2C_NUM);
+    }
+    xSemaphoreGive(i2c_ctx.init_lock);
+    BSP_ERROR_CHECK_RETURN_ERR(ret);
+    return ESP_OK;
+}
+
+static esp_err_t bsp_i2c_queue(const bsp_i2c_xfer_t *xfer, TickType_t wait)
+{
+    ESP_RETURN_ON_FALSE(xfer && xfer->lane < BSP_I2C_LANE_MAX && xfer->write_len <= BSP_I2C_WRITE_MAX &&
+                        (xfer->read || xfer->read_len == 0) && (xfer->write_len || xfer->read_len),
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid I2C transaction");
+    portENTER_CRITICAL(&i2c_ctx.lock);
+    const bool initialized = i2c_ctx.initialized;
+    i2c_ctx.inflight += initialized;
+    portEXIT_CRITICAL(&i2c_ctx.lock);
+    ESP_RETURN_ON_FALSE(initialized, ESP_ERR_INVALID_STATE, TAG, "I2C is not initialized");
+
+    /* Queues stay valid until inflight drops back, deinit waits for it */
+    esp_err_t ret = ESP_OK;
+    const bsp_i2c_req_t req = {
+        .xfer = *xfer,
+        .submit_us = esp_timer_get_time(),
+    };
+    const bool queued = (xQueueSend(i2c_ctx.lanes[xfer->lane], &req, wait) == pdTRUE);
+    if (queued) {
+        xSemaphoreGive(i2c_ctx.pending);
+    }
+
+    portENTER_CRITICAL(&i2c_ctx.lock);
+    i2c_ctx.inflight--;
+    if (!queued) {
+        bsp_i2c_dev_stats_t *stats = bsp_i2c_stats_find(xfer->addr);
+        if (stats) {
+            stats->rejected++;
+        }
+        ret = wait ? ESP_ERR_TIMEOUT : ESP_ERR_NO_MEM;
+    }
+    portEXIT_CRITICAL(&i2c_ctx.lock);
+    return ret;
+}
+
+esp_err_t bsp_i2c_submit(const bsp_i2c_xfer_t *xfer)
+{
+    return bsp_i2c_queue(xfer, 0);
+}
+
+static void bsp_i2c_wait_done(esp_err_t result, void *user_ctx)
+{
+    bsp_i2c_wait_t *wait = user_ctx;
+    wait->result = result;
+    xSemaphoreGive(wait->done);
+}
+
+esp_err_t bsp_i2c_transfer(const bsp_i2c_xfer_t *xfer)
+{
+    bsp_i2c_wait_t wait;
+    bsp_i2c_req_t req = {
+        .submit_us = esp_timer_get_time(),
+    };
+
+    ESP_RETURN_ON_FALSE(xfer, ESP_ERR_INVALID_ARG, TAG, "Invalid I2C transaction");
+    req.xfer = *xfer;
+    req.xfer.done_cb = NULL;
+
+    /* Called from a completion callback, a queued transaction would never run */
+    if (i2c_ctx.task && xTaskGetCurrentTaskHandle() == i2c_ctx.task) {
+        return bsp_i2c_execute(&req);
+    }
+
+    wait.done = xSemaphoreCreateBinaryStatic(&wait.done_buf);
+    req.xfer.done_cb = bsp_i2c_wait_done;
+    req.xfer.user_ctx = &wait;
+    ESP_RETURN_ON_ERROR(bsp_i2c_queue(&req.xfer, pdMS_TO_TICKS(CONFIG_BSP_I2C_TIMEOUT_MS) + 1), TAG, "I2C lane %d is full", xfer->lane);
+    /* Every queued transaction completes within its timeout */
+    xSemaphoreTake(wait.done, portMAX_DELAY);
+    vSemaphoreDelete(wait.done);
+    return wait.result;
+}
+
+esp_err_t bsp_i2c_write_reg(bsp_i2c_lane_t lane, uint8_t addr, uint8_t reg, uint8_t val)
+{
+    const bsp_i2c_xfer_t xfer = {
+        .lane = lane,
+        .addr = addr,
+        .write_len = 2,
+        .write = { reg, val },
+    };
+    return bsp_i2c_transfer(&xfer);
+}
+
+esp_err_t bsp_i2c_read_regs(bsp_i2c_lane_t lane, uint8_t addr, uint8_t reg, uint8_t *data, size_t len)
+{
+    const bsp_i2c_xfer_t xfer = {
+        .lane = lane,
+        .addr = addr,
+        .write_len = 1,
+        .write = { reg },
+        .read = data,
+        .read_len = len,
+    };
+    return bsp_i2c_transfer(&xfer);
+}
+
+esp_err_t bsp_i2c_get_stats(uint8_t addr, bsp_i2c_dev_stats_t *stats)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    portENTER_CRITICAL(&i2c_ctx.lock);
+    for (int i = 0; i < BSP_I2C_STATS_DEVICES; i++) {
+        if (addr != 0 && i2c_ctx.devs[i].addr == addr) {
+            *stats = i2c_ctx.devs[i].stats;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&i2c_ctx.lock);
+    return ret;
+}
+
+void bsp_i2c_reset_stats(void)
+{
+    portENTER_CRITICAL(&i2c_ctx.lock);
+    memset(i2c_ctx.devs, 0, sizeof(i2c_ctx.devs));
+    portEXIT_CRITICAL(&i2c_ctx.lock);
+}
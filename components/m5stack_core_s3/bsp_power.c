@@ -0,0 +1,200 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * AXP2101 telemetry
+ *
+ * A periodic timer queues three burst reads on the power lane of the I2C task: the status registers,
+ * the ADC results and the fuel gauge. The lane keeps their order, the completion of the last one
+ * decodes the registers (bsp_axp2101_decode) and publishes the snapshot. A reading still in progress skips the next period.
+ *
+ * The snapshot is a sequence lock with one writer, the I2C task. Readers copy it and retry when the
+ * sequence changed or was odd meanwhile, neither side ever waits for the other.
+ */
+
+#include <string.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/m5stack_core_s3.h"
+#include "bsp_axp2101.h"
+
+static const char *TAG = "M5Stack";
+
+#define BSP_POWER_READS         (3)
+
+typedef struct {
+    atomic_bool started;
+    esp_timer_handle_t timer;
+    /* Reading in progress */
+    atomic_bool busy;
+    atomic_int remaining;           /* Transactions not completed yet */
+    atomic_bool failed;
+    uint8_t status[2];
+    uint8_t adc[BSP_AXP2101_ADC_LEN];
+    uint8_t level;
+    /* Snapshot */
+    atomic_uint seq;                /* Odd while the snapshot is written */
+    bsp_power_telemetry_t snapshot;
+    uint32_t updates;
+    uint32_t errors;
+} bsp_power_ctx_t;
+
+static bsp_power_ctx_t power;
+
+static void bsp_power_publish(void)
+{
+    bsp_power_telemetry_t t;
+
+    bsp_axp2101_decode(power.status, power.adc, power.level, &t);
+    t.time_us = esp_timer_get_time();
+    t.updates = ++power.updates;
+    t.errors = power.errors;
+
+    atomic_fetch_add_explicit(&power.seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    power.snapshot = t;
+    atomic_fetch_add_explicit(&power.seq, 1, memory_order_release);
+}
+
+static void bsp_power_read_done(esp_err_t result, void *user_ctx)
+{
+    if (result != ESP_OK) {
+        atomic_store(&power.failed, true);
+    }
+    if (atomic_fetch_sub(&power.remaining, 1) != 1) {
+        return;
+    }
+
+    if (atomic_load(&power.failed)) {
+        /* Only the error counter changes, readers see it with the next successful reading */
+        power.errors++;
+        ESP_LOGD(TAG, "AXP2101 telemetry read failed");
+    } else {
+        bsp_power_publish();
+    }
+    atomic_store(&power.busy, false);
+}
+
+static void bsp_power_read(void)
+{
+    const bsp_i2c_xfer_t reads[BSP_POWER_READS] = {
+        {
+            .write = { BSP_AXP2101_REG_STATUS1 },
+            .read = power.status,
+            .read_len = sizeof(power.status),
+        },
+        {
+            .write = { BSP_AXP2101_REG_ADC_VBAT },
+            .read = power.adc,
+            .read_len = sizeof(power.adc),
+        },
+        {
+            .write = { BSP_AXP2101_REG_BATT_LEVEL },
+            .read = &power.level,
+            .read_len = 1,
+        },
+    };
+
+    if (atomic_exchange(&power.busy, true)) {
+        return;
+    }
+    atomic_store(&power.failed, false);
+    atomic_store(&power.remaining, BSP_POWER_READS);
+    for (int i = 0; i < BSP_POWER_READS; i++) {
+        bsp_i2c_xfer_t xfer = reads[i];
+        xfer.lane = BSP_I2C_LANE_POWER;
+        xfer.addr = BSP_AXP2101_ADDR;
+        xfer.write_len = 1;
+        xfer.done_cb = bsp_power_read_done;
+        if (bsp_i2c_submit(&xfer) != ESP_OK) {
+            /* Counts as completed, the last completion ends the reading */
+            bsp_power_read_done(ESP_ERR_NO_MEM, NULL);
+        }
+    }
+}
+
+static void bsp_power_timer_cb(void *arg)
+{
+    bsp_power_read();
+}
+
+esp_err_t bsp_power_telemetry_start(void)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t adc_enable;
+
+    if (atomic_exchange(&power.started, true)) {
+        return ESP_OK;
+    }
+
+    ESP_GOTO_ON_ERROR(bsp_i2c_init(), err, TAG, "I2C init failed");
+    ESP_GOTO_ON_ERROR(bsp_i2c_read_regs(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, BSP_AXP2101_REG_ADC_ENABLE, &adc_enable, 1),
+                      err, TAG, "AXP2101 read failed");
+    const uint8_t adc_channels = BSP_AXP2101_ADC_VBAT | BSP_AXP2101_ADC_VBUS | BSP_AXP2101_ADC_VSYS | BSP_AXP2101_ADC_TDIE;
+    if ((adc_enable & adc_channels) != adc_channels) {
+        ESP_GOTO_ON_ERROR(bsp_i2c_write_reg(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, BSP_AXP2101_REG_ADC_ENABLE, adc_enable | adc_channels),
+                          err, TAG, "AXP2101 write failed");
+    }
+
+    /* First reading, so the snapshot is valid on return */
+    uint8_t status[2], adc[BSP_AXP2101_ADC_LEN], level;
+    ESP_GOTO_ON_ERROR(bsp_i2c_read_regs(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, BSP_AXP2101_REG_STATUS1, status, sizeof(status)),
+                      err, TAG, "AXP2101 read failed");
+    ESP_GOTO_ON_ERROR(bsp_i2c_read_regs(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, BSP_AXP2101_REG_ADC_VBAT, adc, sizeof(adc)),
+                      err, TAG, "AXP2101 read failed");
+    ESP_GOTO_ON_ERROR(bsp_i2c_read_regs(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, BSP_AXP2101_REG_BATT_LEVEL, &level, 1),
+                      err, TAG, "AXP2101 read failed");
+    memcpy(power.status, status, sizeof(status));
+    memcpy(power.adc, adc, sizeof(adc));
+    power.level = level;
+    bsp_power_publish();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = bsp_power_timer_cb,
+        .name = "BSP power",
+    };
+    ESP_GOTO_ON_ERROR(esp_timer_create(&timer_args, &power.timer), err, TAG, "Create power timer fail");
+    ESP_GOTO_ON_ERROR(esp_timer_start_periodic(power.timer, CONFIG_BSP_POWER_TELEMETRY_PERIOD_MS * 1000ULL), err, TAG,
+                      "Start power timer fail");
+    return ESP_OK;
+
+err:
+    if (power.timer) {
+        esp_timer_delete(power.timer);
+        power.timer = NULL;
+    }
+    atomic_store(&power.started, false);
+    return ret;
+}
+
+esp_err_t bsp_power_get_telemetry(bsp_power_telemetry_t *telemetry)
+{
+    unsigned seq;
+
+    ESP_RETURN_ON_FALSE(telemetry, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    do {
+        seq = atomic_load_explicit(&power.seq, memory_order_acquire);
+        *telemetry = power.snapshot;
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&power.seq, memory_order_relaxed));
+
+    return (seq != 0) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+int8_t bsp_get_battery_level(void)
+{
+    bsp_power_telemetry_t telemetry;
+
+    if (bsp_power_get_telemetry(&telemetry) != ESP_OK && bsp_power_telemetry_start() == ESP_OK) {
+        bsp_power_get_telemetry(&telemetry);
+    }
+    return (telemetry.updates > 0) ? telemetry.battery_level : -1;
+}
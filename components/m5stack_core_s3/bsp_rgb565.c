@@ -0,0 +1,175 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_idf_version.h"
+#include "bsp_rgb565.h"
+
+/* PIE registers are part of the task context since IDF v5.3, older versions do not save them on context switch */
+#if CONFIG_BSP_DISPLAY_PIE_KERNELS && CONFIG_IDF_TARGET_ESP32S3 && (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0))
+#define BSP_RGB565_USE_PIE  (1)
+#else
+#define BSP_RGB565_USE_PIE  (0)
+#endif
+
+void bsp_rgb565_fill_scalar(uint16_t *dst, uint16_t color, size_t len)
+{
+    if (len > 0 && ((uintptr_t)dst & 2)) {
+        *dst++ = color;
+        len--;
+    }
+    const uint32_t pair = ((uint32_t)color << 16) | color;
+    uint32_t *dst32 = (uint32_t *)dst;
+    for (size_t i = 0; i < len / 2; i++) {
+        dst32[i] = pair;
+    }
+    if (len & 1) {
+        dst[len - 1] = color;
+    }
+}
+
+void bsp_rgb565_copy_scalar(uint16_t *dst, const uint16_t *src, size_t len)
+{
+    memcpy(dst, src, len * sizeof(uint16_t));
+}
+
+void bsp_rgb565_swap_scalar(uint16_t *dst, const uint16_t *src, size_t len)
+{
+    if (len > 0 && ((uintptr_t)dst & 2) && ((uintptr_t)src & 2)) {
+        *dst++ = (uint16_t)((*src >> 8) | (*src << 8));
+        src++;
+        len--;
+    }
+    if ((((uintptr_t)dst | (uintptr_t)src) & 3) == 0) {
+        /* Two pixels per word */
+        uint32_t *dst32 = (uint32_t *)dst;
+        const uint32_t *src32 = (const uint32_t *)src;
+        for (size_t i = 0; i < len / 2; i++) {
+            const uint32_t v = src32[i];
+            dst32[i] = ((v & 0x00FF00FF) << 8) | ((v >> 8) & 0x00FF00FF);
+        }
+        dst += len & ~1;
+        src += len & ~1;
+        len &= 1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = (uint16_t)((src[i] >> 8) | (src[i] << 8));
+    }
+}
+
+#if BSP_RGB565_USE_PIE
+static inline bool bsp_rgb565_aligned(const void *ptr)
+{
+    return ((uintptr_t)ptr & 15) == 0;
+}
+
+void bsp_rgb565_fill(uint16_t *dst, uint16_t color, size_t len)
+{
+    while (len > 0 && !bsp_rgb565_aligned(dst)) {
+        *dst++ = color;
+        len--;
+    }
+
+    size_t blocks = len / 8;
+    if (blocks > 0) {
+        uint16_t pattern[8] __attribute__((aligned(16)));
+        for (int i = 0; i < 8; i++) {
+            pattern[i] = color;
+        }
+        const uint16_t *pattern_ptr = pattern;
+        /* 8 pixels per store */
+        __asm__ volatile(
+            "ee.vld.128.ip  q0, %[pat], 0   \n"
+            "1:                             \n"
+            "ee.vst.128.ip  q0, %[dst], 16  \n"
+            "addi           %[n], %[n], -1  \n"
+            "bnez           %[n], 1b        \n"
+            : [dst] "+r"(dst), [n] "+r"(blocks), [pat] "+r"(pattern_ptr)
+            :
+            : "memory");
+        len &= 7;
+    }
+
+    bsp_rgb565_fill_scalar(dst, color, len);
+}
+
+void bsp_rgb565_copy(uint16_t *dst, const uint16_t *src, size_t len)
+{
+    while (len > 0 && !bsp_rgb565_aligned(dst)) {
+        *dst++ = *src++;
+        len--;
+    }
+
+    size_t blocks = len / 16;
+    if (blocks > 0 && bsp_rgb565_aligned(src)) {
+        /* 16 pixels per iteration */
+        __asm__ volatile(
+            "1:                             \n"
+            "ee.vld.128.ip  q0, %[src], 16  \n"
+            "ee.vld.128.ip  q1, %[src], 16  \n"
+            "ee.vst.128.ip  q0, %[dst], 16  \n"
+            "ee.vst.128.ip  q1, %[dst], 16  \n"
+            "addi           %[n], %[n], -1  \n"
+            "bnez           %[n], 1b        \n"
+            : [dst] "+r"(dst), [src] "+r"(src), [n] "+r"(blocks)
+            :
+            : "memory");
+        len &= 15;
+    }
+
+    bsp_rgb565_copy_scalar(dst, src, len);
+}
+
+void bsp_rgb565_swap(uint16_t *dst, const uint16_t *src, size_t len)
+{
+    while (len > 0 && !bsp_rgb565_aligned(dst)) {
+        *dst++ = (uint16_t)((*src >> 8) | (*src << 8));
+        src++;
+        len--;
+    }
+
+    size_t blocks = len / 16;
+    if (blocks > 0 && bsp_rgb565_aligned(src)) {
+        /*
+         * 16 pixels per iteration: VUNZIP.8 splits low and high bytes of the pixels into q0 and q1,
+         * VZIP.8 interleaves them back with high bytes first.
+         */
+        __asm__ volatile(
+            "1:                             \n"
+            "ee.vld.128.ip  q0, %[src], 16  \n"
+            "ee.vld.128.ip  q1, %[src], 16  \n"
+            "ee.vunzip.8    q0, q1          \n"
+            "ee.vzip.8      q1, q0          \n"
+            "ee.vst.128.ip  q1, %[dst], 16  \n"
+            "ee.vst.128.ip  q0, %[dst], 16  \n"
+            "addi           %[n], %[n], -1  \n"
+            "bnez           %[n], 1b        \n"
+            : [dst] "+r"(dst), [src] "+r"(src), [n] "+r"(blocks)
+            :
+            : "memory");
+        len &= 15;
+    }
+
+    bsp_rgb565_swap_scalar(dst, src, len);
+}
+#else
+void bsp_rgb565_fill(uint16_t *dst, uint16_t color, size_t len)
+{
+    bsp_rgb565_fill_scalar(dst, color, len);
+}
+
+void bsp_rgb565_copy(uint16_t *dst, const uint16_t *src, size_t len)
+{
+    bsp_rgb565_copy_scalar(dst, src, len);
+}
+
+void bsp_rgb565_swap(uint16_t *dst, const uint16_t *src, size_t len)
+{
+    bsp_rgb565_swap_scalar(dst, src, len);
+}
+#endif // BSP_RGB565_USE_PIE
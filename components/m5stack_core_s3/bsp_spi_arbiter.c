@@ -0,0 +1,200 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Arbiter of the SPI bus shared by LCD and SD card
+ *
+ * SDSPI holds the bus for a whole command, so one large multi block read or write delays all
+ * queued LCD transfers. SD commands wait until no LCD transfer is pending (at most
+ * CONFIG_BSP_SD_SPI_MAX_DEFER_MS) and multi block commands are split into chunks, so a flush
+ * waits for at most one chunk.
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "driver/sdspi_host.h"
+#include "driver/sdmmc_defs.h"
+
+#include "bsp/m5stack_core_s3.h"
+#include "bsp_spi_arbiter.h"
+
+static const char *TAG = "M5Stack";
+
+typedef struct {
+    SemaphoreHandle_t lcd_idle;     /* Given from ISR when the last pending LCD transfer is done */
+    StaticSemaphore_t lcd_idle_buf;
+    uint32_t lcd_pending;           /* LCD transfers queued and not done */
+    bool sd_waiting;                /* SD command waits for the LCD */
+    int64_t lcd_last_done_us;
+    int64_t sd_last_end_us;
+    portMUX_TYPE lock;
+    bsp_spi_bus_stats_t stats[BSP_SPI_CLIENT_MAX];
+} bsp_spi_arbiter_t;
+
+static bsp_spi_arbiter_t arbiter = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+esp_err_t bsp_spi_arbiter_init(void)
+{
+    if (arbiter.lcd_idle == NULL) {
+        arbiter.lcd_idle = xSemaphoreCreateBinaryStatic(&arbiter.lcd_idle_buf);
+    }
+    return ESP_OK;
+}
+
+static void bsp_spi_arbiter_account_wait(bsp_spi_bus_stats_t *stats, uint32_t wait_us)
+{
+    stats->wait_us += wait_us;
+    if (wait_us > stats->max_wait_us) {
+        stats->max_wait_us = wait_us;
+    }
+}
+
+void bsp_spi_arbiter_lcd_submit(void)
+{
+    portENTER_CRITICAL(&arbiter.lock);
+    arbiter.lcd_pending++;
+    portEXIT_CRITICAL(&arbiter.lock);
+}
+
+void bsp_spi_arbiter_lcd_cancel(void)
+{
+    portENTER_CRITICAL(&arbiter.lock);
+    arbiter.lcd_pending--;
+    portEXIT_CRITICAL(&arbiter.lock);
+}
+
+bool bsp_spi_arbiter_lcd_done_isr(int64_t submit_us, uint32_t bytes)
+{
+    BaseType_t need_yield = pdFALSE;
+    const int64_t now = esp_timer_get_time();
+    bsp_spi_bus_stats_t *stats = &arbiter.stats[BSP_SPI_CLIENT_LCD];
+
+    portENTER_CRITICAL_ISR(&arbiter.lock);
+    /* Transfer started when it was queued, the previous one finished or the SD command released the bus */
+    int64_t start = (submit_us > arbiter.lcd_last_done_us) ? submit_us : arbiter.lcd_last_done_us;
+    if (arbiter.sd_last_end_us > start) {
+        bsp_spi_arbiter_account_wait(stats, arbiter.sd_last_end_us - start);
+        start = arbiter.sd_last_end_us;
+    }
+    stats->transactions++;
+    stats->bytes += bytes;
+    stats->busy_us += now - start;
+    arbiter.lcd_last_done_us = now;
+    arbiter.lcd_pending--;
+    const bool wake = (arbiter.lcd_pending == 0 && arbiter.sd_waiting);
+    portEXIT_CRITICAL_ISR(&arbiter.lock);
+
+    if (wake) {
+        xSemaphoreGiveFromISR(arbiter.lcd_idle, &need_yield);
+    }
+    return (need_yield == pdTRUE);
+}
+
+/* Wait until no LCD transfer is pending, but not longer than the configured limit */
+static void bsp_spi_arbiter_sd_wait(void)
+{
+    const int64_t start = esp_timer_get_time();
+    const int64_t deadline = start + CONFIG_BSP_SD_SPI_MAX_DEFER_MS * 1000LL;
+
+    while (true) {
+        portENTER_CRITICAL(&arbiter.lock);
+        const bool lcd_busy = (arbiter.lcd_pending > 0);
+        arbiter.sd_waiting = lcd_busy;
+        portEXIT_CRITICAL(&arbiter.lock);
+
+        const int64_t now = esp_timer_get_time();
+        if (!lcd_busy || now >= deadline) {
+            break;
+        }
+        xSemaphoreTake(arbiter.lcd_idle, pdMS_TO_TICKS((deadline - now + 999) / 1000));
+    }
+
+    portENTER_CRITICAL(&arbiter.lock);
+    arbiter.sd_waiting = false;
+    bsp_spi_arbiter_account_wait(&arbiter.stats[BSP_SPI_CLIENT_SD], esp_timer_get_time() - start);
+    portEXIT_CRITICAL(&arbiter.lock);
+}
+
+static esp_err_t bsp_spi_arbiter_sd_run(int slot, sdmmc_command_t *cmdinfo)
+{
+    bsp_spi_arbiter_sd_wait();
+
+    const int64_t start = esp_timer_get_time();
+    const esp_err_t ret = sdspi_host_do_transaction(slot, cmdinfo);
+    const int64_t end = esp_timer_get_time();
+
+    portENTER_CRITICAL(&arbiter.lock);
+    bsp_spi_bus_stats_t *stats = &arbiter.stats[BSP_SPI_CLIENT_SD];
+    stats->transactions++;
+    stats->bytes += cmdinfo->datalen;
+    stats->busy_us += end - start;
+    arbiter.sd_last_end_us = end;
+    portEXIT_CRITICAL(&arbiter.lock);
+
+    return ret;
+}
+
+esp_err_t bsp_spi_arbiter_sd_transaction(int slot, sdmmc_command_t *cmdinfo)
+{
+    const bool multi_block = (cmdinfo->opcode == MMC_READ_BLOCK_MULTIPLE || cmdinfo->opcode == MMC_WRITE_BLOCK_MULTIPLE);
+    const size_t chunk_len = CONFIG_BSP_SD_SPI_CHUNK_BLOCKS * cmdinfo->blklen;
+
+    /* Card is known only after mount, there are no multi block commands before */
+    if (!multi_block || bsp_sdcard == NULL || cmdinfo->blklen == 0 || cmdinfo->datalen <= chunk_len) {
+        return bsp_spi_arbiter_sd_run(slot, cmdinfo);
+    }
+
+    /* High capacity cards are addressed in blocks, standard capacity cards in bytes */
+    const bool block_addr = (bsp_sdcard->ocr & SD_OCR_SDHC_CAP) != 0;
+    uint8_t *data = cmdinfo->data;
+    uint32_t addr = cmdinfo->arg;
+    size_t left = cmdinfo->datalen;
+
+    while (left > 0) {
+        sdmmc_command_t chunk = *cmdinfo;
+        chunk.data = data;
+        chunk.datalen = (left < chunk_len) ? left : chunk_len;
+        chunk.buflen = chunk.datalen;
+        chunk.arg = addr;
+        const esp_err_t ret = bsp_spi_arbiter_sd_run(slot, &chunk);
+        memcpy(cmdinfo->response, chunk.response, sizeof(cmdinfo->response));
+        cmdinfo->error = chunk.error;
+        if (ret != ESP_OK) {
+            ESP_LOGD(TAG, "SD chunk at %"PRIu32" failed (%s)", addr, esp_err_to_name(ret));
+            return ret;
+        }
+        data += chunk.datalen;
+        left -= chunk.datalen;
+        addr += block_addr ? (chunk.datalen / cmdinfo->blklen) : chunk.datalen;
+    }
+    return ESP_OK;
+}
+
+esp_err_t bsp_spi_get_bus_stats(bsp_spi_client_t client, bsp_spi_bus_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats && client < BSP_SPI_CLIENT_MAX, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    portENTER_CRITICAL(&arbiter.lock);
+    memcpy(stats, &arbiter.stats[client], sizeof(bsp_spi_bus_stats_t));
+    portEXIT_CRITICAL(&arbiter.lock);
+
+    return ESP_OK;
+}
+
+void bsp_spi_reset_bus_stats(void)
+{
+    portENTER_CRITICAL(&arbiter.lock);
+    memset(arbiter.stats, 0, sizeof(arbiter.stats));
+    portEXIT_CRITICAL(&arbiter.lock);
+}
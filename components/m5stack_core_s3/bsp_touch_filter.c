@@ -0,0 +1,121 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Touch sample ring buffer, one euro filter and motion prediction
+ *
+ * The one euro filter is a low pass filter whose cutoff grows with the speed of the finger:
+ * a finger at rest is smoothed strongly, a moving one follows with little lag
+ * (Casiez, Roussel, Vogel: 1 Euro Filter, CHI 2012). Its speed estimate is also used to
+ * extrapolate the position to the time the next frame is shown.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "bsp/touch_filter.h"
+
+/* Time step used for samples with the same or an older timestamp */
+#define BSP_TOUCH_FILTER_MIN_DT     (1e-4f)
+
+void bsp_touch_ring_init(bsp_touch_ring_t *ring)
+{
+    memset(ring, 0, sizeof(bsp_touch_ring_t));
+}
+
+bool bsp_touch_ring_push(bsp_touch_ring_t *ring, const bsp_touch_sample_t *sample)
+{
+    const uint32_t head = ring->head;
+
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= BSP_TOUCH_RING_SIZE) {
+        ring->dropped++;
+        return false;
+    }
+    ring->samples[head % BSP_TOUCH_RING_SIZE] = *sample;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool bsp_touch_ring_pop(bsp_touch_ring_t *ring, bsp_touch_sample_t *sample)
+{
+    const uint32_t tail = ring->tail;
+
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+        return false;
+    }
+    *sample = ring->samples[tail % BSP_TOUCH_RING_SIZE];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void bsp_touch_filter_init(bsp_touch_filter_t *filter, const bsp_touch_filter_cfg_t *cfg)
+{
+    memset(filter, 0, sizeof(bsp_touch_filter_t));
+    filter->cfg = *cfg;
+}
+
+void bsp_touch_filter_reset(bsp_touch_filter_t *filter)
+{
+    filter->valid = false;
+    filter->dx = 0;
+    filter->dy = 0;
+}
+
+/* Smoothing factor of an exponential filter with the cutoff frequency */
+static inline float bsp_touch_filter_alpha(float cutoff_hz, float dt)
+{
+    const float tau = 1.0f / (2.0f * (float)M_PI * cutoff_hz);
+    return 1.0f / (1.0f + tau / dt);
+}
+
+/* Speed is taken between raw samples, the lag of the filtered position would inflate it */
+static void bsp_touch_filter_axis(const bsp_touch_filter_cfg_t *cfg, float dt, float raw, float prev_raw, float *pos, float *speed)
+{
+    const float raw_speed = (raw - prev_raw) / dt;
+    *speed += bsp_touch_filter_alpha(cfg->d_cutoff_hz, dt) * (raw_speed - *speed);
+
+    const float cutoff = cfg->min_cutoff_hz + cfg->beta * fabsf(*speed);
+    *pos += bsp_touch_filter_alpha(cutoff, dt) * (raw - *pos);
+}
+
+void bsp_touch_filter_update(bsp_touch_filter_t *filter, const bsp_touch_sample_t *sample)
+{
+    if (!filter->valid) {
+        filter->x = sample->x;
+        filter->y = sample->y;
+        filter->dx = 0;
+        filter->dy = 0;
+        filter->raw_x = sample->x;
+        filter->raw_y = sample->y;
+        filter->last_us = sample->time_us;
+        filter->valid = true;
+        return;
+    }
+
+    float dt = (sample->time_us - filter->last_us) * 1e-6f;
+    if (dt < BSP_TOUCH_FILTER_MIN_DT) {
+        dt = BSP_TOUCH_FILTER_MIN_DT;
+    }
+    bsp_touch_filter_axis(&filter->cfg, dt, sample->x, filter->raw_x, &filter->x, &filter->dx);
+    bsp_touch_filter_axis(&filter->cfg, dt, sample->y, filter->raw_y, &filter->y, &filter->dy);
+    filter->raw_x = sample->x;
+    filter->raw_y = sample->y;
+    filter->last_us = sample->time_us;
+}
+
+bool bsp_touch_filter_predict(const bsp_touch_filter_t *filter, int64_t time_us, int64_t max_us, int16_t *x, int16_t *y)
+{
+    if (!filter->valid) {
+        return false;
+    }
+
+    int64_t ahead_us = time_us - filter->last_us;
+    ahead_us = (ahead_us < 0) ? 0 : (ahead_us > max_us) ? max_us : ahead_us;
+    const float ahead = ahead_us * 1e-6f;
+    *x = (int16_t)lroundf(filter->x + filter->dx * ahead);
+    *y = (int16_t)lroundf(filter->y + filter->dy * ahead);
+    return true;
+}
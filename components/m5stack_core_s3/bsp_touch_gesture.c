@@ -0,0 +1,243 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Touch gesture recognition
+ *
+ * One finger: a press released within the slop area before the long press time is a tap, a press
+ * held there is a long press and a press released while moving faster than the swipe speed is a swipe.
+ * Two fingers are tracked by their touch IDs. Their distance relative to the start is the pinch scale,
+ * the accumulated change of the angle between them is the rotation. Once a second finger was down,
+ * the press does not produce one finger gestures anymore.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "bsp/touch_gesture.h"
+
+/* Time constant of the speed smoothing in seconds */
+#define BSP_GESTURE_SPEED_TAU   (0.03f)
+/* Time step used for samples with the same or an older timestamp */
+#define BSP_GESTURE_MIN_DT      (1e-4f)
+#define BSP_GESTURE_RAD_TO_DEG  (180.0f / (float)M_PI)
+
+static inline void bsp_gesture_smooth(float *value, float raw, float dt)
+{
+    *value += dt / (dt + BSP_GESTURE_SPEED_TAU) * (raw - *value);
+}
+
+static void bsp_gesture_emit(bsp_touch_gesture_engine_t *engine, bsp_touch_gesture_type_t type,
+                             bsp_touch_gesture_phase_t phase, int64_t time_us)
+{
+    const bool two = (type == BSP_TOUCH_GESTURE_PINCH || type == BSP_TOUCH_GESTURE_ROTATE);
+    bsp_touch_gesture_t gesture = {
+        .type = type,
+        .phase = phase,
+        .time_us = time_us,
+        .x = two ? engine->cx : engine->x,
+        .y = two ? engine->cy : engine->y,
+        .start_x = two ? engine->start_cx : engine->start_x,
+        .start_y = two ? engine->start_cy : engine->start_y,
+        .vx = engine->vx,
+        .vy = engine->vy,
+        .scale = 1.0f,
+    };
+
+    if (type == BSP_TOUCH_GESTURE_PINCH) {
+        gesture.scale = engine->scale;
+        gesture.scale_speed = engine->scale_speed;
+    } else if (type == BSP_TOUCH_GESTURE_ROTATE) {
+        gesture.angle = engine->angle;
+        gesture.angle_speed = engine->angle_speed;
+    } else if (type == BSP_TOUCH_GESTURE_SWIPE) {
+        const int dx = engine->x - engine->start_x;
+        const int dy = engine->y - engine->start_y;
+        if (abs(dx) > abs(dy)) {
+            gesture.dir = (dx < 0) ? BSP_TOUCH_DIR_LEFT : BSP_TOUCH_DIR_RIGHT;
+        } else {
+            gesture.dir = (dy < 0) ? BSP_TOUCH_DIR_UP : BSP_TOUCH_DIR_DOWN;
+        }
+    }
+
+    if (engine->cb) {
+        engine->cb(&gesture, engine->user_ctx);
+    }
+}
+
+static const bsp_touch_point_t *bsp_gesture_find(const bsp_touch_sample_t *sample, uint8_t id)
+{
+    for (int i = 0; i < sample->count; i++) {
+        if (sample->points[i].id == id) {
+            return &sample->points[i];
+        }
+    }
+    return NULL;
+}
+
+static void bsp_gesture_two_begin(bsp_touch_gesture_engine_t *engine, const bsp_touch_point_t *a, const bsp_touch_point_t *b)
+{
+    const float dist = hypotf(b->x - a->x, b->y - a->y);
+
+    engine->tracking = true;
+    engine->multi = true;
+    engine->id[0] = a->id;
+    engine->id[1] = b->id;
+    /* Fingers reported very close to each other would make the scale jump */
+    engine->dist0 = fmaxf(dist, engine->cfg.slop_px);
+    engine->last_angle = atan2f(b->y - a->y, b->x - a->x);
+    engine->scale = 1.0f;
+    engine->angle = 0;
+    engine->scale_speed = 0;
+    engine->angle_speed = 0;
+    engine->cx = engine->start_cx = (a->x + b->x) / 2;
+    engine->cy = engine->start_cy = (a->y + b->y) / 2;
+    engine->vx = 0;
+    engine->vy = 0;
+}
+
+static void bsp_gesture_two_end(bsp_touch_gesture_engine_t *engine, int64_t time_us)
+{
+    if (engine->pinching) {
+        bsp_gesture_emit(engine, BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_END, time_us);
+    }
+    if (engine->rotating) {
+        bsp_gesture_emit(engine, BSP_TOUCH_GESTURE_ROTATE, BSP_TOUCH_GESTURE_END, time_us);
+    }
+    engine->tracking = false;
+    engine->pinching = false;
+    engine->rotating = false;
+}
+
+static void bsp_gesture_two_update(bsp_touch_gesture_engine_t *engine, const bsp_touch_sample_t *sample, float dt)
+{
+    const bsp_touch_point_t *a = bsp_gesture_find(sample, engine->id[0]);
+    const bsp_touch_point_t *b = bsp_gesture_find(sample, engine->id[1]);
+    if (a == NULL || b == NULL) {
+        bsp_gesture_two_end(engine, sample->time_us);
+        return;
+    }
+
+    const float scale = hypotf(b->x - a->x, b->y - a->y) / engine->dist0;
+    bsp_gesture_smooth(&engine->scale_speed, (scale - engine->scale) / dt, dt);
+    engine->scale = scale;
+
+    const float angle = atan2f(b->y - a->y, b->x - a->x);
+    float delta = angle - engine->last_angle;
+    if (delta > (float)M_PI) {
+        delta -= 2.0f * (float)M_PI;
+    } else if (delta < -(float)M_PI) {
+        delta += 2.0f * (float)M_PI;
+    }
+    engine->last_angle = angle;
+    engine->angle += delta * BSP_GESTURE_RAD_TO_DEG;
+    bsp_gesture_smooth(&engine->angle_speed, delta * BSP_GESTURE_RAD_TO_DEG / dt, dt);
+
+    const int16_t cx = (a->x + b->x) / 2;
+    const int16_t cy = (a->y + b->y) / 2;
+    bsp_gesture_smooth(&engine->vx, (cx - engine->cx) / dt, dt);
+    bsp_gesture_smooth(&engine->vy, (cy - engine->cy) / dt, dt);
+    engine->cx = cx;
+    engine->cy = cy;
+
+    if (engine->pinching) {
+        bsp_gesture_emit(engine, BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_UPDATE, sample->time_us);
+    } else if (fabsf(engine->scale - 1.0f) >= engine->cfg.pinch_threshold) {
+        engine->pinching = true;
+        bsp_gesture_emit(engine, BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_BEGIN, sample->time_us);
+    }
+    if (engine->rotating) {
+        bsp_gesture_emit(engine, BSP_TOUCH_GESTURE_ROTATE, BSP_TOUCH_GESTURE_UPDATE, sample->time_us);
+    } else if (fabsf(engine->angle) >= engine->cfg.rotate_threshold) {
+        engine->rotating = true;
+        bsp_gesture_emit(engine, BSP_TOUCH_GESTURE_ROTATE, BSP_TOUCH_GESTURE_BEGIN, sample->time_us);
+    }
+}
+
+static void bsp_gesture_release(bsp_touch_gesture_engine_t *engine, int64_t time_us)
+{
+    if (engine->tracking) {
+        bsp_gesture_two_end(engine, time_us);
+    }
+    if (!engine->multi) {
+        const bool short_press = (time_us - engine->start_us) < (int64_t)engine->cfg.long_press_ms * 1000;
+        if (!engine->moved && !engine->long_sent && short_press) {
+            bsp_gesture_emit(engine, BSP_TOUCH_GESTURE_TAP, BSP_TOUCH_GESTURE_END, time_us);
+        } else if (engine->moved && hypotf(engine->vx, engine->vy) >= engine->cfg.swipe_speed) {
+            bsp_gesture_emit(engine, BSP_TOUCH_GESTURE_SWIPE, BSP_TOUCH_GESTURE_END, time_us);
+        }
+    }
+    engine->pressed = false;
+}
+
+void bsp_touch_gesture_init(bsp_touch_gesture_engine_t *engine, const bsp_touch_gesture_cfg_t *cfg,
+                            bsp_touch_gesture_cb_t cb, void *user_ctx)
+{
+    memset(engine, 0, sizeof(bsp_touch_gesture_engine_t));
+    engine->cfg = *cfg;
+    engine->cb = cb;
+    engine->user_ctx = user_ctx;
+}
+
+void bsp_touch_gesture_update(bsp_touch_gesture_engine_t *engine, const bsp_touch_sample_t *sample)
+{
+    if (!sample->pressed) {
+        if (engine->pressed) {
+            bsp_gesture_release(engine, sample->time_us);
+        }
+        return;
+    }
+
+    if (!engine->pressed) {
+        engine->pressed = true;
+        engine->moved = false;
+        engine->multi = false;
+        engine->long_sent = false;
+        engine->start_us = sample->time_us;
+        engine->last_us = sample->time_us;
+        engine->x = engine->start_x = sample->x;
+        engine->y = engine->start_y = sample->y;
+        engine->vx = 0;
+        engine->vy = 0;
+    }
+
+    float dt = (sample->time_us - engine->last_us) * 1e-6f;
+    if (dt < BSP_GESTURE_MIN_DT) {
+        dt = BSP_GESTURE_MIN_DT;
+    }
+    engine->last_us = sample->time_us;
+
+    if (sample->count >= 2) {
+        if (engine->tracking) {
+            bsp_gesture_two_update(engine, sample, dt);
+        } else {
+            bsp_gesture_two_begin(engine, &sample->points[0], &sample->points[1]);
+        }
+        return;
+    }
+    if (engine->tracking) {
+        bsp_gesture_two_end(engine, sample->time_us);
+    }
+    if (engine->multi) {
+        return;
+    }
+
+    bsp_gesture_smooth(&engine->vx, (sample->x - engine->x) / dt, dt);
+    bsp_gesture_smooth(&engine->vy, (sample->y - engine->y) / dt, dt);
+    engine->x = sample->x;
+    engine->y = sample->y;
+
+    const int dx = engine->x - engine->start_x;
+    const int dy = engine->y - engine->start_y;
+    if (!engine->moved && dx * dx + dy * dy > engine->cfg.slop_px * engine->cfg.slop_px) {
+        engine->moved = true;
+    }
+    if (!engine->moved && !engine->long_sent && sample->time_us - engine->start_us >= (int64_t)engine->cfg.long_press_ms * 1000) {
+        engine->long_sent = true;
+        bsp_gesture_emit(engine, BSP_TOUCH_GESTURE_LONG_PRESS, BSP_TOUCH_GESTURE_END, sample->time_us);
+    }
+}
@@ -0,0 +1,476 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Interrupt driven touch input
+ *
+ * INT of the FT5x06 is connected to P1_2 of the AW9523 expander, whose open drain INT output goes
+ * to BSP_IO_EXPANDER_INT. Only P1_2 is unmasked in the expander. The interrupt is level triggered and
+ * disabled in the ISR, so no edge is lost while the expander is not acknowledged yet.
+ *
+ * The ISR wakes the touch task, which reads the touch under the LVGL mutex and pushes it into the
+ * input device at once. Reading the expander input port acknowledges its interrupt.
+ * While the touch is pressed (or a scroll is being thrown) the LVGL read timer keeps reading it.
+ * After release the read timer is paused, so there is no I2C traffic until the next interrupt.
+ *
+ * With the sampler, the touch task reads the touch every CONFIG_BSP_TOUCH_SAMPLE_PERIOD_US while
+ * it is pressed, without the LVGL mutex, into a ring of timestamped samples. LVGL reads take all new
+ * samples through the one euro filter and report the position extrapolated to the time the next
+ * frame reaches the display. Press and release are still pushed into LVGL at once.
+ * Each sample is one burst read of the status and all point registers of the FT5x06, the expander
+ * is acknowledged only when the touch task was woken by its interrupt and before it is re-enabled.
+ * With gestures, LVGL reads also feed every sample to the gesture engine, which reports gestures as
+ * LVGL events sent to the object under the gesture and to a registered callback.
+ *
+ * New contacts are reported to the touch latency tracker with the time of the interrupt.
+ * Register accesses go through the touch lane of the I2C task, ahead of power management and the rest.
+ */
+
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/m5stack_core_s3.h"
+#include "bsp/touch_filter.h"
+#include "bsp/touch_gesture.h"
+#include "esp_lcd_touch_ft5x06.h"
+#include "bsp_display_priv.h"
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+
+static const char *TAG = "M5Stack";
+
+#if CONFIG_BSP_TOUCH_INTERRUPT
+#define BSP_AW9523_TOUCH_INT_BIT    BSP_AW9523_P1(2)
+
+#if CONFIG_BSP_TOUCH_SAMPLER
+#define BSP_TOUCH_FILTER_D_CUTOFF   (5.0f)      /* Cutoff of the speed estimate in Hz */
+#define BSP_TOUCH_PREDICT_MAX_US    (50000)
+#define BSP_FT5X06_REG_TD_STATUS    (0x02)      /* Number of points, followed by the point registers */
+#define BSP_FT5X06_POINT_SIZE       (6)
+#endif
+
+typedef struct {
+    lv_indev_t *indev;
+    lv_indev_read_cb_t read_cb;     /* Original touch read callback */
+    esp_lcd_touch_handle_t tp;
+    TaskHandle_t task;
+    atomic_bool pending;            /* Interrupt not yet acknowledged in the expander */
+    bool pressed;                   /* State last reported to LVGL */
+    lv_indev_data_t last;
+    atomic_uint interrupts;
+    int64_t irq_us;                 /* Time of the last interrupt, read by the task after its notification */
+    uint32_t reads;
+    uint32_t skipped;
+#if CONFIG_BSP_TOUCH_SAMPLER
+    esp_timer_handle_t sample_timer;
+    bsp_touch_ring_t ring;
+    bsp_touch_filter_t filter;
+#endif
+#if CONFIG_BSP_TOUCH_GESTURES
+    bsp_touch_gesture_engine_t gestures;
+    lv_event_code_t gesture_event;
+    lv_obj_t *gesture_target[2];    /* Objects receiving the pinch and rotate in progress */
+    bsp_touch_gesture_cb_t gesture_cb;
+    void *gesture_ctx;
+#endif
+} bsp_touch_irq_ctx_t;
+
+static bsp_touch_irq_ctx_t touch_irq;
+
+static void bsp_touch_irq_isr(void *arg)
+{
+    BaseType_t need_yield = pdFALSE;
+
+    gpio_intr_disable(BSP_IO_EXPANDER_INT);
+    touch_irq.irq_us = esp_timer_get_time();
+    atomic_store_explicit(&touch_irq.pending, true, memory_order_relaxed);
+    atomic_fetch_add_explicit(&touch_irq.interrupts, 1, memory_order_relaxed);
+    vTaskNotifyGiveFromISR(touch_irq.task, &need_yield);
+    portYIELD_FROM_ISR(need_yield);
+}
+
+static void bsp_touch_irq_ack(void)
+{
+    uint8_t input;
+    if (bsp_aw9523_read(BSP_I2C_LANE_TOUCH, BSP_AW9523_REG_INPUT + 1, &input) != ESP_OK) {
+        ESP_LOGD(TAG, "Touch interrupt acknowledge failed");
+    }
+}
+
+static void bsp_touch_irq_push(void)
+{
+    bsp_display_lock(0);
+    lv_indev_read_timer_cb(touch_irq.indev->driver->read_timer);
+    bsp_display_unlock();
+}
+
+#if CONFIG_BSP_TOUCH_GESTURES
+static lv_obj_t *bsp_touch_gesture_find_target(const bsp_touch_gesture_t *gesture)
+{
+    lv_disp_t *disp = touch_irq.indev->driver->disp;
+    lv_point_t point = {
+        .x = gesture->start_x,
+        .y = gesture->start_y,
+    };
+
+    lv_obj_t *obj = lv_indev_search_obj(lv_disp_get_layer_top(disp), &point);
+    return obj ? obj : lv_indev_search_obj(lv_disp_get_scr_act(disp), &point);
+}
+
+/* Called by the gesture engine from the LVGL read callback, LVGL mutex is taken */
+static void bsp_touch_gesture_dispatch(const bsp_touch_gesture_t *gesture, void *user_ctx)
+{
+    lv_obj_t *target;
+
+    if (gesture->type == BSP_TOUCH_GESTURE_PINCH || gesture->type == BSP_TOUCH_GESTURE_ROTATE) {
+        /* The whole pinch or rotation goes to the object it began on */
+        lv_obj_t **slot = &touch_irq.gesture_target[gesture->type == BSP_TOUCH_GESTURE_ROTATE];
+        if (gesture->phase == BSP_TOUCH_GESTURE_BEGIN) {
+            *slot = bsp_touch_gesture_find_target(gesture);
+            /* LVGL would scroll or drag under the first finger, it gets the touch again after the release */
+            lv_indev_wait_release(touch_irq.indev);
+        } else if (*slot && !lv_obj_is_valid(*slot)) {
+            *slot = NULL;
+        }
+        target = *slot;
+        if (gesture->phase == BSP_TOUCH_GESTURE_END) {
+            *slot = NULL;
+        }
+    } else {
+        target = bsp_touch_gesture_find_target(gesture);
+    }
+
+    if (target) {
+        lv_event_send(target, touch_irq.gesture_event, (void *)gesture);
+    }
+    if (touch_irq.gesture_cb) {
+        touch_irq.gesture_cb(gesture, touch_irq.gesture_ctx);
+    }
+}
+#endif // CONFIG_BSP_TOUCH_GESTURES
+
+#if CONFIG_BSP_TOUCH_SAMPLER
+/* Time the next frame reaches the display: the next refresh, then rendering and transfer */
+static int64_t bsp_touch_display_time(lv_indev_drv_t *drv)
+{
+    const lv_timer_t *refr = drv->disp ? drv->disp->refr_timer : NULL;
+    uint32_t until_refr = 0;
+
+    if (refr && !refr->paused) {
+        const uint32_t elapsed = lv_tick_elaps(refr->last_run);
+        until_refr = (elapsed < refr->period) ? refr->period - elapsed : 0;
+    }
+    return esp_timer_get_time() + (int64_t)(until_refr + CONFIG_BSP_TOUCH_PREDICT_MS) * 1000;
+}
+
+static void bsp_touch_irq_read_cb(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    const bool scrolling = (touch_irq.indev->proc.types.pointer.scroll_obj != NULL);
+    bsp_touch_sample_t sample;
+    bool changed = false;
+    bool fresh = false;
+
+    /* Stop at a press or release, so that LVGL sees every one of them */
+    while (!changed && bsp_touch_ring_pop(&touch_irq.ring, &sample)) {
+        fresh = true;
+        if (sample.pressed) {
+            if (!touch_irq.pressed) {
+                bsp_touch_filter_reset(&touch_irq.filter);
+            }
+            bsp_touch_filter_update(&touch_irq.filter, &sample);
+        }
+        changed = (sample.pressed != touch_irq.pressed);
+        if (changed && sample.pressed) {
+            bsp_display_latency_touch(drv->disp, sample.time_us);
+        }
+        touch_irq.pressed = sample.pressed;
+#if CONFIG_BSP_TOUCH_GESTURES
+        bsp_touch_gesture_update(&touch_irq.gestures, &sample);
+#endif
+    }
+    if (!fresh) {
+        touch_irq.skipped++;
+    }
+
+    if (touch_irq.pressed) {
+        const int64_t max_us = (CONFIG_BSP_TOUCH_PREDICT_MS > 0) ? BSP_TOUCH_PREDICT_MAX_US : 0;
+        int16_t x, y;
+        if (bsp_touch_filter_predict(&touch_irq.filter, bsp_touch_display_time(drv), max_us, &x, &y)) {
+            touch_irq.last.point.x = LV_CLAMP(0, x, lv_disp_get_hor_res(drv->disp) - 1);
+            touch_irq.last.point.y = LV_CLAMP(0, y, lv_disp_get_ver_res(drv->disp) - 1);
+        }
+        touch_irq.last.state = LV_INDEV_STATE_PRESSED;
+    } else {
+        touch_irq.last.state = LV_INDEV_STATE_RELEASED;
+    }
+    *data = touch_irq.last;
+    data->continue_reading = changed;
+
+    if (touch_irq.pressed || scrolling || changed) {
+        lv_timer_resume(drv->read_timer);
+    } else {
+        lv_timer_pause(drv->read_timer);
+    }
+}
+
+/* One burst read of the point count and all point registers, orientation is applied like esp_lcd_touch does */
+static bool bsp_touch_sample(int64_t time_us)
+{
+    uint8_t buf[1 + BSP_FT5X06_POINT_SIZE * BSP_TOUCH_MAX_POINTS];
+    bsp_touch_sample_t sample = {
+        .time_us = time_us,
+    };
+    bool swap_xy = false;
+    bool mirror_x = false;
+    bool mirror_y = false;
+
+    touch_irq.reads++;
+    if (bsp_i2c_read_regs(BSP_I2C_LANE_TOUCH, ESP_LCD_TOUCH_IO_I2C_FT5x06_ADDRESS, BSP_FT5X06_REG_TD_STATUS, buf, sizeof(buf)) == ESP_OK) {
+        const uint8_t count = buf[0] & 0x0F;
+        /* 0x0F is reported while the controller is not ready */
+        sample.count = (count <= BSP_TOUCH_MAX_POINTS) ? count : 0;
+    }
+    esp_lcd_touch_get_swap_xy(touch_irq.tp, &swap_xy);
+    esp_lcd_touch_get_mirror_x(touch_irq.tp, &mirror_x);
+    esp_lcd_touch_get_mirror_y(touch_irq.tp, &mirror_y);
+
+    for (int i = 0; i < sample.count; i++) {
+        const uint8_t *regs = &buf[1 + i * BSP_FT5X06_POINT_SIZE];
+        int16_t x = ((regs[0] & 0x0F) << 8) | regs[1];
+        int16_t y = ((regs[2] & 0x0F) << 8) | regs[3];
+        if (mirror_x) {
+            x = BSP_LCD_H_RES - x;
+        }
+        if (mirror_y) {
+            y = BSP_LCD_V_RES - y;
+        }
+        sample.points[i].x = swap_xy ? y : x;
+        sample.points[i].y = swap_xy ? x : y;
+        sample.points[i].id = regs[2] >> 4;
+    }
+    sample.pressed = (sample.count > 0);
+    sample.x = sample.points[0].x;
+    sample.y = sample.points[0].y;
+    bsp_touch_ring_push(&touch_irq.ring, &sample);
+    return sample.pressed;
+}
+
+static void bsp_touch_sample_timer_cb(void *arg)
+{
+    xTaskNotifyGive(touch_irq.task);
+}
+
+static void bsp_touch_irq_task(void *arg)
+{
+    bool sampling = false;
+
+    while (1) {
+        /* Woken by the touch interrupt, then by the sample timer while pressed */
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t time_us = esp_timer_get_time();
+        if (!sampling) {
+            /* Woken by the interrupt, the touch changed when it was raised */
+            time_us = touch_irq.irq_us;
+            bsp_touch_irq_ack();
+        }
+        const bool pressed = bsp_touch_sample(time_us);
+        if (pressed != sampling) {
+            if (pressed) {
+                esp_timer_start_periodic(touch_irq.sample_timer, CONFIG_BSP_TOUCH_SAMPLE_PERIOD_US);
+            } else {
+                esp_timer_stop(touch_irq.sample_timer);
+                /* Touch INT kept changing while sampling, the interrupt is re-enabled below */
+                bsp_touch_irq_ack();
+            }
+            sampling = pressed;
+            bsp_touch_irq_push();
+        }
+        if (!sampling) {
+            gpio_intr_enable(BSP_IO_EXPANDER_INT);
+        }
+    }
+}
+#else
+static void bsp_touch_irq_read_cb(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    const bool scrolling = (touch_irq.indev->proc.types.pointer.scroll_obj != NULL);
+    const bool was_pressed = touch_irq.pressed;
+
+    if (!touch_irq.pressed && !atomic_exchange(&touch_irq.pending, false)) {
+        /* Nothing changed since the release, LVGL only needs the last state to finish scrolling */
+        *data = touch_irq.last;
+        touch_irq.skipped++;
+        if (!scrolling) {
+            lv_timer_pause(drv->read_timer);
+        }
+        return;
+    }
+
+    /* Acknowledge before reading the touch, a change during the read raises a new interrupt */
+    bsp_touch_irq_ack();
+    touch_irq.read_cb(drv, data);
+    touch_irq.reads++;
+    touch_irq.pressed = (data->state == LV_INDEV_STATE_PRESSED);
+    if (touch_irq.pressed && !was_pressed) {
+        /* Reads after release only happen on interrupts */
+        bsp_display_latency_touch(drv->disp, touch_irq.irq_us);
+    }
+    touch_irq.last = *data;
+    touch_irq.last.continue_reading = false;
+    if (touch_irq.pressed || scrolling) {
+        lv_timer_resume(drv->read_timer);
+    }
+}
+
+static void bsp_touch_irq_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        /* Push the touch now, the read timer takes over while it is pressed */
+        bsp_touch_irq_push();
+        gpio_intr_enable(BSP_IO_EXPANDER_INT);
+    }
+}
+#endif // CONFIG_BSP_TOUCH_SAMPLER
+
+esp_err_t bsp_touch_irq_init(lv_indev_t *indev, esp_lcd_touch_handle_t tp, const bsp_display_task_cfg_t *task)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(indev && indev->driver->read_timer && tp, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    /* P1_2 is an input, the other pins of the expander do not raise interrupts */
+    ESP_RETURN_ON_ERROR(bsp_aw9523_update(BSP_I2C_LANE_TOUCH, BSP_AW9523_REG_CONFIG, BSP_AW9523_TOUCH_INT_BIT, BSP_AW9523_TOUCH_INT_BIT),
+                        TAG, "AW9523 write failed");
+    ESP_RETURN_ON_ERROR(bsp_aw9523_update(BSP_I2C_LANE_TOUCH, BSP_AW9523_REG_INT, 0xFFFF, (uint16_t)~BSP_AW9523_TOUCH_INT_BIT),
+                        TAG, "AW9523 write failed");
+
+    touch_irq.indev = indev;
+    touch_irq.tp = tp;
+    touch_irq.last.state = LV_INDEV_STATE_RELEASED;
+    /* First read acknowledges whatever the expander latched before */
+    atomic_store(&touch_irq.pending, true);
+#if CONFIG_BSP_TOUCH_SAMPLER
+    const bsp_touch_filter_cfg_t filter_cfg = {
+        .min_cutoff_hz = CONFIG_BSP_TOUCH_FILTER_MIN_CUTOFF / 10.0f,
+        .beta = CONFIG_BSP_TOUCH_FILTER_BETA / 1000.0f,
+        .d_cutoff_hz = BSP_TOUCH_FILTER_D_CUTOFF,
+    };
+    bsp_touch_filter_init(&touch_irq.filter, &filter_cfg);
+    bsp_touch_ring_init(&touch_irq.ring);
+    const esp_timer_create_args_t timer_args = {
+        .callback = bsp_touch_sample_timer_cb,
+        .name = "touch sample",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &touch_irq.sample_timer), TAG, "Touch sample timer create fail");
+#endif
+#if CONFIG_BSP_TOUCH_GESTURES
+    const bsp_touch_gesture_cfg_t gesture_cfg = BSP_TOUCH_GESTURE_DEFAULT_CONFIG();
+    bsp_touch_gesture_init(&touch_irq.gestures, &gesture_cfg, bsp_touch_gesture_dispatch, NULL);
+    bsp_display_lock(0);
+    touch_irq.gesture_event = (lv_event_code_t)lv_event_register_id();
+    bsp_display_unlock();
+#endif
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(bsp_touch_irq_task, "Touch IRQ", task->stack_size, NULL, task->priority + 1,
+                                              &touch_irq.task, (task->core_id < 0) ? tskNO_AFFINITY : task->core_id) == pdPASS,
+                      ESP_ERR_NO_MEM, err, TAG, "Create touch task fail");
+
+    const gpio_config_t int_cfg = {
+        .pin_bit_mask = BIT64(BSP_IO_EXPANDER_INT),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .intr_type = GPIO_INTR_LOW_LEVEL,
+    };
+    ESP_GOTO_ON_ERROR(gpio_config(&int_cfg), err, TAG, "Touch interrupt GPIO config failed");
+    ret = gpio_install_isr_service(0);
+    /* ISR service may be installed by the application already */
+    ESP_GOTO_ON_FALSE(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE, ret, err, TAG, "GPIO ISR service install failed");
+
+    bsp_display_lock(0);
+    touch_irq.read_cb = indev->driver->read_cb;
+    indev->driver->read_cb = bsp_touch_irq_read_cb;
+    bsp_display_unlock();
+    ESP_GOTO_ON_ERROR(gpio_isr_handler_add(BSP_IO_EXPANDER_INT, bsp_touch_irq_isr, NULL), err_restore, TAG, "Touch interrupt handler add failed");
+    return ESP_OK;
+
+err_restore:
+    bsp_display_lock(0);
+    indev->driver->read_cb = touch_irq.read_cb;
+    lv_timer_resume(indev->driver->read_timer);
+    bsp_display_unlock();
+err:
+    if (touch_irq.task) {
+        vTaskDelete(touch_irq.task);
+        touch_irq.task = NULL;
+    }
+#if CONFIG_BSP_TOUCH_SAMPLER
+    esp_timer_delete(touch_irq.sample_timer);
+    touch_irq.sample_timer = NULL;
+#endif
+    return ret;
+}
+
+esp_err_t bsp_touch_get_stats(bsp_touch_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(touch_irq.task, ESP_ERR_INVALID_STATE, TAG, "Touch interrupt is not running");
+
+    stats->interrupts = atomic_load_explicit(&touch_irq.interrupts, memory_order_relaxed);
+    stats->reads = touch_irq.reads;
+    stats->skipped = touch_irq.skipped;
+#if CONFIG_BSP_TOUCH_SAMPLER
+    stats->dropped = touch_irq.ring.dropped;
+#else
+    stats->dropped = 0;
+#endif
+    return ESP_OK;
+}
+#else
+esp_err_t bsp_touch_get_stats(bsp_touch_stats_t *stats)
+{
+    ESP_LOGD(TAG, "Touch interrupt is disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif // CONFIG_BSP_TOUCH_INTERRUPT
+
+#if CONFIG_BSP_TOUCH_GESTURES
+esp_err_t bsp_touch_register_gesture_cb(bsp_touch_gesture_cb_t cb, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(touch_irq.task, ESP_ERR_INVALID_STATE, TAG, "Touch interrupt is not running");
+
+    touch_irq.gesture_cb = cb;
+    touch_irq.gesture_ctx = user_ctx;
+    return ESP_OK;
+}
+
+esp_err_t bsp_touch_get_gesture_event(lv_event_code_t *code)
+{
+    ESP_RETURN_ON_FALSE(code, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(touch_irq.task, ESP_ERR_INVALID_STATE, TAG, "Touch interrupt is not running");
+
+    *code = touch_irq.gesture_event;
+    return ESP_OK;
+}
+#else
+esp_err_t bsp_touch_register_gesture_cb(bsp_touch_gesture_cb_t cb, void *user_ctx)
+{
+    ESP_LOGD(TAG, "Touch gestures are disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_touch_get_gesture_event(lv_event_code_t *code)
+{
+    ESP_LOGD(TAG, "Touch gestures are disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif // CONFIG_BSP_TOUCH_GESTURES
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
@@ -0,0 +1,371 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Touch recording and replay
+ *
+ * The read callback of the touch input device is wrapped between the touch driver and the frame pacing.
+ * Recording appends what the driver reports to LVGL, replay reports the replayed sample instead of
+ * asking the driver. Replayed samples are pushed into LVGL at once like the touch interrupt does, the LVGL
+ * read timer keeps running during the replay, so scroll throws after release proceed as usual.
+ * The file is shared with the host build.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/touch_record.h"
+#include "bsp_touch_record.h"
+#include "bsp_display_latency.h"
+
+static const char *TAG = "M5Stack";
+
+#define BSP_TREC_VERSION    (1)
+#define BSP_TREC_PRESSED    (1 << 0)
+#define BSP_TREC_MOVED      (1 << 1)
+#define BSP_TREC_FLAG_BITS  (2)
+#define BSP_TREC_SETTLE_MS  (200)       /* Time for the frames of the last samples to be shown */
+
+static size_t bsp_trec_put_varint(uint8_t *out, uint64_t value)
+{
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+static bool bsp_trec_get_varint(const uint8_t **data, const uint8_t *end, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; *data < end && shift < 64; shift += 7) {
+        const uint8_t byte = *(*data)++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint32_t bsp_trec_zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t bsp_trec_unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+size_t bsp_touch_record_header(uint8_t *out)
+{
+    memset(out, 0, BSP_TOUCH_RECORD_HEADER_SIZE);
+    memcpy(out, "BTR", 3);
+    out[3] = BSP_TREC_VERSION;
+    return BSP_TOUCH_RECORD_HEADER_SIZE;
+}
+
+size_t bsp_touch_record_encode(const bsp_touch_sample_t *prev, const bsp_touch_sample_t *sample, uint8_t *out)
+{
+    const int64_t prev_units = prev ? prev->time_us / BSP_TOUCH_RECORD_TIME_UNIT_US : sample->time_us / BSP_TOUCH_RECORD_TIME_UNIT_US;
+    const uint64_t dt = (uint64_t)(sample->time_us / BSP_TOUCH_RECORD_TIME_UNIT_US - prev_units);
+    const int32_t dx = sample->x - (prev ? prev->x : 0);
+    const int32_t dy = sample->y - (prev ? prev->y : 0);
+    const bool moved = (dx != 0 || dy != 0);
+
+    size_t len = bsp_trec_put_varint(out, (dt << BSP_TREC_FLAG_BITS) | (moved ? BSP_TREC_MOVED : 0) | (sample->pressed ? BSP_TREC_PRESSED : 0));
+    if (moved) {
+        len += bsp_trec_put_varint(&out[len], bsp_trec_zigzag(dx));
+        len += bsp_trec_put_varint(&out[len], bsp_trec_zigzag(dy));
+    }
+    return len;
+}
+
+esp_err_t bsp_touch_record_decode(const uint8_t *data, size_t len, bsp_touch_sample_t *samples, size_t *count)
+{
+    ESP_RETURN_ON_FALSE(data && count, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(len >= BSP_TOUCH_RECORD_HEADER_SIZE && memcmp(data, "BTR", 3) == 0 && data[3] == BSP_TREC_VERSION,
+                        ESP_ERR_INVALID_VERSION, TAG, "Not a touch recording");
+
+    const uint8_t *end = data + len;
+    const size_t capacity = samples ? *count : 0;
+    bsp_touch_sample_t sample = {0};
+    size_t n = 0;
+
+    data += BSP_TOUCH_RECORD_HEADER_SIZE;
+    while (data < end) {
+        uint64_t head, ux = 0, uy = 0;
+        ESP_RETURN_ON_FALSE(bsp_trec_get_varint(&data, end, &head), ESP_ERR_INVALID_SIZE, TAG, "Truncated recording");
+        if (head & BSP_TREC_MOVED) {
+            ESP_RETURN_ON_FALSE(bsp_trec_get_varint(&data, end, &ux) && bsp_trec_get_varint(&data, end, &uy),
+                                ESP_ERR_INVALID_SIZE, TAG, "Truncated recording");
+        }
+        sample.time_us += (int64_t)(head >> BSP_TREC_FLAG_BITS) * BSP_TOUCH_RECORD_TIME_UNIT_US;
+        sample.x += bsp_trec_unzigzag((uint32_t)ux);
+        sample.y += bsp_trec_unzigzag((uint32_t)uy);
+        sample.pressed = (head & BSP_TREC_PRESSED) != 0;
+        sample.count = sample.pressed ? 1 : 0;
+        sample.points[0].x = sample.x;
+        sample.points[0].y = sample.y;
+        if (samples) {
+            ESP_RETURN_ON_FALSE(n < capacity, ESP_ERR_INVALID_SIZE, TAG, "Too many samples");
+            samples[n] = sample;
+        }
+        n++;
+    }
+    *count = n;
+    return ESP_OK;
+}
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+#if CONFIG_BSP_TOUCH_RECORD
+typedef struct {
+    lv_indev_t *indev;
+    lv_indev_read_cb_t read_cb;     /* Read callback of the touch driver */
+    /* Recording */
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool recording;
+    bool has_last;
+    bsp_touch_sample_t last;        /* Last recorded sample */
+    /* Replay */
+    bool replaying;
+    bool replay_pressed;            /* State last reported to LVGL during the replay */
+    bsp_touch_sample_t replay;      /* Sample reported to LVGL */
+    int64_t replay_us;              /* Time the sample was pushed */
+} bsp_trec_ctx_t;
+
+static bsp_trec_ctx_t trec;
+
+static void bsp_trec_append(const lv_indev_data_t *data)
+{
+    const bsp_touch_sample_t sample = {
+        .time_us = esp_timer_get_time(),
+        .x = data->point.x,
+        .y = data->point.y,
+        .pressed = (data->state == LV_INDEV_STATE_PRESSED),
+        .count = (data->state == LV_INDEV_STATE_PRESSED) ? 1 : 0,
+    };
+
+    if (trec.has_last && sample.pressed == trec.last.pressed &&
+            (!sample.pressed || (sample.x == trec.last.x && sample.y == trec.last.y))) {
+        return;
+    }
+    if (trec.len + BSP_TOUCH_RECORD_SAMPLE_MAX > trec.size) {
+        ESP_LOGW(TAG, "Touch recording is full, %u bytes", (unsigned)trec.len);
+        trec.recording = false;
+        return;
+    }
+    trec.len += bsp_touch_record_encode(trec.has_last ? &trec.last : NULL, &sample, &trec.buf[trec.len]);
+    trec.last = sample;
+    trec.has_last = true;
+}
+
+static void bsp_trec_read_cb(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    if (trec.replaying) {
+        const bool pressed = trec.replay.pressed;
+        data->point.x = trec.replay.x;
+        data->point.y = trec.replay.y;
+        data->state = pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+        data->continue_reading = false;
+        if (pressed && !trec.replay_pressed) {
+            bsp_display_latency_touch(drv->disp, trec.replay_us);
+        }
+        trec.replay_pressed = pressed;
+        return;
+    }
+
+    trec.read_cb(drv, data);
+    if (trec.recording) {
+        bsp_trec_append(data);
+    }
+}
+
+void bsp_touch_record_init(lv_indev_t *indev)
+{
+    bsp_display_lock(0);
+    trec.indev = indev;
+    trec.read_cb = indev->driver->read_cb;
+    indev->driver->read_cb = bsp_trec_read_cb;
+    bsp_display_unlock();
+}
+
+esp_err_t bsp_touch_record_start(size_t max_bytes)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(max_bytes >= BSP_TOUCH_RECORD_HEADER_SIZE + BSP_TOUCH_RECORD_SAMPLE_MAX, ESP_ERR_INVALID_ARG, TAG, "Recording buffer too small");
+    ESP_RETURN_ON_FALSE(trec.indev, ESP_ERR_INVALID_STATE, TAG, "Display is not started");
+
+    bsp_display_lock(0);
+    ESP_GOTO_ON_FALSE(!trec.recording && !trec.replaying, ESP_ERR_INVALID_STATE, err, TAG, "Recording or replay in progress");
+    free(trec.buf);
+    trec.buf = malloc(max_bytes);
+    ESP_GOTO_ON_FALSE(trec.buf, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for touch recording");
+    trec.size = max_bytes;
+    trec.len = bsp_touch_record_header(trec.buf);
+    trec.has_last = false;
+    trec.recording = true;
+err:
+    bsp_display_unlock();
+    return ret;
+}
+
+esp_err_t bsp_touch_record_stop(void)
+{
+    ESP_RETURN_ON_FALSE(trec.buf, ESP_ERR_INVALID_STATE, TAG, "Nothing was recorded");
+
+    bsp_display_lock(0);
+    trec.recording = false;
+    bsp_display_unlock();
+    return ESP_OK;
+}
+
+esp_err_t bsp_touch_record_save(const char *path)
+{
+    ESP_RETURN_ON_ERROR(bsp_touch_record_stop(), TAG, "");
+
+    FILE *f = fopen(path, "wb");
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "Failed to open %s", path);
+    const bool written = (fwrite(trec.buf, 1, trec.len, f) == trec.len);
+    ESP_RETURN_ON_FALSE(fclose(f) == 0 && written, ESP_FAIL, TAG, "Failed to write %s", path);
+    ESP_LOGI(TAG, "Touch recording saved to %s, %u bytes", path, (unsigned)trec.len);
+    return ESP_OK;
+}
+
+esp_err_t bsp_touch_record_load(const char *path, bsp_touch_sample_t **samples, size_t *count)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t *data = NULL;
+    long len = 0;
+
+    ESP_RETURN_ON_FALSE(path && samples && count, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    *samples = NULL;
+
+    FILE *f = fopen(path, "rb");
+    ESP_RETURN_ON_FALSE(f, ESP_ERR_NOT_FOUND, TAG, "Failed to open %s", path);
+    if (fseek(f, 0, SEEK_END) == 0) {
+        len = ftell(f);
+        rewind(f);
+    }
+    ESP_GOTO_ON_FALSE(len > 0, ESP_ERR_NOT_FOUND, err, TAG, "Failed to read %s", path);
+    data = malloc(len);
+    ESP_GOTO_ON_FALSE(data, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for %s", path);
+    ESP_GOTO_ON_FALSE(fread(data, 1, len, f) == (size_t)len, ESP_ERR_NOT_FOUND, err, TAG, "Failed to read %s", path);
+
+    ESP_GOTO_ON_ERROR(bsp_touch_record_decode(data, len, NULL, count), err, TAG, "");
+    *samples = malloc(LV_MAX(*count, 1) * sizeof(bsp_touch_sample_t));
+    ESP_GOTO_ON_FALSE(*samples, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for touch samples");
+    ESP_GOTO_ON_ERROR(bsp_touch_record_decode(data, len, *samples, count), err, TAG, "");
+
+err:
+    if (ret != ESP_OK) {
+        free(*samples);
+        *samples = NULL;
+    }
+    free(data);
+    fclose(f);
+    return ret;
+}
+
+static void bsp_trec_push(const bsp_touch_sample_t *sample)
+{
+    bsp_display_lock(0);
+    trec.replay = *sample;
+    trec.replay_us = esp_timer_get_time();
+    lv_indev_read_timer_cb(trec.indev->driver->read_timer);
+    bsp_display_unlock();
+}
+
+esp_err_t bsp_touch_replay(const bsp_touch_sample_t *samples, size_t count, bsp_touch_replay_report_t *report)
+{
+    esp_err_t ret = ESP_OK;
+    uint32_t max_late_us = 0;
+
+    ESP_RETURN_ON_FALSE(samples && count > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(trec.indev, ESP_ERR_INVALID_STATE, TAG, "Display is not started");
+
+    bsp_display_lock(0);
+    ESP_GOTO_ON_FALSE(!trec.recording && !trec.replaying, ESP_ERR_INVALID_STATE, err, TAG, "Recording or replay in progress");
+    trec.replaying = true;
+    trec.replay_pressed = false;
+    memset(&trec.replay, 0, sizeof(trec.replay));
+    /* The touch driver may have paused it after the last release */
+    lv_timer_resume(trec.indev->driver->read_timer);
+    bsp_display_unlock();
+
+    bsp_display_reset_latency();
+    const int64_t start_us = esp_timer_get_time() - samples[0].time_us;
+    for (size_t i = 0; i < count; i++) {
+        const int64_t due_us = start_us + samples[i].time_us;
+        /* Never early, at most one tick late */
+        for (int64_t wait_us; (wait_us = due_us - esp_timer_get_time()) > 0;) {
+            vTaskDelay(LV_MAX(1, pdMS_TO_TICKS(wait_us / 1000)));
+        }
+        bsp_trec_push(&samples[i]);
+        max_late_us = LV_MAX(max_late_us, (uint32_t)(trec.replay_us - due_us));
+    }
+    bsp_touch_sample_t release = samples[count - 1];
+    release.pressed = false;
+    release.count = 0;
+    bsp_trec_push(&release);
+    vTaskDelay(pdMS_TO_TICKS(BSP_TREC_SETTLE_MS));
+
+    bsp_display_lock(0);
+    trec.replaying = false;
+    if (report) {
+        memset(report, 0, sizeof(bsp_touch_replay_report_t));
+        report->samples = count;
+        report->duration_ms = (samples[count - 1].time_us - samples[0].time_us) / 1000;
+        report->max_late_us = max_late_us;
+        bsp_display_get_latency(BSP_DISPLAY_LATENCY_FRAME, &report->frame);
+        bsp_display_get_latency(BSP_DISPLAY_LATENCY_TOUCH, &report->touch);
+    }
+err:
+    bsp_display_unlock();
+    return ret;
+}
+#else
+esp_err_t bsp_touch_record_start(size_t max_bytes)
+{
+    ESP_LOGD(TAG, "Touch recording is disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_touch_record_stop(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_touch_record_save(const char *path)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_touch_record_load(const char *path, bsp_touch_sample_t **samples, size_t *count)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_touch_replay(const bsp_touch_sample_t *samples, size_t count, bsp_touch_replay_report_t *report)
+{
+    ESP_LOGD(TAG, "Touch recording is disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif // CONFIG_BSP_TOUCH_RECORD
+#endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
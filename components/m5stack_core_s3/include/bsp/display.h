@@ -15,7 +15,14 @@
  */
 
 #pragma once
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+/* esp_lcd is not available in the host build, handles are only declared */
+typedef struct esp_lcd_panel_t *esp_lcd_panel_handle_t;
+typedef struct esp_lcd_panel_io_t *esp_lcd_panel_io_handle_t;
+#else
 #include "esp_lcd_types.h"
+#endif
 
 /* LCD color formats */
 #define ESP_LCD_COLOR_FORMAT_RGB565    (1)
@@ -73,12 +80,15 @@ esp_err_t bsp_display_new(const bsp_display_config_t *config, esp_lcd_panel_hand
 /**
  * @brief Set display's brightness
  *
- * Brightness is controlled with PWM signal to a pin controling backlight.
+ * Brightness is controlled by the DLDO1 voltage of the AXP2101, which supplies the backlight.
+ * The register write is queued on the I2C task and the function returns before it is done.
+ * Only the last requested value is written, a failed write is only logged.
  *
- * @param[in] brightness_percent Brightness in [%]
+ * @param[in] brightness_percent Brightness in [%], clamped to 0 - 100
  * @return
- *      - ESP_OK                On success
- *      - ESP_ERR_INVALID_ARG   Parameter error
+ *      - ESP_OK                Write was queued, or the write in flight queues the new value when it is done
+ *      - ESP_ERR_INVALID_STATE I2C is not initialized
+ *      - ESP_ERR_NO_MEM        I2C queue is full
  */
 esp_err_t bsp_display_brightness_set(int brightness_percent);
 
@@ -104,6 +114,27 @@ esp_err_t bsp_display_backlight_on(void);
  */
 esp_err_t bsp_display_backlight_off(void);
 
+/**
+ * @brief Get LCD SPI clock
+ *
+ * With CONFIG_BSP_DISPLAY_PCLK_CALIBRATION this is the calibrated clock, BSP_LCD_PIXEL_CLOCK_HZ otherwise
+ * and on boards where the panel cannot be read back.
+ *
+ * @return LCD SPI clock in Hz
+ */
+uint32_t bsp_display_get_pclk_hz(void);
+
+/**
+ * @brief Forget calibrated LCD SPI clock
+ *
+ * The clock is calibrated again during next bsp_display_new(), also after a stored failed readback. NVS must be initialized.
+ *
+ * @return
+ *      - ESP_OK                On success
+ *      - Else                  NVS failure
+ */
+esp_err_t bsp_display_pclk_forget(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief BSP layer cache of static LVGL widget subtrees
+ *
+ * Same API on the board and in the host build.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Statistics of the layer cache
+ */
+typedef struct {
+    uint32_t hits;          /*!< Draws of cached layers served from their snapshot */
+    uint32_t blits;         /*!< Hits of opaque snapshots, copied without blending */
+    uint32_t blends;        /*!< Hits of snapshots with alpha, blended pixel by pixel */
+    uint32_t misses;        /*!< Snapshots rendered */
+    uint32_t invalidations; /*!< Changes of cached subtrees */
+    uint32_t layers;        /*!< Number of cached layers */
+    uint32_t opaque_layers; /*!< Cached layers with an opaque snapshot */
+    size_t   bytes;         /*!< Memory used by snapshots */
+} bsp_display_layer_stats_t;
+
+/**
+ * @brief Cache an object subtree as a layer
+ *
+ * The object and its children are rendered once into a snapshot (in PSRAM if available) and hidden.
+ * An image above the object draws the snapshot instead, so redraws caused by overlapping objects
+ * cost a single blit.
+ *
+ * The snapshot is opaque RGB565 when the subtree covers its area, or when only the plain background
+ * color of an ancestor is behind it: ancestors between them draw nothing and no older sibling overlaps it.
+ * Transparent pixels are then composited onto that color. Otherwise the snapshot keeps an alpha byte
+ * per pixel and is blended on every draw. See blits and blends of bsp_display_layer_stats_t.
+ *
+ * Style, size, value and child changes of the subtree and background color changes render the snapshot
+ * again before the next refresh. Other changes (e.g. new label text of the same size, objects moved
+ * behind the layer) need bsp_display_layer_invalidate().
+ * The hidden subtree receives no input, cache only static, non-interactive objects.
+ * Must be called with LVGL mutex taken.
+ *
+ * @param[in] obj Root of the subtree, not a screen
+ * @return
+ *      - ESP_OK                On success, also when the object is cached already
+ *      - ESP_ERR_INVALID_ARG   NULL pointer or a screen
+ *      - ESP_ERR_NO_MEM        Too many layers or not enough memory for the snapshot
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_DISPLAY_LAYER_CACHE or LV_USE_SNAPSHOT is disabled
+ */
+esp_err_t bsp_display_layer_cache(lv_obj_t *obj);
+
+/**
+ * @brief Render snapshot of a cached layer again before the next refresh
+ *
+ * Must be called with LVGL mutex taken.
+ *
+ * @param[in] obj Root of the cached subtree
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_NOT_FOUND     Object is not cached
+ *      - ESP_ERR_NOT_SUPPORTED Layer cache is disabled
+ */
+esp_err_t bsp_display_layer_invalidate(lv_obj_t *obj);
+
+/**
+ * @brief Stop caching a subtree, it is drawn directly again
+ *
+ * Layers are released automatically when their root object is deleted.
+ * Must be called with LVGL mutex taken.
+ *
+ * @param[in] obj Root of the cached subtree
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_NOT_FOUND     Object is not cached
+ *      - ESP_ERR_NOT_SUPPORTED Layer cache is disabled
+ */
+esp_err_t bsp_display_layer_uncache(lv_obj_t *obj);
+
+/**
+ * @brief Get statistics of the layer cache
+ *
+ * @param[out] stats Layer cache statistics
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_NOT_SUPPORTED Layer cache is disabled
+ */
+esp_err_t bsp_display_get_layer_stats(bsp_display_layer_stats_t *stats);
+
+/**
+ * @brief Reset hit, miss and invalidation counters of the layer cache
+ */
+void bsp_display_reset_layer_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,4 +5,9 @@
  */
 
 #pragma once
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "bsp/m5stack_core_s3_host.h"
+#else
 #include "bsp/m5stack_core_s3.h"
+#endif
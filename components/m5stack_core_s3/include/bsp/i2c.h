@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief BSP I2C transaction types
+ *
+ * The I2C API is in bsp/m5stack_core_s3.h. The types are separate, so the drivers on top of the
+ * I2C task can be tested in the host build.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_I2C_WRITE_MAX   (8)     /* Bytes written by one transaction, they are copied on submit */
+
+/**
+ * @brief Priority lanes of the I2C task, a lower lane is always served first
+ */
+typedef enum {
+    BSP_I2C_LANE_TOUCH = 0,     /*!< Touch controller and its interrupt */
+    BSP_I2C_LANE_POWER,         /*!< Power management, backlight and supplies */
+    BSP_I2C_LANE_MISC,          /*!< Everything else */
+    BSP_I2C_LANE_MAX,
+} bsp_i2c_lane_t;
+
+/**
+ * @brief Completion callback, called from the I2C task
+ *
+ * @param[in] result   Result of the transaction, ESP_FAIL on NACK
+ * @param[in] user_ctx User context of the transaction
+ */
+typedef void (*bsp_i2c_done_cb_t)(esp_err_t result, void *user_ctx);
+
+/**
+ * @brief I2C transaction, a write followed by a read with a repeated start
+ */
+typedef struct {
+    bsp_i2c_lane_t lane;
+    uint8_t addr;                       /*!< 7-bit device address */
+    uint8_t write_len;                  /*!< Bytes to write, up to BSP_I2C_WRITE_MAX */
+    uint8_t write[BSP_I2C_WRITE_MAX];   /*!< Bytes to write, usually the register address first */
+    uint8_t *read;                      /*!< Buffer of read bytes, must stay valid until completion */
+    size_t read_len;                    /*!< Bytes to read, 0 for a write only */
+    bsp_i2c_done_cb_t done_cb;          /*!< Completion callback, may be NULL */
+    void *user_ctx;                     /*!< Passed to done_cb */
+} bsp_i2c_xfer_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,6 +19,8 @@
 #include "esp_codec_dev.h"
 #include "bsp/config.h"
 #include "bsp/display.h"
+#include "bsp/power.h"
+#include "bsp/i2c.h"
 
 #if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
 #include "driver/i2s.h"
@@ -29,6 +31,8 @@
 #if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
 #include "lvgl.h"
 #include "esp_lvgl_port.h"
+#include "bsp/touch_gesture.h"
+#include "bsp/display_layer.h"
 #endif // BSP_CONFIG_NO_GRAPHIC_LIB == 0
 
 /**************************************************************************************************
@@ -68,7 +72,11 @@
 #define BSP_LCD_DC            (GPIO_NUM_35)
 #define BSP_LCD_RST           (GPIO_NUM_NC)
 #define BSP_LCD_BACKLIGHT     (GPIO_NUM_NC)
-#define BSP_LCD_TOUCH_INT     (GPIO_NUM_NC)
+#define BSP_LCD_TOUCH_INT     (GPIO_NUM_NC) // Routed through the AW9523 expander (P1_2)
+#define BSP_LCD_MISO_IS_DC    (1)           // MISO and D/C share a pin, the panel can not be read back
+
+/* IO expander */
+#define BSP_IO_EXPANDER_INT   (GPIO_NUM_21) // AW9523 INT, open drain
 
 /* Camera */
 #define BSP_CAMERA_XCLK      (GPIO_NUM_NC)
@@ -176,30 +184,164 @@ esp_codec_dev_handle_t bsp_audio_codec_microphone_init(void);
  * \code{.c}
  * es8311_handle_t es8311_dev = es8311_create(BSP_I2C_NUM, ES8311_ADDRRES_0);
  * \endcode
+ *
+ * Register accesses of the BSP itself (power management, IO expander, touch interrupt) are queued to
+ * the I2C task, which serves the lanes in priority order. Callers never wait for a slow or NACKing
+ * device longer than CONFIG_BSP_I2C_TIMEOUT_MS, asynchronous transactions do not wait at all.
+ * The transaction types are in bsp/i2c.h.
  **************************************************************************************************/
 #define BSP_I2C_NUM     CONFIG_BSP_I2C_NUM
 
 /**
- * @brief Init I2C driver
+ * @brief Transaction statistics of one device
+ */
+typedef struct {
+    uint32_t transfers;     /*!< Completed transactions */
+    uint32_t errors;        /*!< Transactions which failed, timeouts included */
+    uint32_t timeouts;      /*!< Transactions which timed out */
+    uint32_t rejected;      /*!< Submits refused because the lane was full */
+    uint64_t bus_us;        /*!< Total time of the transactions */
+    uint32_t max_us;        /*!< Longest transaction */
+    uint32_t max_wait_us;   /*!< Longest time a transaction was queued */
+} bsp_i2c_dev_stats_t;
+
+/**
+ * @brief Init I2C driver and start the I2C task
+ *
+ * Thread safe, concurrent calls install the driver once. Does nothing when I2C is initialized.
  *
  * @return
  *      - ESP_OK                On success
  *      - ESP_ERR_INVALID_ARG   I2C parameter error
  *      - ESP_FAIL              I2C driver installation error
+ *      - ESP_ERR_NO_MEM        I2C task could not be created
  *
  */
 esp_err_t bsp_i2c_init(void);
 
 /**
- * @brief Deinit I2C driver and free its resources
+ * @brief Stop the I2C task, deinit I2C driver and free its resources
+ *
+ * Transactions still queued complete with an error. Does nothing when I2C is not initialized.
+ * Waits until calls which are queueing a transaction return, so it may block up to CONFIG_BSP_I2C_TIMEOUT_MS.
+ * Must not be called from a completion callback.
  *
  * @return
- *      - ESP_OK                On success
+ *      - ESP_OK                On success, also when I2C is not initialized
  *      - ESP_ERR_INVALID_ARG   I2C parameter error
  *
  */
 esp_err_t bsp_i2c_deinit(void);
 
+/**
+ * @brief Queue a transaction without waiting for it
+ *
+ * @param[in] xfer Transaction, copied except the read buffer
+ * @return
+ *      - ESP_OK                Queued, done_cb will be called
+ *      - ESP_ERR_INVALID_ARG   Invalid transaction
+ *      - ESP_ERR_INVALID_STATE I2C is not initialized
+ *      - ESP_ERR_NO_MEM        Lane is full
+ */
+esp_err_t bsp_i2c_submit(const bsp_i2c_xfer_t *xfer);
+
+/**
+ * @brief Queue a transaction and wait for its completion
+ *
+ * done_cb of the transaction is not used. May be called from a completion callback.
+ *
+ * @param[in] xfer Transaction
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_FAIL              Device did not acknowledge
+ *      - ESP_ERR_TIMEOUT       Lane stayed full or the transaction timed out
+ *      - Else                  See bsp_i2c_submit()
+ */
+esp_err_t bsp_i2c_transfer(const bsp_i2c_xfer_t *xfer);
+
+/**
+ * @brief Write one 8-bit register and wait for completion
+ *
+ * @param[in] lane Priority lane
+ * @param[in] addr 7-bit device address
+ * @param[in] reg  Register address
+ * @param[in] val  Register value
+ * @return See bsp_i2c_transfer()
+ */
+esp_err_t bsp_i2c_write_reg(bsp_i2c_lane_t lane, uint8_t addr, uint8_t reg, uint8_t val);
+
+/**
+ * @brief Read consecutive registers and wait for completion
+ *
+ * @param[in]  lane Priority lane
+ * @param[in]  addr 7-bit device address
+ * @param[in]  reg  First register address
+ * @param[out] data Register values
+ * @param[in]  len  Number of registers
+ * @return See bsp_i2c_transfer()
+ */
+esp_err_t bsp_i2c_read_regs(bsp_i2c_lane_t lane, uint8_t addr, uint8_t reg, uint8_t *data, size_t len);
+
+/**
+ * @brief Get transaction statistics of one device
+ *
+ * @param[in]  addr  7-bit device address
+ * @param[out] stats Statistics since the last reset
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_NOT_FOUND     No transaction with the device since the last reset
+ */
+esp_err_t bsp_i2c_get_stats(uint8_t addr, bsp_i2c_dev_stats_t *stats);
+
+/**
+ * @brief Reset transaction statistics of all devices
+ */
+void bsp_i2c_reset_stats(void);
+
+/**************************************************************************************************
+ *
+ * Power management
+ *
+ * The AXP2101 ADC and fuel gauge are read every CONFIG_BSP_POWER_TELEMETRY_PERIOD_MS by burst reads
+ * on the power lane of the I2C task. Readers get the last snapshot without any I2C access or lock.
+ * The snapshot types are in bsp/power.h.
+ **************************************************************************************************/
+
+/**
+ * @brief Enable the AXP2101 ADC channels and start the periodic telemetry reading
+ *
+ * The first reading is done before returning. Called by bsp_get_battery_level() if needed.
+ *
+ * @return
+ *      - ESP_OK                On success, also when already started
+ *      - ESP_ERR_NO_MEM        Timer could not be created
+ *      - Else                  I2C failure
+ */
+esp_err_t bsp_power_telemetry_start(void);
+
+/**
+ * @brief Get the last telemetry snapshot
+ *
+ * Lock-free and without I2C access, may be called from any task.
+ *
+ * @param[out] telemetry Snapshot
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_INVALID_STATE No reading succeeded yet
+ */
+esp_err_t bsp_power_get_telemetry(bsp_power_telemetry_t *telemetry);
+
+/**
+ * @brief Get battery level from the telemetry snapshot
+ *
+ * Starts the telemetry on the first call.
+ *
+ * @return Battery level in %, or -1 without battery or telemetry
+ */
+int8_t bsp_get_battery_level(void);
+
 /**************************************************************************************************
  *
  * Camera interface
@@ -331,6 +473,45 @@ esp_err_t bsp_sdcard_mount(void);
  */
 esp_err_t bsp_sdcard_unmount(void);
 
+/**
+ * @brief Clients of the SPI bus shared by LCD and SD card
+ */
+typedef enum {
+    BSP_SPI_CLIENT_LCD = 0,
+    BSP_SPI_CLIENT_SD,
+    BSP_SPI_CLIENT_MAX,
+} bsp_spi_client_t;
+
+/**
+ * @brief Occupancy of the shared SPI bus by one client
+ *
+ * LCD transfers have priority, SD commands wait until no LCD transfer is pending
+ * and multi block commands are sent in chunks of CONFIG_BSP_SD_SPI_CHUNK_BLOCKS blocks.
+ */
+typedef struct {
+    uint32_t transactions;  /*!< Number of transactions (SD chunks, LCD color transfers) */
+    uint64_t bytes;         /*!< Number of data bytes transferred */
+    uint64_t busy_us;       /*!< Total time the client occupied the bus */
+    uint64_t wait_us;       /*!< Total time the client waited for the other client */
+    uint32_t max_wait_us;   /*!< Longest single wait for the other client */
+} bsp_spi_bus_stats_t;
+
+/**
+ * @brief Get occupancy statistics of the shared SPI bus
+ *
+ * @param[in]  client Bus client
+ * @param[out] stats  Statistics of the client
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer or invalid client
+ */
+esp_err_t bsp_spi_get_bus_stats(bsp_spi_client_t client, bsp_spi_bus_stats_t *stats);
+
+/**
+ * @brief Reset occupancy statistics of the shared SPI bus
+ */
+void bsp_spi_reset_bus_stats(void);
+
 /**************************************************************************************************
  *
  * LCD interface
@@ -351,19 +532,144 @@ esp_err_t bsp_sdcard_unmount(void);
 #if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
 #define BSP_LCD_DRAW_BUFF_SIZE     (BSP_LCD_H_RES * 50)
 #define BSP_LCD_DRAW_BUFF_DOUBLE   (1)
+#define BSP_LCD_DRAW_BUFF_COUNT    (CONFIG_BSP_DISPLAY_DRAW_BUFF_COUNT)
+#define BSP_LCD_BOUNCE_BUFF_SIZE   (BSP_LCD_H_RES * 20)
+#if CONFIG_BSP_DISPLAY_AUTO_TUNE
+#define BSP_LCD_DRAW_BUFF_BUDGET   (CONFIG_BSP_DISPLAY_AUTO_TUNE_BUDGET * 1024)
+#else
+#define BSP_LCD_DRAW_BUFF_BUDGET   (0)
+#endif
+
+/**
+ * @brief Placement of the LVGL task
+ */
+typedef struct {
+    int      priority;      /*!< Task priority */
+    uint32_t stack_size;    /*!< Stack size in bytes. 0: task fields of lvgl_port_cfg are used instead of this descriptor */
+    int      core_id;       /*!< Core the task is pinned to, -1 for no affinity */
+    bool     worker_stack_psram; /*!< Stack of the parallel render worker is allocated in PSRAM. Applies to the worker only,
+                                      esp_lvgl_port 1.x always allocates the LVGL task stack in internal RAM */
+} bsp_display_task_cfg_t;
 
 /**
  * @brief BSP display configuration structure
  */
 typedef struct {
     lvgl_port_cfg_t lvgl_port_cfg;  /*!< LVGL port configuration */
+    bsp_display_task_cfg_t task;    /*!< LVGL task, overrides task_priority, task_stack and task_affinity of lvgl_port_cfg */
     uint32_t        buffer_size;    /*!< Size of the buffer for the screen in pixels */
     bool            double_buffer;  /*!< True, if should be allocated two buffers */
+    uint32_t        buffer_count;   /*!< Number of render buffers cycled by the flush engine (max 4). 0: two if double_buffer is set, otherwise one */
+    uint32_t        bounce_buffer_size; /*!< Size of one internal RAM bounce buffer in pixels, used only with flags.full_frame.
+                                             At least one line in any rotation, max(BSP_LCD_H_RES, BSP_LCD_V_RES) */
+    uint32_t        buffer_budget;  /*!< DMA memory budget in bytes for the auto tuned buffers, used only with flags.auto_tune */
     struct {
         unsigned int buff_dma: 1;    /*!< Allocated LVGL buffer will be DMA capable */
         unsigned int buff_spiram: 1; /*!< Allocated LVGL buffer will be in PSRAM */
+        unsigned int full_frame: 1;  /*!< LVGL renders into one full frame buffer in PSRAM, which is sent through buffer_count (min 2)
+                                          bounce buffers in internal RAM. buffer_size, double_buffer and buff_* flags are ignored */
+        unsigned int auto_tune: 1;   /*!< Size and count of the DMA buffers are chosen at startup by calibration flushes within buffer_budget.
+                                          buffer_size, buffer_count and bounce_buffer_size are used when the calibration fails */
+        unsigned int parallel_render: 1; /*!< Large blends are split into two bands, the lower one is blended on the other core.
+                                              Requires CONFIG_BSP_DISPLAY_PARALLEL_RENDER */
     } flags;
 } bsp_display_cfg_t;
+
+/**
+ * @brief BSP display flush engine statistics
+ */
+typedef struct {
+    uint32_t frames;        /*!< Number of frames sent to the panel */
+    uint32_t flushes;       /*!< Number of areas sent to the panel */
+    uint64_t pixels;        /*!< Number of pixels sent to the panel */
+    uint32_t overlapped;    /*!< Flushes after which LVGL could render into a free buffer immediately */
+    uint32_t stalled;       /*!< Flushes after which LVGL had to wait for a buffer to return from DMA */
+    uint64_t stall_us;      /*!< Total time LVGL waited for a buffer to return from DMA */
+    uint64_t dma_busy_us;   /*!< Total time the SPI bus was transferring pixels */
+    uint8_t  in_flight;     /*!< Number of buffers currently queued or in transfer */
+    uint8_t  buffer_count;  /*!< Number of render buffers cycled by the flush engine */
+} bsp_display_flush_stats_t;
+
+/**
+ * @brief BSP display dirty area coalescing statistics
+ *
+ * Saved bytes are counted in bus bytes, each draw_bitmap call costs CONFIG_BSP_DISPLAY_COALESCE_OVERHEAD bytes.
+ */
+typedef struct {
+    uint32_t frames;            /*!< Number of rendered frames */
+    uint32_t areas_in;          /*!< Number of areas invalidated by LVGL */
+    uint32_t areas_out;         /*!< Number of areas left after coalescing */
+    uint32_t last_frame_saved;  /*!< Bytes saved in the last frame */
+    uint64_t saved;             /*!< Bytes saved in total */
+} bsp_display_coalesce_stats_t;
+
+/**
+ * @brief BSP display buffer configuration in use
+ */
+typedef struct {
+    uint32_t buffer_size;   /*!< Size of one DMA buffer in pixels (render buffer, or bounce buffer in full frame mode) */
+    uint16_t buffer_lines;  /*!< Size of one DMA buffer in display lines of the current rotation */
+    uint8_t  buffer_count;  /*!< Number of DMA buffers */
+    bool     full_frame;    /*!< LVGL renders into a full frame buffer in PSRAM */
+    bool     auto_tuned;    /*!< Buffer size and count were chosen by calibration at startup */
+    uint32_t budget;        /*!< DMA memory budget of the tuning in bytes */
+    size_t   dma_free;      /*!< Free DMA capable memory before the tuning */
+    size_t   dma_largest;   /*!< Largest free DMA capable block before the tuning */
+    uint32_t frame_us;      /*!< Measured time to send one full frame with the chosen buffer size, 0 when not tuned */
+} bsp_display_buffer_info_t;
+
+/**
+ * @brief Stack usage of the display tasks
+ *
+ * Free stack is the high-water mark: the minimum free stack since the task was started.
+ */
+typedef struct {
+    uint32_t lvgl_stack_size;   /*!< Stack size of the LVGL task in bytes */
+    uint32_t lvgl_stack_free;   /*!< Minimum free stack of the LVGL task in bytes */
+    int      lvgl_core_id;      /*!< Core the LVGL task is pinned to, -1 for no affinity */
+    int      lvgl_priority;     /*!< Current priority of the LVGL task */
+    uint32_t worker_stack_size; /*!< Stack size of the parallel render worker in bytes, 0 when not running */
+    uint32_t worker_stack_free; /*!< Minimum free stack of the parallel render worker in bytes */
+    int      worker_core_id;    /*!< Core the parallel render worker is pinned to, -1 for no affinity */
+} bsp_display_task_info_t;
+
+/**
+ * @brief Touch input statistics
+ */
+typedef struct {
+    uint32_t interrupts;    /*!< Touch interrupts from the AW9523 expander */
+    uint32_t reads;         /*!< Touch reads over I2C */
+    uint32_t skipped;       /*!< LVGL reads without a new touch read or sample */
+    uint32_t dropped;       /*!< Samples lost because the sample ring was full */
+} bsp_touch_stats_t;
+
+/**
+ * @brief Stages of the display pipeline with latency histograms
+ */
+typedef enum {
+    BSP_DISPLAY_LATENCY_RENDER = 0, /*!< LVGL rendering of one frame, time spent in the flush callbacks excluded */
+    BSP_DISPLAY_LATENCY_SUBMIT,     /*!< One esp_lcd_panel_draw_bitmap() call, blocks when the transaction queue is full */
+    BSP_DISPLAY_LATENCY_TRANSFER,   /*!< One area from submit to its DMA completion */
+    BSP_DISPLAY_LATENCY_FRAME,      /*!< Start of rendering to DMA completion of the last area of the frame */
+    BSP_DISPLAY_LATENCY_IDLE,       /*!< End of one frame to the start of rendering of the next one */
+    BSP_DISPLAY_LATENCY_LOCK_WAIT,  /*!< Waiting for LVGL mutex in bsp_display_lock() */
+    BSP_DISPLAY_LATENCY_TOUCH,      /*!< New touch contact to DMA completion of the first frame with areas invalidated after it */
+    BSP_DISPLAY_LATENCY_MAX,
+} bsp_display_latency_stage_t;
+
+/**
+ * @brief Latency percentiles of one stage
+ *
+ * Percentiles are upper bounds of histogram buckets, which are at most 25 % wide.
+ */
+typedef struct {
+    uint32_t count;     /*!< Number of samples */
+    uint32_t p50_us;    /*!< Median */
+    uint32_t p95_us;    /*!< 95th percentile */
+    uint32_t p99_us;    /*!< 99th percentile */
+    uint32_t max_us;    /*!< Maximum */
+} bsp_display_latency_t;
+
 /**
  * @brief Initialize display
  *
@@ -413,15 +719,158 @@ void bsp_display_unlock(void);
 /**
  * @brief Rotate screen
  *
- * Display must be already initialized by calling bsp_display_start()
+ * Display must be already initialized by calling bsp_display_start() and LVGL mutex must be taken.
+ * Rotation is done by the LCD controller (MADCTL), LVGL renders directly in the rotated orientation.
+ * Touch coordinates are transformed by the touch driver in the same step.
  *
  * @param[in] disp Pointer to LVGL display
  * @param[in] rotation Angle of the display rotation
  */
 void bsp_display_rotate(lv_disp_t *disp, lv_disp_rot_t rotation);
 
+/**
+ * @brief Get statistics of the display flush engine
+ *
+ * Ratio of dma_busy_us to the measured time shows how well rendering overlaps with SPI transfers.
+ *
+ * @param[out] stats Flush statistics
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_INVALID_STATE Display was not initialized
+ */
+esp_err_t bsp_display_get_flush_stats(bsp_display_flush_stats_t *stats);
 
-int8_t bsp_get_battery_level(void);
+/**
+ * @brief Reset statistics of the display flush engine
+ */
+void bsp_display_reset_flush_stats(void);
+
+/**
+ * @brief Get statistics of the dirty area coalescing
+ *
+ * @param[out] stats Coalescing statistics
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ */
+esp_err_t bsp_display_get_coalesce_stats(bsp_display_coalesce_stats_t *stats);
+
+/**
+ * @brief Get size and count of the display buffers
+ *
+ * With flags.auto_tune the values are chosen at startup from free DMA memory and measured flush times.
+ *
+ * @param[out] info Buffer configuration
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_INVALID_STATE Display was not initialized
+ */
+esp_err_t bsp_display_get_buffer_info(bsp_display_buffer_info_t *info);
+
+/**
+ * @brief Enable or disable parallel rendering at runtime
+ *
+ * Must be called with LVGL mutex taken.
+ *
+ * @param[in] enable Split large blends between both cores
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_STATE Display was not started with flags.parallel_render
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_DISPLAY_PARALLEL_RENDER is disabled
+ */
+esp_err_t bsp_display_set_parallel_render(bool enable);
+
+/**
+ * @brief Get placement and stack usage of the display tasks
+ *
+ * Can be called from any task, LVGL mutex is not needed.
+ *
+ * @param[out] info Task information
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_INVALID_STATE Display was not started
+ */
+esp_err_t bsp_display_get_task_info(bsp_display_task_info_t *info);
+
+/**
+ * @brief Get touch input statistics
+ *
+ * @param[out] stats Touch statistics
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_INVALID_STATE Touch is polled, the interrupt could not be set up
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_TOUCH_INTERRUPT is disabled
+ */
+esp_err_t bsp_touch_get_stats(bsp_touch_stats_t *stats);
+
+/**
+ * @brief Register a callback for touch gestures
+ *
+ * Gestures are also sent as LVGL events to the object under the start of the gesture, see bsp_touch_get_gesture_event().
+ * The callback is called from the LVGL touch read with the LVGL mutex taken. Call this function with the LVGL mutex taken.
+ *
+ * @param[in] cb       Gesture callback, NULL to unregister
+ * @param[in] user_ctx User context passed to the callback
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_STATE Touch is polled, the interrupt could not be set up
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_TOUCH_GESTURES is disabled
+ */
+esp_err_t bsp_touch_register_gesture_cb(bsp_touch_gesture_cb_t cb, void *user_ctx);
+
+/**
+ * @brief Get the LVGL event code of touch gestures
+ *
+ * The event parameter (lv_event_get_param) is a const bsp_touch_gesture_t pointer. Pinch and rotate go from
+ * BEGIN to END to the object they began on, tap, long press and swipe are sent once with phase END.
+ * The event does not bubble, add LV_OBJ_FLAG_EVENT_BUBBLE to children of the object handling it.
+ *
+ * @param[out] code Event code
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_INVALID_STATE Touch is polled, the interrupt could not be set up
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_TOUCH_GESTURES is disabled
+ */
+esp_err_t bsp_touch_get_gesture_event(lv_event_code_t *code);
+
+/**
+ * @brief Get latency percentiles of one display pipeline stage
+ *
+ * Histograms are updated without locks, also from the DMA completion interrupt.
+ *
+ * @param[in]  stage Pipeline stage
+ * @param[out] lat   Latency percentiles
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   Invalid stage or NULL pointer
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_DISPLAY_LATENCY is disabled
+ */
+esp_err_t bsp_display_get_latency(bsp_display_latency_stage_t stage, bsp_display_latency_t *lat);
+
+/**
+ * @brief Reset latency histograms of all stages
+ *
+ * Samples recorded while resetting may be lost.
+ */
+void bsp_display_reset_latency(void);
+
+/**
+ * @brief Register 'display_latency' console command
+ *
+ * The command prints percentiles of all stages, 'display_latency reset' resets the histograms.
+ * Must be called after esp_console_init() or esp_console_new_repl_*().
+ *
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_DISPLAY_LATENCY is disabled
+ *      - Else                  esp_console failure
+ */
+esp_err_t bsp_display_latency_register_cmd(void);
 
 #endif // BSP_CONFIG_NO_GRAPHIC_LIB == 0
 
@@ -0,0 +1,242 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief ESP BSP: M5Stack CoreS3 headless host build (linux target)
+ *
+ * Only the display part of the BSP is available. LVGL renders into an in-memory RGB565 framebuffer
+ * of the panel size, which can be read or saved as a PPM image. There is no touch controller, touch
+ * recordings are replayed with bsp_touch_replay(). The display API and its locking behave the same as on the board.
+ */
+
+#pragma once
+
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "bsp/config.h"
+#include "bsp/display.h"
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+#include "lvgl.h"
+#include "bsp/touch_filter.h"
+#include "bsp/display_layer.h"
+#endif // BSP_CONFIG_NO_GRAPHIC_LIB == 0
+
+/**************************************************************************************************
+ *  BSP Capabilities
+ **************************************************************************************************/
+
+#define BSP_CAPS_DISPLAY        1
+#define BSP_CAPS_TOUCH          0
+#define BSP_CAPS_BUTTONS        0
+#define BSP_CAPS_AUDIO          0
+#define BSP_CAPS_AUDIO_SPEAKER  0
+#define BSP_CAPS_AUDIO_MIC      0
+#define BSP_CAPS_SDCARD         0
+#define BSP_CAPS_IMU            0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+#define BSP_LCD_DRAW_BUFF_SIZE     (BSP_LCD_H_RES * 50)
+#define BSP_LCD_DRAW_BUFF_DOUBLE   (1)
+
+/**
+ * @brief Called after every frame rendered into the framebuffer
+ *
+ * Called from the LVGL task with LVGL mutex taken.
+ *
+ * @param[in] frame    Number of the frame, starting from 1
+ * @param[in] user_ctx User context passed to bsp_display_host_register_frame_cb()
+ */
+typedef void (*bsp_display_host_frame_cb_t)(uint32_t frame, void *user_ctx);
+
+/**
+ * @brief BSP display configuration structure
+ */
+typedef struct {
+    uint32_t buffer_size;       /*!< Size of the buffer for the screen in pixels */
+    bool     double_buffer;     /*!< True, if should be allocated two buffers */
+    int      task_priority;     /*!< LVGL task priority */
+    int      task_stack;        /*!< LVGL task stack size in bytes */
+    int      timer_period_ms;   /*!< Maximum period between LVGL timer handler calls */
+} bsp_display_cfg_t;
+
+/**
+ * @brief Stack usage of the display tasks
+ *
+ * Free stack is the high-water mark: the minimum free stack since the task was started.
+ */
+typedef struct {
+    uint32_t lvgl_stack_size;   /*!< Stack size of the LVGL task in bytes */
+    uint32_t lvgl_stack_free;   /*!< Minimum free stack of the LVGL task in bytes */
+    int      lvgl_core_id;      /*!< Always -1 in the host build */
+    int      lvgl_priority;     /*!< Current priority of the LVGL task */
+    uint32_t worker_stack_size; /*!< Always 0 in the host build, there is no parallel render worker */
+    uint32_t worker_stack_free; /*!< Always 0 in the host build */
+    int      worker_core_id;    /*!< Always -1 in the host build */
+} bsp_display_task_info_t;
+
+/**
+ * @brief Stages of the display pipeline with latency histograms
+ *
+ * Same as in the target build. Only rendering related stages are recorded by the host build,
+ * a frame reaches the display when its last area is copied into the framebuffer.
+ */
+typedef enum {
+    BSP_DISPLAY_LATENCY_RENDER = 0, /*!< Not recorded in the host build */
+    BSP_DISPLAY_LATENCY_SUBMIT,     /*!< Not recorded in the host build */
+    BSP_DISPLAY_LATENCY_TRANSFER,   /*!< Not recorded in the host build */
+    BSP_DISPLAY_LATENCY_FRAME,      /*!< Start of rendering until the last area is in the framebuffer */
+    BSP_DISPLAY_LATENCY_IDLE,       /*!< Not recorded in the host build */
+    BSP_DISPLAY_LATENCY_LOCK_WAIT,  /*!< Not recorded in the host build */
+    BSP_DISPLAY_LATENCY_TOUCH,      /*!< Replayed touch contact to the first frame with areas invalidated after it, see bsp_touch_replay() */
+    BSP_DISPLAY_LATENCY_MAX,
+} bsp_display_latency_stage_t;
+
+/**
+ * @brief Latency percentiles of one stage
+ *
+ * Percentiles are upper bounds of histogram buckets, which are at most 25 % wide.
+ */
+typedef struct {
+    uint32_t count;     /*!< Number of samples */
+    uint32_t p50_us;    /*!< Median */
+    uint32_t p95_us;    /*!< 95th percentile */
+    uint32_t p99_us;    /*!< 99th percentile */
+    uint32_t max_us;    /*!< Maximum */
+} bsp_display_latency_t;
+
+/**
+ * @brief Initialize display
+ *
+ * Allocates the framebuffer and starts LVGL handling task.
+ *
+ * @return Pointer to LVGL display or NULL when error occured
+ */
+lv_disp_t *bsp_display_start(void);
+
+/**
+ * @brief Initialize display
+ *
+ * @param[in] cfg display configuration
+ * @return Pointer to LVGL display or NULL when error occured
+ */
+lv_disp_t *bsp_display_start_with_config(const bsp_display_cfg_t *cfg);
+
+/**
+ * @brief Get pointer to input device (touch, buttons, ...)
+ *
+ * @return Pointer input fed by bsp_touch_replay(), released when nothing is replayed
+ */
+lv_indev_t *bsp_display_get_input_dev(void);
+
+/**
+ * @brief Take LVGL mutex
+ *
+ * @param timeout_ms Timeout in [ms]. 0 will block indefinitely.
+ * @return true  Mutex was taken
+ * @return false Mutex was NOT taken
+ */
+bool bsp_display_lock(uint32_t timeout_ms);
+
+/**
+ * @brief Give LVGL mutex
+ */
+void bsp_display_unlock(void);
+
+/**
+ * @brief Rotate screen
+ *
+ * The framebuffer keeps the panel orientation, LVGL rotates in software.
+ * Must be called with LVGL mutex taken.
+ *
+ * @param[in] disp Pointer to LVGL display
+ * @param[in] rotation Angle of the display rotation
+ */
+void bsp_display_rotate(lv_disp_t *disp, lv_disp_rot_t rotation);
+
+/**
+ * @brief Get the framebuffer
+ *
+ * BSP_LCD_H_RES x BSP_LCD_V_RES pixels in lv_color_t format (byte swapped with LV_COLOR_16_SWAP).
+ * Take LVGL mutex to read a consistent frame.
+ *
+ * @return Framebuffer or NULL if the display is not started
+ */
+const lv_color_t *bsp_display_host_get_framebuffer(void);
+
+/**
+ * @brief Get number of frames rendered into the framebuffer
+ *
+ * @return Number of frames
+ */
+uint32_t bsp_display_host_get_frame_count(void);
+
+/**
+ * @brief Register callback called after every rendered frame
+ *
+ * @param[in] cb       Callback, NULL to unregister
+ * @param[in] user_ctx User context passed to the callback
+ */
+void bsp_display_host_register_frame_cb(bsp_display_host_frame_cb_t cb, void *user_ctx);
+
+/**
+ * @brief Save the framebuffer as binary PPM (P6) image
+ *
+ * Takes LVGL mutex.
+ *
+ * @param[in] path File path
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_STATE Display is not started
+ *      - ESP_FAIL              File could not be written
+ */
+esp_err_t bsp_display_host_save_ppm(const char *path);
+
+/**
+ * @brief Get latency percentiles of one display pipeline stage
+ *
+ * @param[in]  stage Pipeline stage
+ * @param[out] lat   Latency percentiles
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   Invalid stage or NULL pointer
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_DISPLAY_LATENCY is disabled
+ */
+esp_err_t bsp_display_get_latency(bsp_display_latency_stage_t stage, bsp_display_latency_t *lat);
+
+/**
+ * @brief Reset latency histograms of all stages
+ */
+void bsp_display_reset_latency(void);
+
+/**
+ * @brief Get placement and stack usage of the display tasks
+ *
+ * @param[out] info Task information
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_INVALID_STATE Display was not started
+ */
+esp_err_t bsp_display_get_task_info(bsp_display_task_info_t *info);
+
+/**
+ * @brief Get battery level
+ *
+ * @return Always 100 % in the host build
+ */
+int8_t bsp_get_battery_level(void);
+
+#endif // BSP_CONFIG_NO_GRAPHIC_LIB == 0
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief BSP power management telemetry types
+ *
+ * The telemetry API is in bsp/m5stack_core_s3.h. The types are separate, so the register decoding
+ * can be tested in the host build.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Battery charging state
+ */
+typedef enum {
+    BSP_POWER_CHARGE_STANDBY = 0,   /*!< Neither charging nor discharging */
+    BSP_POWER_CHARGE_CHARGING,
+    BSP_POWER_CHARGE_DISCHARGING,
+} bsp_power_charge_t;
+
+/**
+ * @brief Snapshot of the power management telemetry
+ */
+typedef struct {
+    int64_t  time_us;           /*!< Time of the reading (esp_timer_get_time) */
+    uint32_t updates;           /*!< Successful readings since start */
+    uint32_t errors;            /*!< Failed readings, the snapshot keeps the last successful one */
+    uint16_t vbat_mv;           /*!< Battery voltage, 0 without battery */
+    uint16_t vbus_mv;           /*!< USB voltage, 0 without USB power */
+    uint16_t vsys_mv;           /*!< System voltage */
+    int16_t  die_temp_dc;       /*!< Temperature of the AXP2101 in 0.1 degree Celsius */
+    int8_t   battery_level;     /*!< Fuel gauge in %, -1 without battery */
+    bool     battery_present;
+    bool     vbus_good;         /*!< USB power is present */
+    bsp_power_charge_t charge;
+} bsp_power_telemetry_t;
+
+#ifdef __cplusplus
+}
+#endif
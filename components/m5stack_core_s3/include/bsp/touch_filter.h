@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief BSP touch sample ring buffer, jitter filter and motion prediction
+ *
+ * The functions only work on the structures passed to them, they do not touch the hardware.
+ * Recorded touch traces can be fed to them in the host build the same way the touch sampler does on target.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of samples in the ring buffer, power of two */
+#define BSP_TOUCH_RING_SIZE     (32)
+/* Maximum number of touch points in one sample, FT5x06 reports up to 5 */
+#define BSP_TOUCH_MAX_POINTS    (5)
+
+/**
+ * @brief One touch point
+ */
+typedef struct {
+    int16_t x;          /*!< X coordinate in display pixels */
+    int16_t y;          /*!< Y coordinate in display pixels */
+    uint8_t id;         /*!< Touch ID, stays the same while the finger is down */
+} bsp_touch_point_t;
+
+/**
+ * @brief Timestamped touch sample
+ */
+typedef struct {
+    int64_t time_us;    /*!< Time of the sample (esp_timer_get_time) */
+    int16_t x;          /*!< X coordinate of the first point in display pixels */
+    int16_t y;          /*!< Y coordinate of the first point in display pixels */
+    bool    pressed;    /*!< Touch is pressed, coordinates of a released sample are not valid */
+    uint8_t count;      /*!< Number of valid points */
+    bsp_touch_point_t points[BSP_TOUCH_MAX_POINTS]; /*!< All touch points, the first one is also in x and y */
+} bsp_touch_sample_t;
+
+/**
+ * @brief Lock-free ring buffer of touch samples with one producer and one consumer
+ */
+typedef struct {
+    bsp_touch_sample_t samples[BSP_TOUCH_RING_SIZE];
+    uint32_t head;      /*!< Written only by the producer */
+    uint32_t tail;      /*!< Written only by the consumer */
+    uint32_t dropped;   /*!< Samples dropped because the ring was full */
+} bsp_touch_ring_t;
+
+/**
+ * @brief One euro filter parameters
+ */
+typedef struct {
+    float min_cutoff_hz;    /*!< Cutoff at rest, lower removes more jitter of a still finger */
+    float beta;             /*!< Cutoff increase per px/s of speed, higher removes more lag of a moving finger */
+    float d_cutoff_hz;      /*!< Cutoff of the speed estimate */
+} bsp_touch_filter_cfg_t;
+
+/**
+ * @brief One euro filter state of one touch point
+ */
+typedef struct {
+    bsp_touch_filter_cfg_t cfg;
+    bool    valid;          /*!< At least one sample was filtered since reset */
+    int64_t last_us;        /*!< Time of the last filtered sample */
+    float   x;              /*!< Filtered X coordinate */
+    float   y;              /*!< Filtered Y coordinate */
+    float   dx;             /*!< Filtered X speed in px/s */
+    float   dy;             /*!< Filtered Y speed in px/s */
+    int16_t raw_x;          /*!< X coordinate of the last sample */
+    int16_t raw_y;          /*!< Y coordinate of the last sample */
+} bsp_touch_filter_t;
+
+/**
+ * @brief Empty the ring buffer
+ *
+ * @param[out] ring Ring buffer
+ */
+void bsp_touch_ring_init(bsp_touch_ring_t *ring);
+
+/**
+ * @brief Append a sample, called only by the producer
+ *
+ * @param[in] ring   Ring buffer
+ * @param[in] sample Sample to append
+ * @return False, when the ring is full and the sample was dropped
+ */
+bool bsp_touch_ring_push(bsp_touch_ring_t *ring, const bsp_touch_sample_t *sample);
+
+/**
+ * @brief Take the oldest sample, called only by the consumer
+ *
+ * @param[in]  ring   Ring buffer
+ * @param[out] sample Oldest sample
+ * @return False, when the ring is empty
+ */
+bool bsp_touch_ring_pop(bsp_touch_ring_t *ring, bsp_touch_sample_t *sample);
+
+/**
+ * @brief Initialize the filter
+ *
+ * @param[out] filter Filter state
+ * @param[in]  cfg    Filter parameters
+ */
+void bsp_touch_filter_init(bsp_touch_filter_t *filter, const bsp_touch_filter_cfg_t *cfg);
+
+/**
+ * @brief Forget the position and speed, the next sample is taken as it is
+ *
+ * @param[in] filter Filter state
+ */
+void bsp_touch_filter_reset(bsp_touch_filter_t *filter);
+
+/**
+ * @brief Filter a pressed sample
+ *
+ * @param[in] filter Filter state
+ * @param[in] sample Sample newer than the previous one
+ */
+void bsp_touch_filter_update(bsp_touch_filter_t *filter, const bsp_touch_sample_t *sample);
+
+/**
+ * @brief Extrapolate the filtered position with the filtered speed
+ *
+ * @param[in]  filter   Filter state
+ * @param[in]  time_us  Time to extrapolate to, usually when the next frame reaches the display
+ * @param[in]  max_us   Longest extrapolation, larger horizons overshoot on direction changes
+ * @param[out] x        Predicted X coordinate
+ * @param[out] y        Predicted Y coordinate
+ * @return False, when the filter has no sample yet
+ */
+bool bsp_touch_filter_predict(const bsp_touch_filter_t *filter, int64_t time_us, int64_t max_us, int16_t *x, int16_t *y);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief BSP touch gesture recognition
+ *
+ * Tap, long press and swipe of one finger, pinch and rotate of two fingers. The engine is fed
+ * with touch samples and does not touch the hardware, so it runs on recorded traces in the host build too.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bsp/touch_filter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Recognized gestures
+ */
+typedef enum {
+    BSP_TOUCH_GESTURE_TAP = 0,      /*!< Short press without movement */
+    BSP_TOUCH_GESTURE_LONG_PRESS,   /*!< Press held without movement */
+    BSP_TOUCH_GESTURE_SWIPE,        /*!< Fast movement of one finger, reported on release */
+    BSP_TOUCH_GESTURE_PINCH,        /*!< Change of the distance of two fingers */
+    BSP_TOUCH_GESTURE_ROTATE,       /*!< Change of the angle of two fingers */
+} bsp_touch_gesture_type_t;
+
+/**
+ * @brief Phase of a gesture, tap, long press and swipe are reported once with BSP_TOUCH_GESTURE_END
+ */
+typedef enum {
+    BSP_TOUCH_GESTURE_BEGIN = 0,
+    BSP_TOUCH_GESTURE_UPDATE,
+    BSP_TOUCH_GESTURE_END,
+} bsp_touch_gesture_phase_t;
+
+/**
+ * @brief Swipe direction
+ */
+typedef enum {
+    BSP_TOUCH_DIR_NONE = 0,
+    BSP_TOUCH_DIR_LEFT,
+    BSP_TOUCH_DIR_RIGHT,
+    BSP_TOUCH_DIR_UP,
+    BSP_TOUCH_DIR_DOWN,
+} bsp_touch_dir_t;
+
+/**
+ * @brief Recognized gesture
+ */
+typedef struct {
+    bsp_touch_gesture_type_t  type;
+    bsp_touch_gesture_phase_t phase;
+    int64_t time_us;        /*!< Time of the sample which produced the gesture */
+    int16_t x;              /*!< Finger position, centroid of both fingers for pinch and rotate */
+    int16_t y;
+    int16_t start_x;        /*!< Position where the gesture started */
+    int16_t start_y;
+    float   vx;             /*!< Speed of the finger or the centroid in px/s */
+    float   vy;
+    bsp_touch_dir_t dir;    /*!< Swipe direction */
+    float   scale;          /*!< Pinch: finger distance relative to the start, 1.0 for rotate */
+    float   scale_speed;    /*!< Pinch: change of scale per second */
+    float   angle;          /*!< Rotate: degrees since the start, clockwise on the screen, 0 for pinch */
+    float   angle_speed;    /*!< Rotate: degrees per second */
+} bsp_touch_gesture_t;
+
+/**
+ * @brief Gesture callback
+ *
+ * @param[in] gesture  Recognized gesture, valid only during the call
+ * @param[in] user_ctx User context
+ */
+typedef void (*bsp_touch_gesture_cb_t)(const bsp_touch_gesture_t *gesture, void *user_ctx);
+
+/**
+ * @brief Gesture recognition thresholds
+ */
+typedef struct {
+    uint16_t slop_px;           /*!< Movement below this distance is not a movement */
+    uint16_t long_press_ms;     /*!< Press duration of a long press, longer presses are not taps */
+    uint16_t swipe_speed;       /*!< Minimum release speed of a swipe in px/s */
+    float    pinch_threshold;   /*!< Relative distance change which starts a pinch */
+    float    rotate_threshold;  /*!< Angle in degrees which starts a rotation */
+} bsp_touch_gesture_cfg_t;
+
+#define BSP_TOUCH_GESTURE_DEFAULT_CONFIG() \
+    {                                      \
+        .slop_px = 10,                     \
+        .long_press_ms = 400,              \
+        .swipe_speed = 400,                \
+        .pinch_threshold = 0.08f,          \
+        .rotate_threshold = 10.0f,         \
+    }
+
+/**
+ * @brief Gesture engine state
+ */
+typedef struct {
+    bsp_touch_gesture_cfg_t cfg;
+    bsp_touch_gesture_cb_t cb;
+    void *user_ctx;
+    bool    pressed;
+    bool    moved;          /* Finger left the slop area */
+    bool    multi;          /* Two fingers were down during this press, single finger gestures are off */
+    bool    long_sent;
+    int64_t start_us;
+    int64_t last_us;
+    int16_t start_x;
+    int16_t start_y;
+    int16_t x;
+    int16_t y;
+    float   vx;
+    float   vy;
+    /* Two finger tracking */
+    bool    tracking;
+    bool    pinching;
+    bool    rotating;
+    uint8_t id[2];
+    float   dist0;
+    float   last_angle;
+    float   scale;
+    float   angle;
+    float   scale_speed;
+    float   angle_speed;
+    int16_t cx;
+    int16_t cy;
+    int16_t start_cx;
+    int16_t start_cy;
+} bsp_touch_gesture_engine_t;
+
+/**
+ * @brief Initialize the gesture engine
+ *
+ * @param[out] engine   Engine state
+ * @param[in]  cfg      Recognition thresholds
+ * @param[in]  cb       Called for every recognized gesture from bsp_touch_gesture_update()
+ * @param[in]  user_ctx User context passed to the callback
+ */
+void bsp_touch_gesture_init(bsp_touch_gesture_engine_t *engine, const bsp_touch_gesture_cfg_t *cfg,
+                            bsp_touch_gesture_cb_t cb, void *user_ctx);
+
+/**
+ * @brief Feed one touch sample
+ *
+ * @param[in] engine Engine state
+ * @param[in] sample Sample newer than the previous one, pressed or released
+ */
+void bsp_touch_gesture_update(bsp_touch_gesture_engine_t *engine, const bsp_touch_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief BSP touch recording and replay
+ *
+ * The recorder captures what the touch input device reports to LVGL, the replayer pushes it back
+ * into the same input device at the recorded times. Replays bypass the touch controller, so a
+ * recording taken on the device gives the same input sequence on the device and in the host build.
+ *
+ * Recordings are delta encoded, a sample takes 2 to 4 bytes typically:
+ *  - header: "BTR", format version, 4 reserved bytes,
+ *  - per sample: varint of (time delta in 100 us << 2 | moved << 1 | pressed),
+ *    followed by zigzag varints of the X and Y deltas when moved.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "bsp/esp-bsp.h"
+#include "bsp/touch_filter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_TOUCH_RECORD_HEADER_SIZE    (8)
+#define BSP_TOUCH_RECORD_SAMPLE_MAX     (11)    /* Largest encoded sample */
+#define BSP_TOUCH_RECORD_TIME_UNIT_US   (100)   /* Resolution of recorded times */
+
+/**
+ * @brief Write the header of a recording
+ *
+ * @param[out] out Buffer of BSP_TOUCH_RECORD_HEADER_SIZE bytes
+ * @return Number of bytes written
+ */
+size_t bsp_touch_record_header(uint8_t *out);
+
+/**
+ * @brief Encode one sample
+ *
+ * @param[in]  prev   Previous sample of the recording, NULL for the first one
+ * @param[in]  sample Sample to encode, not older than prev
+ * @param[out] out    Buffer of BSP_TOUCH_RECORD_SAMPLE_MAX bytes
+ * @return Number of bytes written
+ */
+size_t bsp_touch_record_encode(const bsp_touch_sample_t *prev, const bsp_touch_sample_t *sample, uint8_t *out);
+
+/**
+ * @brief Decode a recording
+ *
+ * Times of the samples start at 0.
+ *
+ * @param[in]     data    Recording, header included
+ * @param[in]     len     Length of the recording
+ * @param[out]    samples Decoded samples, NULL to only count them
+ * @param[in,out] count   Capacity of samples on input, number of samples in the recording on output
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_INVALID_VERSION Not a recording or an unknown format version
+ *      - ESP_ERR_INVALID_SIZE  Recording is truncated, or samples is too small
+ */
+esp_err_t bsp_touch_record_decode(const uint8_t *data, size_t len, bsp_touch_sample_t *samples, size_t *count);
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+/**
+ * @brief Result of a replay
+ *
+ * Latency percentiles need CONFIG_BSP_DISPLAY_LATENCY and are zero without it.
+ */
+typedef struct {
+    uint32_t samples;               /*!< Samples pushed into LVGL */
+    uint32_t duration_ms;           /*!< Time from the first to the last sample */
+    uint32_t max_late_us;           /*!< Largest delay of a sample behind its recorded time */
+    bsp_display_latency_t frame;    /*!< Frames during the replay, start of rendering until they are shown */
+    bsp_display_latency_t touch;    /*!< Replayed contacts until the first frame showing them */
+} bsp_touch_replay_report_t;
+
+/**
+ * @brief Start recording the touch input
+ *
+ * Every LVGL read which differs from the previous one is recorded into a buffer of max_bytes.
+ * Recording stops when the buffer is full. Must not be called with LVGL mutex taken.
+ *
+ * @param[in] max_bytes Size of the recording buffer
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   Buffer smaller than one sample
+ *      - ESP_ERR_INVALID_STATE Display is not started, or recording or replay is in progress
+ *      - ESP_ERR_NO_MEM        Buffer could not be allocated
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_TOUCH_RECORD is disabled
+ */
+esp_err_t bsp_touch_record_start(size_t max_bytes);
+
+/**
+ * @brief Stop recording, the recording is kept until the next start
+ *
+ * @return
+ *      - ESP_OK                On success, also when the recording stopped itself
+ *      - ESP_ERR_INVALID_STATE Nothing was recorded
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_TOUCH_RECORD is disabled
+ */
+esp_err_t bsp_touch_record_stop(void);
+
+/**
+ * @brief Stop recording and write the recording into a file
+ *
+ * @param[in] path File path, e.g. on BSP_SD_MOUNT_POINT or BSP_SPIFFS_MOUNT_POINT
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_STATE Nothing was recorded
+ *      - ESP_FAIL              File could not be written
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_TOUCH_RECORD is disabled
+ */
+esp_err_t bsp_touch_record_save(const char *path);
+
+/**
+ * @brief Read and decode a recording file
+ *
+ * @param[in]  path    File path
+ * @param[out] samples Decoded samples, release with free()
+ * @param[out] count   Number of samples
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   NULL pointer
+ *      - ESP_ERR_NOT_FOUND     File could not be read
+ *      - ESP_ERR_NO_MEM        Not enough memory
+ *      - Else                  See bsp_touch_record_decode()
+ */
+esp_err_t bsp_touch_record_load(const char *path, bsp_touch_sample_t **samples, size_t *count);
+
+/**
+ * @brief Replay samples into the touch input device
+ *
+ * Every sample is pushed into LVGL at its time relative to the first sample, the way the touch interrupt
+ * does. The touch controller is ignored during the replay, the touch is released after the last sample.
+ * Latency histograms are reset at the start. Returns when the trace is done and its last frame shown.
+ * Must not be called with LVGL mutex taken.
+ *
+ * @param[in]  samples Samples with increasing time_us, in display coordinates
+ * @param[in]  count   Number of samples
+ * @param[out] report  Result of the replay, may be NULL
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   No samples
+ *      - ESP_ERR_INVALID_STATE Display is not started, or recording or replay is in progress
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_TOUCH_RECORD is disabled
+ */
+esp_err_t bsp_touch_replay(const bsp_touch_sample_t *samples, size_t count, bsp_touch_replay_report_t *report);
+#endif // BSP_CONFIG_NO_GRAPHIC_LIB == 0
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,11 +4,16 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_timer.h"
 #include "esp_spiffs.h"
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_vendor.h"
@@ -25,15 +30,14 @@
 #include "esp_lcd_touch_ft5x06.h"
 #include "esp_lvgl_port.h"
 #include "bsp_err_check.h"
+#include "bsp_display_priv.h"
+#include "bsp_axp2101.h"
+#include "bsp_touch_record.h"
+#include "bsp_spi_arbiter.h"
 #include "esp_codec_dev_defaults.h"
 
 static const char *TAG = "M5Stack";
 
-#define BSP_AXP2101_ADDR    0x34
-#define BSP_AW9523_ADDR     0x58
-
-#define AXP2101_BATT_LEVEL_REG 0xA4
-
 /* Features */
 typedef enum {
     BSP_FEATURE_LCD,
@@ -45,101 +49,57 @@ typedef enum {
 
 static lv_disp_t *disp;
 static lv_indev_t *disp_indev = NULL;
+static TaskHandle_t lvgl_task;
+static bsp_display_task_cfg_t lvgl_task_cfg;
 static esp_lcd_touch_handle_t tp;   // LCD touch handle
 sdmmc_card_t *bsp_sdcard = NULL;    // Global SD card handler
-static bool i2c_initialized = false;
 static bool spi_initialized = false;
 
-esp_err_t bsp_i2c_init(void)
-{
-    /* I2C was initialized before */
-    if (i2c_initialized) {
-        return ESP_OK;
-    }
-
-    const i2c_config_t i2c_conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = BSP_I2C_SDA,
-        .sda_pullup_en = GPIO_PULLUP_DISABLE,
-        .scl_io_num = BSP_I2C_SCL,
-        .scl_pullup_en = GPIO_PULLUP_DISABLE,
-        .master.clk_speed = CONFIG_BSP_I2C_CLK_SPEED_HZ
-    };
-    BSP_ERROR_CHECK_RETURN_ERR(i2c_param_config(BSP_I2C_NUM, &i2c_conf));
-    BSP_ERROR_CHECK_RETURN_ERR(i2c_driver_install(BSP_I2C_NUM, i2c_conf.mode, 0, 0, 0));
-
-    i2c_initialized = true;
-
-    return ESP_OK;
-}
-
-esp_err_t bsp_i2c_deinit(void)
-{
-    BSP_ERROR_CHECK_RETURN_ERR(i2c_driver_delete(BSP_I2C_NUM));
-    i2c_initialized = false;
-    return ESP_OK;
-}
+#define BSP_FEATURE_BIT(feature)    (1U << (feature))
+/* Expander outputs which are always on */
+#define BSP_AW9523_OUTPUTS_DEFAULT  (BSP_AW9523_P0(1) | BSP_AW9523_P1(5) | BSP_AW9523_P1(7))
 
-static esp_err_t bsp_enable_feature(bsp_feature_t feature)
+static esp_err_t bsp_enable_features(uint32_t features)
 {
     esp_err_t err = ESP_OK;
-    static uint8_t aw9523_P0 = 0b10;
-    static uint8_t aw9523_P1 = 0b10100000;
-    uint8_t data[2];
+    uint16_t outputs = BSP_AW9523_OUTPUTS_DEFAULT;
 
     /* Initilize I2C */
     BSP_ERROR_CHECK_RETURN_ERR(bsp_i2c_init());
 
-    switch (feature) {
-    case BSP_FEATURE_LCD:
+    if (features & BSP_FEATURE_BIT(BSP_FEATURE_LCD)) {
         /* Enable LCD */
-        aw9523_P1 |= (1 << 1);
-        break;
-    case BSP_FEATURE_TOUCH:
+        outputs |= BSP_AW9523_P1(1);
+    }
+    if (features & BSP_FEATURE_BIT(BSP_FEATURE_TOUCH)) {
         /* Enable Touch */
-        aw9523_P0 |= (1);
-        break;
-    case BSP_FEATURE_SD:
+        outputs |= BSP_AW9523_P0(0);
+    }
+    if (features & BSP_FEATURE_BIT(BSP_FEATURE_SD)) {
         /* AXP ALDO4 voltage / SD Card / 3V3 */
-        data[0] = 0x95;
-        data[1] = 0b00011100; //3V3
-        err |= i2c_master_write_to_device(BSP_I2C_NUM, BSP_AXP2101_ADDR, data, sizeof(data), 1000 / portTICK_PERIOD_MS);
+        err |= bsp_i2c_write_reg(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, 0x95, 0b00011100);
         /* Enable SD */
-        aw9523_P0 |= (1 << 4);
-        break;
-    case BSP_FEATURE_SPEAKER:
+        outputs |= BSP_AW9523_P0(4);
+    }
+    if (features & BSP_FEATURE_BIT(BSP_FEATURE_SPEAKER)) {
         /* AXP ALDO1 voltage / PA PVDD / 1V8 */
-        data[0] = 0x92;
-        data[1] = 0b00001101; //1V8
-        err |= i2c_master_write_to_device(BSP_I2C_NUM, BSP_AXP2101_ADDR, data, sizeof(data), 1000 / portTICK_PERIOD_MS);
+        err |= bsp_i2c_write_reg(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, 0x92, 0b00001101);
         /* AXP ALDO2 voltage / Codec / 3V3 */
-        data[0] = 0x93;
-        data[1] = 0b00011100; //3V3
-        err |= i2c_master_write_to_device(BSP_I2C_NUM, BSP_AXP2101_ADDR, data, sizeof(data), 1000 / portTICK_PERIOD_MS);
+        err |= bsp_i2c_write_reg(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, 0x93, 0b00011100);
         /* AXP ALDO3 voltage / Codec+Mic / 3V3 */
-        data[0] = 0x94;
-        data[1] = 0b00011100; //3V3
-        err |= i2c_master_write_to_device(BSP_I2C_NUM, BSP_AXP2101_ADDR, data, sizeof(data), 1000 / portTICK_PERIOD_MS);
+        err |= bsp_i2c_write_reg(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, 0x94, 0b00011100);
         /* AW9523 P0 is in push-pull mode */
-        data[0] = 0x11;
-        data[1] = 0x10;
-        err |= i2c_master_write_to_device(BSP_I2C_NUM, BSP_AW9523_ADDR, data, sizeof(data), 1000 / portTICK_PERIOD_MS);
+        err |= bsp_aw9523_update(BSP_I2C_LANE_POWER, BSP_AW9523_REG_GCR, 0xFF, 0x10);
         /* Enable Codec AW88298 */
-        aw9523_P0 |= (1 << 2);
-        break;
-    case BSP_FEATURE_CAMERA:
+        outputs |= BSP_AW9523_P0(2);
+    }
+    if (features & BSP_FEATURE_BIT(BSP_FEATURE_CAMERA)) {
         /* Enable Camera */
-        aw9523_P1 |= (1);
-        break;
+        outputs |= BSP_AW9523_P1(0);
     }
 
-    data[0] = 0x02;
-    data[1] = aw9523_P0;
-    err |= i2c_master_write_to_device(BSP_I2C_NUM, BSP_AW9523_ADDR, data, sizeof(data), 1000 / portTICK_PERIOD_MS);
-
-    data[0] = 0x03;
-    data[1] = aw9523_P1;
-    err |= i2c_master_write_to_device(BSP_I2C_NUM, BSP_AW9523_ADDR, data, sizeof(data), 1000 / portTICK_PERIOD_MS);
+    /* First call sets both ports, later ones only turn on outputs. Unchanged ports are not written. */
+    err |= bsp_aw9523_set_outputs(BSP_I2C_LANE_POWER, outputs);
 
     return err;
 }
@@ -161,6 +121,7 @@ static esp_err_t bsp_spi_init(uint32_t max_transfer_sz)
         .max_transfer_sz = max_transfer_sz,
     };
     ESP_RETURN_ON_ERROR(spi_bus_initialize(BSP_LCD_SPI_NUM, &buscfg, SPI_DMA_CH_AUTO), TAG, "SPI init failed");
+    ESP_RETURN_ON_ERROR(bsp_spi_arbiter_init(), TAG, "SPI arbiter init failed");
 
     spi_initialized = true;
 
@@ -202,7 +163,7 @@ esp_err_t bsp_spiffs_unmount(void)
 
 esp_err_t bsp_sdcard_mount(void)
 {
-    BSP_ERROR_CHECK_RETURN_ERR(bsp_enable_feature(BSP_FEATURE_SD));
+    BSP_ERROR_CHECK_RETURN_ERR(bsp_enable_features(BSP_FEATURE_BIT(BSP_FEATURE_SD)));
 
     const esp_vfs_fat_sdmmc_mount_config_t mount_config = {
 #ifdef CONFIG_BSP_SD_FORMAT_ON_MOUNT_FAIL
@@ -216,6 +177,8 @@ esp_err_t bsp_sdcard_mount(void)
 
     sdmmc_host_t host = SDSPI_HOST_DEFAULT();
     host.slot = BSP_LCD_SPI_NUM;
+    /* SD card shares the bus with LCD, let LCD transfers go first */
+    host.do_transaction = bsp_spi_arbiter_sd_transaction;
     sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
     slot_config.gpio_cs = BSP_SD_CS;
     slot_config.host_id = host.slot;
@@ -242,7 +205,7 @@ esp_codec_dev_handle_t bsp_audio_codec_speaker_init(void)
     }
     assert(i2s_data_if);
 
-    BSP_ERROR_CHECK_RETURN_ERR(bsp_enable_feature(BSP_FEATURE_SPEAKER));
+    BSP_ERROR_CHECK_RETURN_ERR(bsp_enable_features(BSP_FEATURE_BIT(BSP_FEATURE_SPEAKER)));
 
     audio_codec_i2c_cfg_t i2c_cfg = {
         .port = BSP_I2C_NUM,
@@ -312,14 +275,51 @@ static esp_err_t bsp_display_brightness_init(void)
     /* Initilize I2C */
     BSP_ERROR_CHECK_RETURN_ERR(bsp_i2c_init());
 
-    const uint8_t lcd_bl_en[] = { 0x90, 0xBF }; // AXP DLDO1 Enable
-    ESP_RETURN_ON_ERROR(i2c_master_write_to_device(BSP_I2C_NUM, BSP_AXP2101_ADDR, lcd_bl_en, sizeof(lcd_bl_en), 1000 / portTICK_PERIOD_MS), TAG, "I2C write failed");
-    const uint8_t lcd_bl_val[] = { 0x99, 0b00011000 };  // AXP DLDO1 voltage
-    ESP_RETURN_ON_ERROR(i2c_master_write_to_device(BSP_I2C_NUM, BSP_AXP2101_ADDR, lcd_bl_val, sizeof(lcd_bl_val), 1000 / portTICK_PERIOD_MS), TAG, "I2C write failed");
+    // AXP DLDO1 Enable
+    ESP_RETURN_ON_ERROR(bsp_i2c_write_reg(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, 0x90, 0xBF), TAG, "I2C write failed");
+    // AXP DLDO1 voltage
+    ESP_RETURN_ON_ERROR(bsp_i2c_write_reg(BSP_I2C_LANE_POWER, BSP_AXP2101_ADDR, 0x99, 0b00011000), TAG, "I2C write failed");
 
     return ESP_OK;
 }
 
+/* Only the last requested brightness is written, one write is in flight at most */
+static atomic_uint_fast8_t brightness_reg;
+static atomic_bool brightness_busy;
+
+static esp_err_t bsp_display_brightness_submit(uint8_t reg_val);
+
+static void bsp_display_brightness_done(esp_err_t result, void *user_ctx)
+{
+    const uint8_t written = (uint8_t)(uintptr_t)user_ctx;
+
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "I2C write failed");
+    }
+    atomic_store(&brightness_busy, false);
+    const uint8_t reg_val = atomic_load(&brightness_reg);
+    if (reg_val != written && !atomic_exchange(&brightness_busy, true)) {
+        bsp_display_brightness_submit(reg_val);
+    }
+}
+
+static esp_err_t bsp_display_brightness_submit(uint8_t reg_val)
+{
+    const bsp_i2c_xfer_t xfer = {
+        .lane = BSP_I2C_LANE_POWER,
+        .addr = BSP_AXP2101_ADDR,
+        .write_len = 2,
+        .write = { 0x99, reg_val }, // AXP DLDO1 voltage
+        .done_cb = bsp_display_brightness_done,
+        .user_ctx = (void *)(uintptr_t)reg_val,
+    };
+    const esp_err_t ret = bsp_i2c_submit(&xfer);
+    if (ret != ESP_OK) {
+        atomic_store(&brightness_busy, false);
+    }
+    return ret;
+}
+
 esp_err_t bsp_display_brightness_set(int brightness_percent)
 {
     if (brightness_percent > 100) {
@@ -331,8 +331,11 @@ esp_err_t bsp_display_brightness_set(int brightness_percent)
 
     ESP_LOGI(TAG, "Setting LCD backlight: %d%%", brightness_percent);
     const uint8_t reg_val = 20 + ((8 * brightness_percent) / 100); // 0b00000 ~ 0b11100; under 20, it is too dark
-    const uint8_t lcd_bl_val[] = { 0x99, reg_val }; // AXP DLDO1 voltage
-    ESP_RETURN_ON_ERROR(i2c_master_write_to_device(BSP_I2C_NUM, BSP_AXP2101_ADDR, lcd_bl_val, sizeof(lcd_bl_val), 1000 / portTICK_PERIOD_MS), TAG, "I2C write failed");
+    /* Does not wait for the bus, the write in flight submits the new value when it is done */
+    atomic_store(&brightness_reg, reg_val);
+    if (!atomic_exchange(&brightness_busy, true)) {
+        ESP_RETURN_ON_ERROR(bsp_display_brightness_submit(reg_val), TAG, "I2C write failed");
+    }
 
     return ESP_OK;
 }
@@ -352,14 +355,13 @@ esp_err_t bsp_display_new(const bsp_display_config_t *config, esp_lcd_panel_hand
     esp_err_t ret = ESP_OK;
     assert(config != NULL && config->max_transfer_sz > 0);
 
-    BSP_ERROR_CHECK_RETURN_ERR(bsp_enable_feature(BSP_FEATURE_LCD));
-    BSP_ERROR_CHECK_RETURN_ERR(bsp_enable_feature(BSP_FEATURE_CAMERA));
+    BSP_ERROR_CHECK_RETURN_ERR(bsp_enable_features(BSP_FEATURE_BIT(BSP_FEATURE_LCD) | BSP_FEATURE_BIT(BSP_FEATURE_CAMERA)));
 
     /* Initialize SPI */
     ESP_RETURN_ON_ERROR(bsp_spi_init(config->max_transfer_sz), TAG, "");
 
     ESP_LOGD(TAG, "Install panel IO");
-    const esp_lcd_panel_io_spi_config_t io_config = {
+    esp_lcd_panel_io_spi_config_t io_config = {
         .dc_gpio_num = BSP_LCD_DC,
         .cs_gpio_num = BSP_LCD_CS,
         .pclk_hz = BSP_LCD_PIXEL_CLOCK_HZ,
@@ -368,6 +370,9 @@ esp_err_t bsp_display_new(const bsp_display_config_t *config, esp_lcd_panel_hand
         .spi_mode = 0,
         .trans_queue_depth = 10,
     };
+#if BSP_DISPLAY_PCLK_CALIBRATION
+    io_config.pclk_hz = bsp_display_pclk_select(&io_config);
+#endif
     ESP_GOTO_ON_ERROR(esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)BSP_LCD_SPI_NUM, &io_config, ret_io), err, TAG, "New panel IO failed");
 
     ESP_LOGD(TAG, "Install LCD driver");
@@ -397,7 +402,7 @@ err:
 
 esp_err_t bsp_touch_new(const bsp_touch_config_t *config, esp_lcd_touch_handle_t *ret_touch)
 {
-    BSP_ERROR_CHECK_RETURN_ERR(bsp_enable_feature(BSP_FEATURE_TOUCH));
+    BSP_ERROR_CHECK_RETURN_ERR(bsp_enable_features(BSP_FEATURE_BIT(BSP_FEATURE_TOUCH)));
 
     /* Initialize touch */
     const esp_lcd_touch_config_t tp_cfg = {
@@ -427,36 +432,29 @@ static lv_disp_t *bsp_display_lcd_init(const bsp_display_cfg_t *cfg)
     assert(cfg != NULL);
     esp_lcd_panel_io_handle_t io_handle = NULL;
     esp_lcd_panel_handle_t panel_handle = NULL;
+    bsp_display_cfg_t disp_cfg = *cfg;
+    uint32_t transfer_px = cfg->flags.full_frame ? cfg->bounce_buffer_size : cfg->buffer_size;
+    uint32_t tune_lines = 0;
+
+    if (cfg->flags.auto_tune) {
+        /* SPI transfers must fit both the largest tuned buffer and the fallback configuration */
+        tune_lines = bsp_display_tune_probe(cfg->buffer_budget);
+        transfer_px = LV_MAX(transfer_px, tune_lines * BSP_LCD_H_RES);
+    }
     const bsp_display_config_t bsp_disp_cfg = {
-        .max_transfer_sz = BSP_LCD_DRAW_BUFF_SIZE * sizeof(uint16_t),
+        .max_transfer_sz = transfer_px * sizeof(uint16_t),
     };
     BSP_ERROR_CHECK_RETURN_NULL(bsp_display_new(&bsp_disp_cfg, &panel_handle, &io_handle));
 
+    if (tune_lines > 0 && bsp_display_tune(panel_handle, io_handle, tune_lines, &disp_cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "Draw buffer tuning failed, using default buffers");
+    }
+
     esp_lcd_panel_disp_on_off(panel_handle, true);
 
     /* Add LCD screen */
     ESP_LOGD(TAG, "Add LCD screen");
-    const lvgl_port_display_cfg_t disp_cfg = {
-        .io_handle = io_handle,
-        .panel_handle = panel_handle,
-        .buffer_size = cfg->buffer_size,
-        .double_buffer = cfg->double_buffer,
-        .hres = BSP_LCD_H_RES,
-        .vres = BSP_LCD_V_RES,
-        .monochrome = false,
-        /* Rotation values must be same as used in esp_lcd for initial settings of the screen */
-        .rotation = {
-            .swap_xy = false,
-            .mirror_x = true,
-            .mirror_y = true,
-        },
-        .flags = {
-            .buff_dma = cfg->flags.buff_dma,
-            .buff_spiram = cfg->flags.buff_spiram,
-        }
-    };
-
-    return lvgl_port_add_disp(&disp_cfg);
+    return bsp_display_flush_init(&disp_cfg, panel_handle, io_handle);
 }
 
 static lv_indev_t *bsp_display_indev_init(lv_disp_t *disp)
@@ -479,9 +477,29 @@ lv_disp_t *bsp_display_start(void)
         .lvgl_port_cfg = ESP_LVGL_PORT_INIT_CONFIG(),
         .buffer_size = BSP_LCD_DRAW_BUFF_SIZE,
         .double_buffer = BSP_LCD_DRAW_BUFF_DOUBLE,
+        .buffer_count = BSP_LCD_DRAW_BUFF_COUNT,
+        .bounce_buffer_size = BSP_LCD_BOUNCE_BUFF_SIZE,
+        .buffer_budget = BSP_LCD_DRAW_BUFF_BUDGET,
+        .task = {
+            .priority = CONFIG_BSP_DISPLAY_TASK_PRIORITY,
+            .stack_size = CONFIG_BSP_DISPLAY_TASK_STACK,
+            .core_id = CONFIG_BSP_DISPLAY_TASK_AFFINITY,
+#if CONFIG_BSP_DISPLAY_WORKER_STACK_PSRAM
+            .worker_stack_psram = true,
+#endif
+        },
         .flags = {
             .buff_dma = true,
             .buff_spiram = false,
+#if CONFIG_BSP_DISPLAY_FULL_FRAME_PSRAM
+            .full_frame = true,
+#endif
+#if CONFIG_BSP_DISPLAY_AUTO_TUNE
+            .auto_tune = true,
+#endif
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+            .parallel_render = true,
+#endif
         }
     };
     return bsp_display_start_with_config(&cfg);
@@ -490,14 +508,43 @@ lv_disp_t *bsp_display_start(void)
 lv_disp_t *bsp_display_start_with_config(const bsp_display_cfg_t *cfg)
 {
     assert(cfg != NULL);
-    BSP_ERROR_CHECK_RETURN_NULL(lvgl_port_init(&cfg->lvgl_port_cfg));
+    bsp_display_cfg_t disp_cfg = *cfg;
+
+    /* Task descriptor and lvgl_port_cfg are kept in sync, so that both can be read further on */
+    if (cfg->task.stack_size > 0) {
+        disp_cfg.lvgl_port_cfg.task_priority = cfg->task.priority;
+        disp_cfg.lvgl_port_cfg.task_stack = cfg->task.stack_size;
+        disp_cfg.lvgl_port_cfg.task_affinity = cfg->task.core_id;
+    } else {
+        disp_cfg.task.priority = cfg->lvgl_port_cfg.task_priority;
+        disp_cfg.task.stack_size = cfg->lvgl_port_cfg.task_stack;
+        disp_cfg.task.core_id = cfg->lvgl_port_cfg.task_affinity;
+    }
+    lvgl_task_cfg = disp_cfg.task;
+    BSP_ERROR_CHECK_RETURN_NULL(lvgl_port_init(&disp_cfg.lvgl_port_cfg));
+    /* esp_lvgl_port does not return the handle of its task */
+    lvgl_task = xTaskGetHandle("LVGL task");
 
     BSP_ERROR_CHECK_RETURN_NULL(bsp_display_brightness_init());
 
-    BSP_NULL_CHECK(disp = bsp_display_lcd_init(cfg), NULL);
+    BSP_NULL_CHECK(disp = bsp_display_lcd_init(&disp_cfg), NULL);
 
     BSP_NULL_CHECK(disp_indev = bsp_display_indev_init(disp), NULL);
 
+#if CONFIG_BSP_TOUCH_INTERRUPT
+    if (bsp_touch_irq_init(disp_indev, tp, &disp_cfg.task) != ESP_OK) {
+        ESP_LOGW(TAG, "Touch interrupt not available, polling the touch");
+        bsp_display_latency_touch_poll(disp_indev);
+    }
+#else
+    bsp_display_latency_touch_poll(disp_indev);
+#endif
+    bsp_touch_record_init(disp_indev);
+
+#if CONFIG_BSP_DISPLAY_PACING
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_display_pacing_init(disp, disp_indev));
+#endif
+
     return disp;
 }
 
@@ -508,45 +555,53 @@ lv_indev_t *bsp_display_get_input_dev(void)
 
 void bsp_display_rotate(lv_disp_t *disp, lv_disp_rot_t rotation)
 {
-    lv_disp_set_rotation(disp, rotation);
+    assert(rotation <= LV_DISP_ROT_270);
+    bsp_display_flush_set_rotation(disp, rotation);
+
+    if (tp) {
+        /* Raw touch coordinates are in the panel frame, so they follow the panel scan direction */
+        const bsp_display_orient_t *orient = &bsp_display_orient[rotation];
+        esp_lcd_touch_set_swap_xy(tp, orient->swap_xy);
+        esp_lcd_touch_set_mirror_x(tp, orient->mirror_x);
+        esp_lcd_touch_set_mirror_y(tp, orient->mirror_y);
+    }
+}
+
+esp_err_t bsp_display_get_task_info(bsp_display_task_info_t *info)
+{
+    ESP_RETURN_ON_FALSE(info, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(lvgl_task, ESP_ERR_INVALID_STATE, TAG, "Display was not started");
+
+    memset(info, 0, sizeof(bsp_display_task_info_t));
+    info->lvgl_stack_size = lvgl_task_cfg.stack_size;
+    info->lvgl_stack_free = uxTaskGetStackHighWaterMark(lvgl_task);
+    info->lvgl_core_id = lvgl_task_cfg.core_id;
+    info->lvgl_priority = uxTaskPriorityGet(lvgl_task);
+    info->worker_core_id = -1;
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+    bsp_display_draw_get_task_info(info);
+#endif
+    return ESP_OK;
 }
 
 bool bsp_display_lock(uint32_t timeout_ms)
 {
+#if CONFIG_BSP_DISPLAY_LATENCY
+    const int64_t start = esp_timer_get_time();
+    const bool locked = lvgl_port_lock(timeout_ms);
+    bsp_display_latency_record(BSP_DISPLAY_LATENCY_LOCK_WAIT, esp_timer_get_time() - start);
+    return locked;
+#else
     return lvgl_port_lock(timeout_ms);
+#endif
 }
 
 void bsp_display_unlock(void)
 {
+#if CONFIG_BSP_DISPLAY_PACING
+    bsp_display_pacing_unlock();
+#else
     lvgl_port_unlock();
-}
-
-
-
-/**
- * @brief Read an 8-bit register from the AXP2101.
- *
- * @param reg_addr Address of the register to read.
- * @return The value of the register, or -1 in case of an error.
- */
-static int8_t bsp_axp2101_read_register(uint8_t reg_addr) {
-    uint8_t data;
-    esp_err_t ret = i2c_master_write_read_device(BSP_I2C_NUM, BSP_AXP2101_ADDR, &reg_addr, 1, &data, 1, 1000 / portTICK_PERIOD_MS);
-    if (ret == ESP_OK) {
-        return data;
-    } else {
-        ESP_LOGE(TAG, "Failed to read register: 0x%02X, I2C error: 0x%02X", reg_addr, ret);
-        return -1;  // Use an error code that makes sense in your context
-    }
-}
-
-/**
- * @brief Get the battery level from AXP2101.
- *
- * @return Battery level as a percentage, or -1 in case of an error.
- */
-int8_t bsp_get_battery_level(void) {
-    int8_t res = bsp_axp2101_read_register(AXP2101_BATT_LEVEL_REG);
-    return res;
+#endif
 }
 #endif // (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief AW9523 IO expander with a shadow copy of its registers
+ *
+ * Output, direction, interrupt mask and control registers are cached. Updates change only the
+ * masked bits, are skipped when the cached value already matches and write both ports of a pair
+ * in one auto-increment transaction. Updates from different tasks are serialized.
+ * Registers are read from the expander only before the first partial update.
+ * Register accesses go through a bus given to bsp_aw9523_init(), the I2C task on the board.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "bsp/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I2C address of the AW9523 IO expander */
+#define BSP_AW9523_ADDR             (0x58)
+
+/* Port pairs, P0 in the low byte and P1 in the high byte of 16-bit values */
+#define BSP_AW9523_REG_INPUT        (0x00)
+#define BSP_AW9523_REG_OUTPUT       (0x02)
+#define BSP_AW9523_REG_CONFIG       (0x04)  /* 1 for input */
+#define BSP_AW9523_REG_INT          (0x06)  /* 1 to mask the interrupt */
+/* Single registers, the high byte of 16-bit values is not used */
+#define BSP_AW9523_REG_GCR          (0x11)  /* Bit 4: P0 is push-pull */
+
+#define BSP_AW9523_P0(bit)          (1 << (bit))
+#define BSP_AW9523_P1(bit)          (1 << ((bit) + 8))
+
+/**
+ * @brief Register access of the expander
+ */
+typedef struct {
+    esp_err_t (*read_regs)(bsp_i2c_lane_t lane, uint8_t addr, uint8_t reg, uint8_t *data, size_t len);  /*!< See bsp_i2c_read_regs() */
+    esp_err_t (*transfer)(const bsp_i2c_xfer_t *xfer);                                                  /*!< See bsp_i2c_transfer() */
+} bsp_aw9523_bus_t;
+
+/**
+ * @brief Create the lock and set the bus, called by bsp_i2c_init()
+ *
+ * The cache is kept over an I2C restart, the expander keeps its registers.
+ *
+ * @param[in] bus Register access, must stay valid
+ * @return
+ *      - ESP_OK         On success
+ *      - ESP_ERR_NO_MEM Not enough memory
+ */
+esp_err_t bsp_aw9523_init(const bsp_aw9523_bus_t *bus);
+
+/**
+ * @brief Forget the cached registers, the next updates read or write them again
+ *
+ * Used by the tests, which start every case with a new fake expander.
+ */
+void bsp_aw9523_invalidate(void);
+
+/**
+ * @brief Change bits of a register or a port pair
+ *
+ * @param[in] lane I2C lane of the write
+ * @param[in] reg  BSP_AW9523_REG_OUTPUT, CONFIG, INT or GCR
+ * @param[in] mask Bits to change
+ * @param[in] val  New value of the masked bits
+ * @return
+ *      - ESP_OK                On success, also when nothing was written
+ *      - ESP_ERR_INVALID_ARG   Register is not cached
+ *      - ESP_ERR_INVALID_STATE bsp_aw9523_init() was not called
+ *      - Else                  I2C failure, the cache keeps the previous value
+ */
+esp_err_t bsp_aw9523_update(bsp_i2c_lane_t lane, uint8_t reg, uint16_t mask, uint16_t val);
+
+/**
+ * @brief Turn on outputs
+ *
+ * Until the output registers are cached, both ports are set, so the outputs which are not given are off.
+ * Later calls only turn outputs on.
+ *
+ * @param[in] lane    I2C lane of the write
+ * @param[in] outputs Outputs to turn on, P0 in the low byte
+ * @return See bsp_aw9523_update()
+ */
+esp_err_t bsp_aw9523_set_outputs(bsp_i2c_lane_t lane, uint16_t outputs);
+
+/**
+ * @brief Read one register from the expander, bypassing the cache
+ *
+ * Reading an input register acknowledges the interrupt.
+ *
+ * @param[in]  lane I2C lane of the read
+ * @param[in]  reg  Register address, e.g. BSP_AW9523_REG_INPUT + 1 for P1
+ * @param[out] val  Register value
+ * @return See bsp_i2c_transfer()
+ */
+esp_err_t bsp_aw9523_read(bsp_i2c_lane_t lane, uint8_t reg, uint8_t *val);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief AXP2101 power management registers used by the BSP
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "bsp/power.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I2C address of the AXP2101 */
+#define BSP_AXP2101_ADDR                (0x34)
+
+#define BSP_AXP2101_REG_STATUS1         (0x00)  /* Bit 5: VBUS good, bit 3: battery present */
+#define BSP_AXP2101_REG_STATUS2         (0x01)  /* Bits 6:5: 0 standby, 1 charging, 2 discharging */
+#define BSP_AXP2101_REG_ADC_ENABLE      (0x30)
+#define BSP_AXP2101_REG_ADC_VBAT        (0x34)  /* ADC results of VBAT, TS, VBUS, VSYS and TDIE, 2 bytes each */
+#define BSP_AXP2101_ADC_LEN             (10)
+#define BSP_AXP2101_REG_BATT_LEVEL      (0xA4)
+
+#define BSP_AXP2101_ADC_VBAT            (1 << 0)
+#define BSP_AXP2101_ADC_VBUS            (1 << 2)
+#define BSP_AXP2101_ADC_VSYS            (1 << 3)
+#define BSP_AXP2101_ADC_TDIE            (1 << 4)
+
+/**
+ * @brief Decode status, ADC and fuel gauge registers into telemetry
+ *
+ * Fills the measured fields. time_us, updates and errors are left to the caller.
+ *
+ * @param[in]  status Registers BSP_AXP2101_REG_STATUS1 and BSP_AXP2101_REG_STATUS2
+ * @param[in]  adc    BSP_AXP2101_ADC_LEN registers from BSP_AXP2101_REG_ADC_VBAT
+ * @param[in]  level  Register BSP_AXP2101_REG_BATT_LEVEL
+ * @param[out] t      Decoded telemetry
+ */
+void bsp_axp2101_decode(const uint8_t status[2], const uint8_t adc[BSP_AXP2101_ADC_LEN], uint8_t level, bsp_power_telemetry_t *t);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,36 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief BSP LVGL draw context, shared by the target and host builds
+ */
+
+#pragma once
+
+#include "bsp/esp-bsp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+/**
+ * @brief Initialize LVGL draw context of the BSP display
+ *
+ * LVGL software draw context with opaque fills and copies done by the RGB565 kernels.
+ * Snapshots and layers taken on the display get the same draw context, their buffers with
+ * an alpha byte per pixel are left to LVGL.
+ *
+ * @param[in]  drv      LVGL display driver
+ * @param[out] draw_ctx Draw context to initialize
+ */
+void bsp_display_draw_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Latency histograms and touch to photon tracking, shared by the target and host builds
+ *
+ * A new touch contact arms the tracker. The first frame, which starts rendering with areas invalidated
+ * after the contact, is tagged with its time and records the touch latency when it reaches the display.
+ * Invalidations are reported by bsp_display_latency_invalidate_cb(), the rounder callback of the display driver.
+ * Contacts without any invalidation within a second are dropped.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "bsp/esp-bsp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_BSP_DISPLAY_LATENCY
+#define BSP_LAT_LINEAR      (16)    /* Values below are counted exactly */
+#define BSP_LAT_LINEAR_BITS (4)
+#define BSP_LAT_SUB_BITS    (2)     /* Every power of two is split into 1 << BSP_LAT_SUB_BITS buckets */
+#define BSP_LAT_BUCKETS     (BSP_LAT_LINEAR + ((32 - BSP_LAT_LINEAR_BITS) << BSP_LAT_SUB_BITS))
+
+/**
+ * @brief Histogram bucket of a latency
+ *
+ * @param[in] us Latency in microseconds
+ * @return Bucket index, below BSP_LAT_BUCKETS
+ */
+static inline int bsp_lat_bucket(uint32_t us)
+{
+    if (us < BSP_LAT_LINEAR) {
+        return us;
+    }
+    const int msb = 31 - __builtin_clz(us);
+    const int sub = (us >> (msb - BSP_LAT_SUB_BITS)) & ((1 << BSP_LAT_SUB_BITS) - 1);
+    return BSP_LAT_LINEAR + ((msb - BSP_LAT_LINEAR_BITS) << BSP_LAT_SUB_BITS) + sub;
+}
+
+/**
+ * @brief Largest latency counted in a histogram bucket
+ *
+ * @param[in] bucket Bucket index
+ * @return Upper bound in microseconds
+ */
+uint32_t bsp_lat_bucket_upper(int bucket);
+
+/**
+ * @brief Percentile of a histogram
+ *
+ * @param[in] buckets Histogram of BSP_LAT_BUCKETS buckets
+ * @param[in] count   Sum of the buckets, not 0
+ * @param[in] max     Largest recorded latency, the result does not exceed it
+ * @param[in] pct     Percentile, 1 to 100
+ * @return Upper bound of the bucket holding the percentile, in microseconds
+ */
+uint32_t bsp_lat_percentile(const uint32_t *buckets, uint32_t count, uint32_t max, uint32_t pct);
+
+/**
+ * @brief Add a sample to the latency histogram of a stage
+ *
+ * Lock free, can be called from ISR.
+ *
+ * @param[in] stage Pipeline stage
+ * @param[in] us    Latency in microseconds
+ */
+void bsp_display_latency_record(bsp_display_latency_stage_t stage, uint32_t us);
+
+/**
+ * @brief New touch contact is reported to LVGL
+ *
+ * Call from the touch read callback, before LVGL processes the contact. A contact while an older one
+ * waits for its frame is ignored, the frame showing the older one is the first which can show it.
+ *
+ * @param[in] disp       Display of the touch input device
+ * @param[in] contact_us Time of the interrupt or poll, which reported the contact
+ */
+void bsp_display_latency_touch(lv_disp_t *disp, int64_t contact_us);
+
+/**
+ * @brief Rounder callback of the display driver, reports every invalidated area
+ *
+ * LVGL calls it for each invalidation, also for an area inside an already invalidated one, which does not
+ * change the invalidated areas. Calls while rendering are ignored. The area is not changed.
+ *
+ * @param[in] drv  Display driver
+ * @param[in] area Invalidated area
+ */
+void bsp_display_latency_invalidate_cb(lv_disp_drv_t *drv, lv_area_t *area);
+
+/**
+ * @brief Check whether the frame starting to render shows the waiting contact
+ *
+ * Call from the render start callback.
+ *
+ * @param[in] disp Display starting to render
+ * @return Time of the contact shown by this frame, 0 if none
+ */
+int64_t bsp_display_latency_touch_frame(lv_disp_t *disp);
+
+/**
+ * @brief Frame tagged by bsp_display_latency_touch_frame() reached the display
+ *
+ * Lock free, can be called from ISR.
+ *
+ * @param[in] contact_us Time returned by bsp_display_latency_touch_frame(), 0 does nothing
+ * @param[in] shown_us   Time the last area of the frame was transferred
+ */
+static inline void bsp_display_latency_touch_shown(int64_t contact_us, int64_t shown_us)
+{
+    if (contact_us) {
+        bsp_display_latency_record(BSP_DISPLAY_LATENCY_TOUCH, shown_us - contact_us);
+    }
+}
+
+/**
+ * @brief Track contacts of a polled touch
+ *
+ * Wraps the read callback of the input device, a press following a release is a new contact.
+ * Not needed for inputs, which call bsp_display_latency_touch() themselves.
+ *
+ * @param[in] indev LVGL touch input device
+ */
+void bsp_display_latency_touch_poll(lv_indev_t *indev);
+#else
+#define bsp_display_latency_record(stage, us)               ((void)0)
+#define bsp_display_latency_touch(disp, contact_us)         ((void)0)
+#define bsp_display_latency_touch_frame(disp)               ((void)(disp), (int64_t)0)
+#define bsp_display_latency_touch_shown(contact_us, shown_us) ((void)0)
+#define bsp_display_latency_touch_poll(indev)               ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,214 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief BSP display internals shared between the display source files
+ */
+
+#pragma once
+
+#include "esp_idf_version.h"
+#include "esp_lcd_types.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_touch.h"
+#include "bsp/m5stack_core_s3.h"
+#include "bsp_display_latency.h"
+#include "bsp_display_draw.h"
+#include "bsp_aw9523.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Panel readback (esp_lcd_panel_io_rx_param) is available since IDF 5.0, RAMRD data comes on a separate MISO pin */
+#define BSP_DISPLAY_PCLK_CALIBRATION (CONFIG_BSP_DISPLAY_PCLK_CALIBRATION && !BSP_LCD_MISO_IS_DC && \
+                                      ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0))
+
+#if BSP_DISPLAY_PCLK_CALIBRATION
+/**
+ * @brief Select LCD SPI clock
+ *
+ * Returns the clock stored in NVS. If there is none, the fastest clock with correct panel readback is measured
+ * and stored. The SPI bus must be initialized and the panel IO not yet installed.
+ *
+ * @param[in] io_config Panel IO configuration, its pclk_hz is the starting and fallback clock
+ * @return LCD SPI clock in Hz
+ */
+uint32_t bsp_display_pclk_select(const esp_lcd_panel_io_spi_config_t *io_config);
+#endif
+
+#if (BSP_CONFIG_NO_GRAPHIC_LIB == 0)
+/* Maximum number of render buffers the flush engine can cycle */
+#define BSP_DISPLAY_FLUSH_BUFS_MAX  (4)
+
+/**
+ * @brief Register LVGL display driven by the BSP flush engine
+ *
+ * Allocates the render buffers, registers esp_lcd color transfer callback and LVGL display driver.
+ * In full frame mode, bounce buffers smaller than one line of the rotated display are rejected (ESP_ERR_INVALID_ARG).
+ *
+ * @param[in] cfg   BSP display configuration
+ * @param[in] panel esp_lcd panel handle
+ * @param[in] io    esp_lcd IO handle
+ * @return Pointer to LVGL display or NULL when error occured
+ */
+lv_disp_t *bsp_display_flush_init(const bsp_display_cfg_t *cfg, esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t io);
+
+/**
+ * @brief Panel scan direction for one rotation
+ */
+typedef struct {
+    bool swap_xy;
+    bool mirror_x;
+    bool mirror_y;
+} bsp_display_orient_t;
+
+/**
+ * @brief Panel scan direction indexed by lv_disp_rot_t
+ *
+ * Touch uses the same transformation, its raw coordinates are in the panel frame.
+ */
+extern const bsp_display_orient_t bsp_display_orient[4];
+
+/**
+ * @brief Rotate the display by reprogramming the panel scan direction
+ *
+ * LVGL renders an unrotated frame of swapped resolution, no software rotation is done.
+ * Must be called with LVGL mutex taken.
+ *
+ * @param[in] disp     LVGL display
+ * @param[in] rotation New rotation
+ */
+void bsp_display_flush_set_rotation(lv_disp_t *disp, lv_disp_rot_t rotation);
+
+/**
+ * @brief Estimate cost of sending an area to the panel
+ *
+ * @param[in] area     Area to send
+ * @param[in] buf_px   Size of the draw buffer in pixels, the area is sent in bands fitting into it
+ * @param[in] overhead Cost of one draw_bitmap call in bytes (CASET/RASET/RAMWR and transaction setup)
+ * @return Cost in bytes
+ */
+uint32_t bsp_display_coalesce_cost(const lv_area_t *area, uint32_t buf_px, uint32_t overhead);
+
+/**
+ * @brief Merge and trim areas, so that the sum of their costs decreases
+ *
+ * Merged areas are marked in the joined array, the last not joined area always stays last.
+ *
+ * @param[in,out] areas    Areas to coalesce
+ * @param[in,out] joined   Non-zero for areas which are not sent
+ * @param[in]     count    Number of areas
+ * @param[in]     buf_px   Size of the draw buffer in pixels
+ * @param[in]     overhead Cost of one draw_bitmap call in bytes
+ * @return Number of areas which are sent
+ */
+int bsp_display_coalesce(lv_area_t *areas, uint8_t *joined, int count, uint32_t buf_px, uint32_t overhead);
+
+/**
+ * @brief Coalesce invalidated areas of the frame LVGL is about to render
+ *
+ * @param[in] disp   LVGL display being refreshed
+ * @param[in] buf_px Size of the draw buffer in pixels
+ */
+void bsp_display_coalesce_frame(lv_disp_t *disp, uint32_t buf_px);
+
+#if CONFIG_BSP_DISPLAY_PARALLEL_RENDER
+/**
+ * @brief Start the helper task blending the lower band of large blends
+ *
+ * The task gets the priority of the LVGL task, its stack is in PSRAM if worker_stack_psram is set.
+ * When the LVGL task is pinned, the helper is pinned to the other core.
+ *
+ * @param[in] task LVGL task descriptor
+ * @return
+ *      - ESP_OK         On success
+ *      - ESP_ERR_NO_MEM Task could not be created
+ */
+esp_err_t bsp_display_draw_parallel_init(const bsp_display_task_cfg_t *task);
+
+/**
+ * @brief Fill the worker fields of the task information, left untouched when the helper task is not running
+ *
+ * @param[out] info Task information
+ */
+void bsp_display_draw_get_task_info(bsp_display_task_info_t *info);
+#endif
+
+/**
+ * @brief Probe free DMA memory for auto tuned buffers
+ *
+ * Must be called before the SPI bus is initialized, max_transfer_sz is derived from the result.
+ *
+ * @param[in] budget Memory budget of the buffers in bytes
+ * @return Maximum height of one buffer in lines, 0 if not even one line fits
+ */
+uint32_t bsp_display_tune_probe(uint32_t budget);
+
+/**
+ * @brief Choose buffer size and count by timing calibration flushes
+ *
+ * The panel must be initialized and off. Temporarily registers its own color transfer callback.
+ *
+ * @param[in]     panel     esp_lcd panel handle
+ * @param[in]     io        esp_lcd IO handle
+ * @param[in]     max_lines Result of bsp_display_tune_probe()
+ * @param[in,out] cfg       buffer_count and buffer_size (bounce_buffer_size with flags.full_frame) are updated
+ * @return
+ *      - ESP_OK On success, error code otherwise and cfg is not changed
+ */
+esp_err_t bsp_display_tune(esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t io, uint32_t max_lines, bsp_display_cfg_t *cfg);
+
+/**
+ * @brief Fill tuning related fields of the buffer info
+ *
+ * @param[out] info Buffer info
+ */
+void bsp_display_tune_get_info(bsp_display_buffer_info_t *info);
+
+#if CONFIG_BSP_TOUCH_INTERRUPT
+/**
+ * @brief Read the touch on interrupts of the AW9523 expander instead of polling it
+ *
+ * Wraps the read callback of the input device and starts the touch task. Must be called
+ * before bsp_display_pacing_init().
+ *
+ * @param[in] indev LVGL touch input device
+ * @param[in] tp    Touch handle read by the input device
+ * @param[in] task  LVGL task descriptor, the touch task runs on the same core one priority above
+ * @return
+ *      - ESP_OK         On success
+ *      - ESP_ERR_NO_MEM Task could not be created
+ *      - Else           I2C or GPIO failure, the touch keeps being polled
+ */
+esp_err_t bsp_touch_irq_init(lv_indev_t *indev, esp_lcd_touch_handle_t tp, const bsp_display_task_cfg_t *task);
+#endif
+
+#if CONFIG_BSP_DISPLAY_PACING
+/**
+ * @brief Start adaptive frame pacing
+ *
+ * Wraps the LVGL refresh timer and the touch read callback.
+ *
+ * @param[in] disp  LVGL display
+ * @param[in] indev LVGL touch input device, may be NULL
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   Invalid display
+ */
+esp_err_t bsp_display_pacing_init(lv_disp_t *disp, lv_indev_t *indev);
+
+/**
+ * @brief Give LVGL mutex and wake LVGL task if something was invalidated
+ */
+void bsp_display_pacing_unlock(void);
+#endif
+#endif // BSP_CONFIG_NO_GRAPHIC_LIB == 0
+
+#ifdef __cplusplus
+}
+#endif
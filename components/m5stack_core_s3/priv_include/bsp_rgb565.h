@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief RGB565 pixel kernels
+ *
+ * Fill, copy and byte-swap of 16-bit pixels. On ESP32-S3 the kernels use 128-bit PIE instructions
+ * for the aligned part of the buffers, the scalar implementation is used for the rest and on other targets.
+ * Both implementations produce identical output.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fill pixels with one color
+ *
+ * @param[out] dst   Destination pixels
+ * @param[in]  color Color in the destination byte order
+ * @param[in]  len   Number of pixels
+ */
+void bsp_rgb565_fill(uint16_t *dst, uint16_t color, size_t len);
+
+/**
+ * @brief Copy pixels
+ *
+ * @param[out] dst Destination pixels
+ * @param[in]  src Source pixels, must not overlap with dst
+ * @param[in]  len Number of pixels
+ */
+void bsp_rgb565_copy(uint16_t *dst, const uint16_t *src, size_t len);
+
+/**
+ * @brief Copy pixels and swap bytes of every pixel
+ *
+ * Converts between little endian RGB565 and the big endian byte order of the LCD (LV_COLOR_16_SWAP).
+ *
+ * @param[out] dst Destination pixels, may be the same as src
+ * @param[in]  src Source pixels
+ * @param[in]  len Number of pixels
+ */
+void bsp_rgb565_swap(uint16_t *dst, const uint16_t *src, size_t len);
+
+/**
+ * @brief Scalar reference implementations of the kernels above
+ */
+void bsp_rgb565_fill_scalar(uint16_t *dst, uint16_t color, size_t len);
+void bsp_rgb565_copy_scalar(uint16_t *dst, const uint16_t *src, size_t len);
+void bsp_rgb565_swap_scalar(uint16_t *dst, const uint16_t *src, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Arbiter of the SPI bus shared by LCD and SD card
+ *
+ * LCD transfers are queued by esp_lcd and reported to the arbiter. SD card commands go through
+ * bsp_spi_arbiter_sd_transaction(), which defers them while LCD transfers are pending and splits
+ * multi block reads and writes into chunks of CONFIG_BSP_SD_SPI_CHUNK_BLOCKS blocks.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/sdmmc_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the arbiter, called when the shared SPI bus is initialized
+ *
+ * @return
+ *      - ESP_OK      On success
+ *      - ESP_ERR_NO_MEM Not enough memory
+ */
+esp_err_t bsp_spi_arbiter_init(void);
+
+/**
+ * @brief LCD transfer was queued
+ */
+void bsp_spi_arbiter_lcd_submit(void);
+
+/**
+ * @brief Queued LCD transfer failed and will not complete
+ */
+void bsp_spi_arbiter_lcd_cancel(void);
+
+/**
+ * @brief LCD transfer completed, called from ISR
+ *
+ * @param[in] submit_us Time the transfer was queued
+ * @param[in] bytes     Size of the transfer
+ * @return true if a higher priority task was woken
+ */
+bool bsp_spi_arbiter_lcd_done_isr(int64_t submit_us, uint32_t bytes);
+
+/**
+ * @brief sdmmc_host_t::do_transaction of the SD card on the shared bus
+ *
+ * @param[in]     slot    SDSPI device handle
+ * @param[in,out] cmdinfo SD command
+ * @return Result of the SDSPI host
+ */
+esp_err_t bsp_spi_arbiter_sd_transaction(int slot, sdmmc_command_t *cmdinfo);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Touch recorder hook into the input device, shared by the target and host builds
+ */
+
+#pragma once
+
+#include "sdkconfig.h"
+#include "bsp/touch_record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_BSP_TOUCH_RECORD
+/**
+ * @brief Wrap the read callback of the touch input device for recording and replay
+ *
+ * Records what the wrapped callback reports, so it must be called after the touch driver
+ * set up its callback and before bsp_display_pacing_init().
+ *
+ * @param[in] indev LVGL touch input device
+ */
+void bsp_touch_record_init(lv_indev_t *indev);
+#else
+#define bsp_touch_record_init(indev) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,22 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "unity_test_runner.h"
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    const int failures = UNITY_END();
+#if CONFIG_IDF_TARGET_LINUX
+    exit(failures != 0);
+#else
+    (void)failures;
+#endif
+}
@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * AW9523 shadow registers against a fake expander
+ *
+ * The fake bus keeps a register file and records the transactions. Every case starts with an empty
+ * cache, the cached registers are not otherwise shared between the cases. Runs on the host only,
+ * on the board the cache belongs to the real expander.
+ */
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "bsp_aw9523.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+
+typedef struct {
+    uint8_t regs[BSP_AW9523_REG_GCR + 1];
+    int reads;
+    int writes;
+    uint8_t write_reg;      /* First register of the last write */
+    uint8_t write_len;      /* Registers written by the last write */
+    esp_err_t result;       /* Result of the next writes */
+} test_expander_t;
+
+static test_expander_t expander;
+
+static esp_err_t test_read_regs(bsp_i2c_lane_t lane, uint8_t addr, uint8_t reg, uint8_t *data, size_t len)
+{
+    TEST_ASSERT_EQUAL(BSP_AW9523_ADDR, addr);
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(expander.regs), reg + len);
+    memcpy(data, &expander.regs[reg], len);
+    expander.reads++;
+    return ESP_OK;
+}
+
+static esp_err_t test_transfer(const bsp_i2c_xfer_t *xfer)
+{
+    TEST_ASSERT_EQUAL(BSP_AW9523_ADDR, xfer->addr);
+    TEST_ASSERT_EQUAL(0, xfer->read_len);
+    TEST_ASSERT_GREATER_OR_EQUAL(2, xfer->write_len);
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(expander.regs), xfer->write[0] + xfer->write_len - 1);
+    if (expander.result != ESP_OK) {
+        return expander.result;
+    }
+    memcpy(&expander.regs[xfer->write[0]], &xfer->write[1], xfer->write_len - 1);
+    expander.write_reg = xfer->write[0];
+    expander.write_len = xfer->write_len - 1;
+    expander.writes++;
+    return ESP_OK;
+}
+
+static const bsp_aw9523_bus_t test_bus = {
+    .read_regs = test_read_regs,
+    .transfer = test_transfer,
+};
+
+/* Power-on state of the expander: all pins are inputs with masked interrupts, outputs high */
+static void test_expander_reset(void)
+{
+    memset(&expander, 0, sizeof(expander));
+    memset(&expander.regs[BSP_AW9523_REG_OUTPUT], 0xFF, 6);
+    TEST_ESP_OK(bsp_aw9523_init(&test_bus));
+    bsp_aw9523_invalidate();
+}
+
+TEST_CASE("AW9523 first outputs set both ports, later ones only turn outputs on", "[aw9523]")
+{
+    test_expander_reset();
+
+    TEST_ESP_OK(bsp_aw9523_set_outputs(BSP_I2C_LANE_POWER, BSP_AW9523_P0(1) | BSP_AW9523_P1(5)));
+    TEST_ASSERT_EQUAL(0, expander.reads);
+    TEST_ASSERT_EQUAL(1, expander.writes);
+    TEST_ASSERT_EQUAL(BSP_AW9523_REG_OUTPUT, expander.write_reg);
+    TEST_ASSERT_EQUAL(2, expander.write_len);
+    TEST_ASSERT_EQUAL_HEX8(0x02, expander.regs[BSP_AW9523_REG_OUTPUT]);
+    TEST_ASSERT_EQUAL_HEX8(0x20, expander.regs[BSP_AW9523_REG_OUTPUT + 1]);
+
+    /* Outputs already on */
+    TEST_ESP_OK(bsp_aw9523_set_outputs(BSP_I2C_LANE_POWER, BSP_AW9523_P0(1)));
+    TEST_ASSERT_EQUAL(1, expander.writes);
+
+    /* Turning on an output of P0 keeps the outputs of both ports and writes only P0 */
+    TEST_ESP_OK(bsp_aw9523_set_outputs(BSP_I2C_LANE_POWER, BSP_AW9523_P0(1) | BSP_AW9523_P0(4)));
+    TEST_ASSERT_EQUAL(2, expander.writes);
+    TEST_ASSERT_EQUAL(BSP_AW9523_REG_OUTPUT, expander.write_reg);
+    TEST_ASSERT_EQUAL(1, expander.write_len);
+    TEST_ASSERT_EQUAL_HEX8(0x12, expander.regs[BSP_AW9523_REG_OUTPUT]);
+    TEST_ASSERT_EQUAL_HEX8(0x20, expander.regs[BSP_AW9523_REG_OUTPUT + 1]);
+    TEST_ASSERT_EQUAL(0, expander.reads);
+}
+
+TEST_CASE("AW9523 first outputs are written even if the cache already holds them", "[aw9523]")
+{
+    test_expander_reset();
+    TEST_ESP_OK(bsp_aw9523_set_outputs(BSP_I2C_LANE_POWER, 0));
+    TEST_ASSERT_EQUAL(1, expander.writes);
+
+    /* Expander was reset behind the cache, the stale cache must not skip the write */
+    test_expander_reset();
+    TEST_ESP_OK(bsp_aw9523_set_outputs(BSP_I2C_LANE_POWER, 0));
+    TEST_ASSERT_EQUAL(1, expander.writes);
+    TEST_ASSERT_EQUAL(2, expander.write_len);
+    TEST_ASSERT_EQUAL_HEX8(0x00, expander.regs[BSP_AW9523_REG_OUTPUT]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, expander.regs[BSP_AW9523_REG_OUTPUT + 1]);
+}
+
+TEST_CASE("AW9523 mask across both ports is split into P0 and P1", "[aw9523]")
+{
+    test_expander_reset();
+    expander.regs[BSP_AW9523_REG_CONFIG] = 0x0F;
+    expander.regs[BSP_AW9523_REG_CONFIG + 1] = 0xF1;
+
+    /* P0 bit 7 set, P1 bit 0 cleared: both bytes are read in one transaction, then written in one */
+    TEST_ESP_OK(bsp_aw9523_update(BSP_I2C_LANE_MISC, BSP_AW9523_REG_CONFIG, BSP_AW9523_P0(7) | BSP_AW9523_P1(0), BSP_AW9523_P0(7)));
+    TEST_ASSERT_EQUAL(1, expander.reads);
+    TEST_ASSERT_EQUAL(1, expander.writes);
+    TEST_ASSERT_EQUAL(BSP_AW9523_REG_CONFIG, expander.write_reg);
+    TEST_ASSERT_EQUAL(2, expander.write_len);
+    TEST_ASSERT_EQUAL_HEX8(0x8F, expander.regs[BSP_AW9523_REG_CONFIG]);
+    TEST_ASSERT_EQUAL_HEX8(0xF0, expander.regs[BSP_AW9523_REG_CONFIG + 1]);
+
+    /* P1 bit 0 set, then cleared. Both ports are cached now, nothing is read again */
+    TEST_ESP_OK(bsp_aw9523_update(BSP_I2C_LANE_MISC, BSP_AW9523_REG_CONFIG, BSP_AW9523_P1(0), BSP_AW9523_P1(0)));
+    TEST_ASSERT_EQUAL_HEX8(0xF1, expander.regs[BSP_AW9523_REG_CONFIG + 1]);
+    TEST_ESP_OK(bsp_aw9523_update(BSP_I2C_LANE_MISC, BSP_AW9523_REG_CONFIG, BSP_AW9523_P1(0), 0));
+    TEST_ASSERT_EQUAL_HEX8(0xF0, expander.regs[BSP_AW9523_REG_CONFIG + 1]);
+    TEST_ASSERT_EQUAL_HEX8(0x8F, expander.regs[BSP_AW9523_REG_CONFIG]);
+    TEST_ASSERT_EQUAL(1, expander.reads);
+    TEST_ASSERT_EQUAL(3, expander.writes);
+}
+
+TEST_CASE("AW9523 writes only the changed port of a pair", "[aw9523]")
+{
+    test_expander_reset();
+
+    /* Full mask is written without reading */
+    TEST_ESP_OK(bsp_aw9523_update(BSP_I2C_LANE_TOUCH, BSP_AW9523_REG_INT, 0xFFFF, 0xFFFF));
+    TEST_ASSERT_EQUAL(0, expander.reads);
+    TEST_ASSERT_EQUAL(1, expander.writes);
+    TEST_ASSERT_EQUAL(2, expander.write_len);
+
+    /* Only P1 changes */
+    TEST_ESP_OK(bsp_aw9523_update(BSP_I2C_LANE_TOUCH, BSP_AW9523_REG_INT, 0xFFFF, 0xFBFF));
+    TEST_ASSERT_EQUAL(2, expander.writes);
+    TEST_ASSERT_EQUAL(BSP_AW9523_REG_INT + 1, expander.write_reg);
+    TEST_ASSERT_EQUAL(1, expander.write_len);
+    TEST_ASSERT_EQUAL_HEX8(0xFB, expander.regs[BSP_AW9523_REG_INT + 1]);
+
+    /* Only P0 changes */
+    TEST_ESP_OK(bsp_aw9523_update(BSP_I2C_LANE_TOUCH, BSP_AW9523_REG_INT, 0x00FF, 0x00FE));
+    TEST_ASSERT_EQUAL(3, expander.writes);
+    TEST_ASSERT_EQUAL(BSP_AW9523_REG_INT, expander.write_reg);
+    TEST_ASSERT_EQUAL(1, expander.write_len);
+    TEST_ASSERT_EQUAL_HEX8(0xFE, expander.regs[BSP_AW9523_REG_INT]);
+
+    /* Nothing changes */
+    TEST_ESP_OK(bsp_aw9523_update(BSP_I2C_LANE_TOUCH, BSP_AW9523_REG_INT, 0xFFFF, 0xFBFE));
+    TEST_ASSERT_EQUAL(3, expander.writes);
+    TEST_ASSERT_EQUAL(0, expander.reads);
+}
+
+TEST_CASE("AW9523 failed write keeps the previous cached value", "[aw9523]")
+{
+    test_expander_reset();
+    TEST_ESP_OK(bsp_aw9523_update(BSP_I2C_LANE_POWER, BSP_AW9523_REG_GCR, 0xFF, 0x00));
+    TEST_ASSERT_EQUAL(BSP_AW9523_REG_GCR, expander.write_reg);
+    TEST_ASSERT_EQUAL(1, expander.write_len);
+
+    expander.result = ESP_FAIL;
+    TEST_ESP_ERR(ESP_FAIL, bsp_aw9523_update(BSP_I2C_LANE_POWER, BSP_AW9523_REG_GCR, 0xFF, 0x10));
+    TEST_ASSERT_EQUAL_HEX8(0x00, expander.regs[BSP_AW9523_REG_GCR]);
+
+    /* Retry is not skipped as unchanged */
+    expander.result = ESP_OK;
+    TEST_ESP_OK(bsp_aw9523_update(BSP_I2C_LANE_POWER, BSP_AW9523_REG_GCR, 0xFF, 0x10));
+    TEST_ASSERT_EQUAL(2, expander.writes);
+    TEST_ASSERT_EQUAL_HEX8(0x10, expander.regs[BSP_AW9523_REG_GCR]);
+
+    /* GCR is a single register, inputs are not cached */
+    TEST_ESP_ERR(ESP_ERR_INVALID_ARG, bsp_aw9523_update(BSP_I2C_LANE_POWER, BSP_AW9523_REG_GCR, 0x1FF, 0));
+    TEST_ESP_ERR(ESP_ERR_INVALID_ARG, bsp_aw9523_update(BSP_I2C_LANE_POWER, BSP_AW9523_REG_INPUT, 0xFF, 0));
+    TEST_ASSERT_EQUAL(2, expander.writes);
+}
+
+#endif // CONFIG_IDF_TARGET_LINUX
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * BSP draw context with buffers which are not plain RGB565
+ *
+ * Snapshots are rendered by the draw context of the display. A TRUE_COLOR_ALPHA snapshot has 3 bytes
+ * per pixel written through set_px_cb, the opaque fills must not be done by the RGB565 kernels.
+ * The object is 37 pixels wide, so a 2 bytes per pixel stride would shift every line. Guard bytes after
+ * the snapshot catch writes out of bounds. Runs on the host, which renders with the board draw context.
+ */
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "bsp/esp-bsp.h"
+
+#if CONFIG_IDF_TARGET_LINUX && LV_USE_SNAPSHOT
+
+#define TEST_OBJ_W      (37)
+#define TEST_OBJ_H      (9)
+#define TEST_CHILD_X    (4)
+#define TEST_CHILD_Y    (2)
+#define TEST_CHILD_W    (5)
+#define TEST_CHILD_H    (3)
+#define TEST_GUARD      (64)
+#define TEST_GUARD_BYTE (0xA5)
+
+static uint8_t snapshot_buf[TEST_OBJ_W * TEST_OBJ_H * LV_IMG_PX_SIZE_ALPHA_BYTE + TEST_GUARD];
+
+static lv_obj_t *test_create_panel(lv_color_t bg, lv_color_t fg)
+{
+    if (lv_disp_get_default() == NULL) {
+        TEST_ASSERT_NOT_NULL(bsp_display_start());
+    }
+    TEST_ASSERT_TRUE(bsp_display_lock(0));
+    lv_obj_t *panel = lv_obj_create(lv_scr_act());
+    lv_obj_remove_style_all(panel);
+    lv_obj_set_size(panel, TEST_OBJ_W, TEST_OBJ_H);
+    lv_obj_set_style_bg_color(panel, bg, 0);
+    lv_obj_set_style_bg_opa(panel, LV_OPA_COVER, 0);
+
+    lv_obj_t *child = lv_obj_create(panel);
+    lv_obj_remove_style_all(child);
+    lv_obj_set_pos(child, TEST_CHILD_X, TEST_CHILD_Y);
+    lv_obj_set_size(child, TEST_CHILD_W, TEST_CHILD_H);
+    lv_obj_set_style_bg_color(child, fg, 0);
+    lv_obj_set_style_bg_opa(child, LV_OPA_COVER, 0);
+    lv_obj_update_layout(panel);
+    return panel;
+}
+
+static lv_color_t test_expected(int x, int y, lv_color_t bg, lv_color_t fg)
+{
+    const bool in_child = x >= TEST_CHILD_X && x < TEST_CHILD_X + TEST_CHILD_W &&
+                          y >= TEST_CHILD_Y && y < TEST_CHILD_Y + TEST_CHILD_H;
+    return in_child ? fg : bg;
+}
+
+static void test_snapshot(lv_img_cf_t cf, uint32_t px_size)
+{
+    const lv_color_t bg = lv_color_hex(0x3366CC);
+    const lv_color_t fg = lv_color_hex(0xF08010);
+    lv_img_dsc_t dsc;
+
+    lv_obj_t *panel = test_create_panel(bg, fg);
+    const uint32_t size = lv_snapshot_buf_size_needed(panel, cf);
+    TEST_ASSERT_EQUAL(TEST_OBJ_W * TEST_OBJ_H * px_size, size);
+    memset(snapshot_buf, TEST_GUARD_BYTE, sizeof(snapshot_buf));
+    TEST_ASSERT_EQUAL(LV_RES_OK, lv_snapshot_take_to_buf(panel, cf, &dsc, snapshot_buf, size));
+    lv_obj_del(panel);
+    bsp_display_unlock();
+
+    TEST_ASSERT_EQUAL(TEST_OBJ_W, dsc.header.w);
+    TEST_ASSERT_EQUAL(TEST_OBJ_H, dsc.header.h);
+    for (int y = 0; y < TEST_OBJ_H; y++) {
+        for (int x = 0; x < TEST_OBJ_W; x++) {
+            const uint8_t *px = &snapshot_buf[(y * TEST_OBJ_W + x) * px_size];
+            const lv_color_t color = test_expected(x, y, bg, fg);
+            TEST_ASSERT_EQUAL_HEX8_ARRAY((const uint8_t *)&color, px, sizeof(lv_color_t));
+            if (px_size == LV_IMG_PX_SIZE_ALPHA_BYTE) {
+                TEST_ASSERT_EQUAL_HEX8(LV_OPA_COVER, px[sizeof(lv_color_t)]);
+            }
+        }
+    }
+    for (size_t i = size; i < sizeof(snapshot_buf); i++) {
+        TEST_ASSERT_EQUAL_HEX8(TEST_GUARD_BYTE, snapshot_buf[i]);
+    }
+}
+
+TEST_CASE("opaque fills into a snapshot with alpha keep 3 bytes per pixel", "[display_draw]")
+{
+    test_snapshot(LV_IMG_CF_TRUE_COLOR_ALPHA, LV_IMG_PX_SIZE_ALPHA_BYTE);
+}
+
+TEST_CASE("opaque fills into a snapshot without alpha use the display format", "[display_draw]")
+{
+    test_snapshot(LV_IMG_CF_TRUE_COLOR, sizeof(lv_color_t));
+}
+
+#endif // CONFIG_IDF_TARGET_LINUX && LV_USE_SNAPSHOT
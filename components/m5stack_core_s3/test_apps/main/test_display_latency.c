@@ -0,0 +1,117 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Latency histogram buckets and percentiles
+ *
+ * Values below 16 us have a bucket each, every power of two above is split into four buckets.
+ * Percentiles are the upper bounds of the buckets, capped at the largest recorded value.
+ * The recording test uses the lock wait stage, which is not recorded by the host display.
+ */
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "bsp/esp-bsp.h"
+#include "bsp_display_latency.h"
+
+#if CONFIG_BSP_DISPLAY_LATENCY
+
+TEST_CASE("latency buckets are exact below 16 us and a quarter of a power of two above", "[display_latency]")
+{
+    TEST_ASSERT_EQUAL(0, bsp_lat_bucket(0));
+    TEST_ASSERT_EQUAL(15, bsp_lat_bucket(15));
+    TEST_ASSERT_EQUAL_UINT32(15, bsp_lat_bucket_upper(15));
+    /* 16 to 19 is the first bucket of the power of two 16 */
+    TEST_ASSERT_EQUAL(16, bsp_lat_bucket(16));
+    TEST_ASSERT_EQUAL(16, bsp_lat_bucket(19));
+    TEST_ASSERT_EQUAL_UINT32(19, bsp_lat_bucket_upper(16));
+    TEST_ASSERT_EQUAL(17, bsp_lat_bucket(20));
+    TEST_ASSERT_EQUAL_UINT32(23, bsp_lat_bucket_upper(17));
+    TEST_ASSERT_EQUAL(19, bsp_lat_bucket(31));
+    TEST_ASSERT_EQUAL(20, bsp_lat_bucket(32));
+    /* Last bucket ends at the largest value */
+    TEST_ASSERT_EQUAL(BSP_LAT_BUCKETS - 1, bsp_lat_bucket(UINT32_MAX));
+    TEST_ASSERT_EQUAL(BSP_LAT_BUCKETS - 1, bsp_lat_bucket(0xE0000000));
+    TEST_ASSERT_EQUAL(BSP_LAT_BUCKETS - 2, bsp_lat_bucket(0xDFFFFFFF));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, bsp_lat_bucket_upper(BSP_LAT_BUCKETS - 1));
+
+    /* Buckets are contiguous and at most 25 % wide */
+    uint32_t lower = 0;
+    for (int i = 0; i < BSP_LAT_BUCKETS; i++) {
+        const uint32_t upper = bsp_lat_bucket_upper(i);
+        TEST_ASSERT_EQUAL(i, bsp_lat_bucket(lower));
+        TEST_ASSERT_EQUAL(i, bsp_lat_bucket(upper));
+        if (lower >= BSP_LAT_LINEAR) {
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32(lower / 4, upper - lower);
+        } else {
+            TEST_ASSERT_EQUAL_UINT32(lower, upper);
+        }
+        if (i < BSP_LAT_BUCKETS - 1) {
+            TEST_ASSERT_EQUAL(i + 1, bsp_lat_bucket(upper + 1));
+        }
+        lower = upper + 1;
+    }
+}
+
+TEST_CASE("latency percentiles of a known distribution", "[display_latency]")
+{
+    static uint32_t buckets[BSP_LAT_BUCKETS];
+
+    /* 90 x 5 us, 9 x 12 us and 1 x 15 us, all counted exactly */
+    memset(buckets, 0, sizeof(buckets));
+    buckets[bsp_lat_bucket(5)] = 90;
+    buckets[bsp_lat_bucket(12)] = 9;
+    buckets[bsp_lat_bucket(15)] = 1;
+    TEST_ASSERT_EQUAL_UINT32(5, bsp_lat_percentile(buckets, 100, 15, 50));
+    TEST_ASSERT_EQUAL_UINT32(5, bsp_lat_percentile(buckets, 100, 15, 90));
+    TEST_ASSERT_EQUAL_UINT32(12, bsp_lat_percentile(buckets, 100, 15, 91));
+    TEST_ASSERT_EQUAL_UINT32(12, bsp_lat_percentile(buckets, 100, 15, 99));
+    TEST_ASSERT_EQUAL_UINT32(15, bsp_lat_percentile(buckets, 100, 15, 100));
+
+    /* 1 to 1000 us once each: the median 500 is in the bucket 448 to 511 */
+    memset(buckets, 0, sizeof(buckets));
+    for (uint32_t us = 1; us <= 1000; us++) {
+        buckets[bsp_lat_bucket(us)]++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(511, bsp_lat_percentile(buckets, 1000, 1000, 50));
+    /* 950 is in the bucket 896 to 1023, capped at the maximum */
+    TEST_ASSERT_EQUAL_UINT32(1000, bsp_lat_percentile(buckets, 1000, 1000, 95));
+    TEST_ASSERT_EQUAL_UINT32(1000, bsp_lat_percentile(buckets, 1000, 1000, 99));
+    /* Rank rounds up, the 10th value of 1000 is 10 */
+    TEST_ASSERT_EQUAL_UINT32(10, bsp_lat_percentile(buckets, 1000, 1000, 1));
+
+    /* Single huge value */
+    memset(buckets, 0, sizeof(buckets));
+    buckets[bsp_lat_bucket(UINT32_MAX)] = 1;
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, bsp_lat_percentile(buckets, 1, UINT32_MAX, 50));
+}
+
+TEST_CASE("recorded latencies give the same percentiles", "[display_latency]")
+{
+    bsp_display_latency_t lat;
+
+    bsp_display_reset_latency();
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_display_get_latency(BSP_DISPLAY_LATENCY_LOCK_WAIT, &lat));
+    TEST_ASSERT_EQUAL_UINT32(0, lat.count);
+    TEST_ASSERT_EQUAL_UINT32(0, lat.p50_us);
+    TEST_ASSERT_EQUAL_UINT32(0, lat.max_us);
+
+    for (uint32_t us = 1; us <= 1000; us++) {
+        bsp_display_latency_record(BSP_DISPLAY_LATENCY_LOCK_WAIT, us);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_display_get_latency(BSP_DISPLAY_LATENCY_LOCK_WAIT, &lat));
+    TEST_ASSERT_EQUAL_UINT32(1000, lat.count);
+    TEST_ASSERT_EQUAL_UINT32(511, lat.p50_us);
+    TEST_ASSERT_EQUAL_UINT32(1000, lat.p95_us);
+    TEST_ASSERT_EQUAL_UINT32(1000, lat.p99_us);
+    TEST_ASSERT_EQUAL_UINT32(1000, lat.max_us);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, bsp_display_get_latency(BSP_DISPLAY_LATENCY_MAX, &lat));
+    bsp_display_reset_latency();
+}
+
+#endif // CONFIG_BSP_DISPLAY_LATENCY
@@ -0,0 +1,87 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Layer cache against direct rendering
+ *
+ * An opaque panel with a child is rendered into the host framebuffer, then cached and rendered again
+ * from its snapshot. The snapshot is taken through the BSP draw context, so both frames must be
+ * the same to the byte. Odd sizes and positions catch a wrong stride of the snapshot buffer.
+ * There is no anti-aliasing and no text, the pixels do not depend on the rendering path.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "bsp/esp-bsp.h"
+
+#if CONFIG_IDF_TARGET_LINUX && CONFIG_BSP_DISPLAY_LAYER_CACHE && LV_USE_SNAPSHOT
+
+#define TEST_FB_SIZE    (BSP_LCD_H_RES * BSP_LCD_V_RES * sizeof(lv_color_t))
+
+static lv_obj_t *test_create_box(lv_obj_t *parent, lv_coord_t x, lv_coord_t y, lv_coord_t w, lv_coord_t h, uint32_t color)
+{
+    lv_obj_t *obj = lv_obj_create(parent);
+    lv_obj_remove_style_all(obj);
+    lv_obj_set_pos(obj, x, y);
+    lv_obj_set_size(obj, w, h);
+    lv_obj_set_style_bg_color(obj, lv_color_hex(color), 0);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_COVER, 0);
+    return obj;
+}
+
+/* Render the whole screen into the framebuffer */
+static void test_render(void *out)
+{
+    lv_obj_invalidate(lv_scr_act());
+    lv_refr_now(NULL);
+    memcpy(out, bsp_display_host_get_framebuffer(), TEST_FB_SIZE);
+}
+
+TEST_CASE("cached opaque layer renders the same as the object", "[display_layer]")
+{
+    uint8_t *direct = malloc(TEST_FB_SIZE);
+    uint8_t *cached = malloc(TEST_FB_SIZE);
+    bsp_display_layer_stats_t stats;
+    TEST_ASSERT_NOT_NULL(direct);
+    TEST_ASSERT_NOT_NULL(cached);
+
+    if (lv_disp_get_default() == NULL) {
+        TEST_ASSERT_NOT_NULL(bsp_display_start());
+    }
+    TEST_ASSERT_TRUE(bsp_display_lock(0));
+    lv_obj_t *panel = test_create_box(lv_scr_act(), 13, 7, 61, 23, 0x3366CC);
+    test_create_box(panel, 5, 3, 17, 11, 0xF08010);
+    test_create_box(panel, 40, 9, 21, 14, 0x10C040);
+    lv_obj_update_layout(panel);
+    test_render(direct);
+
+    bsp_display_reset_layer_stats();
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_display_layer_cache(panel));
+    TEST_ASSERT_TRUE(lv_obj_has_flag(panel, LV_OBJ_FLAG_HIDDEN));
+    test_render(cached);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(direct, cached, TEST_FB_SIZE);
+
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_display_get_layer_stats(&stats));
+    TEST_ASSERT_EQUAL(1, stats.layers);
+    TEST_ASSERT_EQUAL(1, stats.opaque_layers);
+    TEST_ASSERT_EQUAL(1, stats.misses);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, stats.blits);
+    TEST_ASSERT_EQUAL(stats.hits, stats.blits);
+    TEST_ASSERT_EQUAL(0, stats.blends);
+
+    /* Deleting the root releases the layer */
+    lv_obj_del(panel);
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_display_get_layer_stats(&stats));
+    TEST_ASSERT_EQUAL(0, stats.layers);
+    lv_refr_now(NULL);
+    bsp_display_unlock();
+    free(direct);
+    free(cached);
+}
+
+#endif // CONFIG_IDF_TARGET_LINUX && CONFIG_BSP_DISPLAY_LAYER_CACHE && LV_USE_SNAPSHOT
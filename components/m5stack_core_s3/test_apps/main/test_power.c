@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * AXP2101 register decoding
+ *
+ * Register buffers as the telemetry burst reads return them. Unused high bits of the ADC results
+ * are set, so a missing mask shows up in the voltages.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "bsp_axp2101.h"
+
+#define TEST_STATUS1_VBUS_GOOD  (1 << 5)
+#define TEST_STATUS1_BATTERY    (1 << 3)
+
+/* ADC results with the unused high bits set */
+static void test_adc(uint8_t adc[BSP_AXP2101_ADC_LEN], uint16_t vbat, uint16_t vbus, uint16_t vsys, uint16_t tdie)
+{
+    adc[0] = 0xE0 | (vbat >> 8);
+    adc[1] = vbat & 0xFF;
+    adc[2] = 0xFF;      /* TS is not decoded */
+    adc[3] = 0xFF;
+    adc[4] = 0xC0 | (vbus >> 8);
+    adc[5] = vbus & 0xFF;
+    adc[6] = 0xC0 | (vsys >> 8);
+    adc[7] = vsys & 0xFF;
+    adc[8] = 0xC0 | (tdie >> 8);
+    adc[9] = tdie & 0xFF;
+}
+
+TEST_CASE("AXP2101 ADC results are masked to their width", "[power]")
+{
+    const uint8_t status[2] = { TEST_STATUS1_VBUS_GOOD | TEST_STATUS1_BATTERY, 0x20 };
+    uint8_t adc[BSP_AXP2101_ADC_LEN];
+    bsp_power_telemetry_t t;
+
+    test_adc(adc, 4012, 5000, 4800, 7274);
+    bsp_axp2101_decode(status, adc, 87, &t);
+    TEST_ASSERT_TRUE(t.battery_present);
+    TEST_ASSERT_TRUE(t.vbus_good);
+    TEST_ASSERT_EQUAL_UINT16(4012, t.vbat_mv);
+    TEST_ASSERT_EQUAL_UINT16(5000, t.vbus_mv);
+    TEST_ASSERT_EQUAL_UINT16(4800, t.vsys_mv);
+    TEST_ASSERT_EQUAL_INT16(220, t.die_temp_dc);
+    TEST_ASSERT_EQUAL_INT8(87, t.battery_level);
+    TEST_ASSERT_EQUAL(BSP_POWER_CHARGE_CHARGING, t.charge);
+
+    /* Largest values: VBAT has 13 bits (H5L8), the others 14 bits (H6L8) */
+    memset(adc, 0xFF, sizeof(adc));
+    bsp_axp2101_decode(status, adc, 100, &t);
+    TEST_ASSERT_EQUAL_UINT16(0x1FFF, t.vbat_mv);
+    TEST_ASSERT_EQUAL_UINT16(0x3FFF, t.vbus_mv);
+    TEST_ASSERT_EQUAL_UINT16(0x3FFF, t.vsys_mv);
+    TEST_ASSERT_EQUAL_INT16(220 + (7274 - 0x3FFF) / 2, t.die_temp_dc);
+
+    /* Counters and time are left to the caller */
+    TEST_ASSERT_EQUAL_INT32(0, (int32_t)t.time_us);
+    TEST_ASSERT_EQUAL_UINT32(0, t.updates);
+    TEST_ASSERT_EQUAL_UINT32(0, t.errors);
+}
+
+TEST_CASE("AXP2101 die temperature is 22 degrees at 7274 and 20 LSB per degree", "[power]")
+{
+    static const struct {
+        uint16_t tdie;
+        int16_t temp_dc;
+    } temps[] = {
+        { 7274, 220 },
+        { 7254, 230 },
+        { 7174, 270 },
+        { 6874, 420 },
+        { 7294, 210 },
+        { 7300, 207 },  /* Rounds towards zero */
+        { 0, 3857 },
+    };
+    const uint8_t status[2] = { TEST_STATUS1_BATTERY, 0 };
+    uint8_t adc[BSP_AXP2101_ADC_LEN];
+    bsp_power_telemetry_t t;
+
+    for (size_t i = 0; i < sizeof(temps) / sizeof(temps[0]); i++) {
+        test_adc(adc, 3700, 0, 3700, temps[i].tdie);
+        bsp_axp2101_decode(status, adc, 50, &t);
+        TEST_ASSERT_EQUAL_INT16(temps[i].temp_dc, t.die_temp_dc);
+    }
+}
+
+TEST_CASE("AXP2101 status bits gate the voltages and clamp charge and level", "[power]")
+{
+    uint8_t adc[BSP_AXP2101_ADC_LEN];
+    bsp_power_telemetry_t t;
+    test_adc(adc, 3900, 5100, 4900, 7274);
+
+    /* No battery: no voltage and level -1, the fuel gauge register is ignored */
+    const uint8_t usb_only[2] = { (uint8_t)~TEST_STATUS1_BATTERY, 0x40 };
+    bsp_axp2101_decode(usb_only, adc, 42, &t);
+    TEST_ASSERT_FALSE(t.battery_present);
+    TEST_ASSERT_TRUE(t.vbus_good);
+    TEST_ASSERT_EQUAL_UINT16(0, t.vbat_mv);
+    TEST_ASSERT_EQUAL_UINT16(5100, t.vbus_mv);
+    TEST_ASSERT_EQUAL_INT8(-1, t.battery_level);
+    TEST_ASSERT_EQUAL(BSP_POWER_CHARGE_DISCHARGING, t.charge);
+
+    /* No USB power */
+    const uint8_t battery_only[2] = { (uint8_t)~TEST_STATUS1_VBUS_GOOD, 0x00 };
+    bsp_axp2101_decode(battery_only, adc, 150, &t);
+    TEST_ASSERT_TRUE(t.battery_present);
+    TEST_ASSERT_FALSE(t.vbus_good);
+    TEST_ASSERT_EQUAL_UINT16(3900, t.vbat_mv);
+    TEST_ASSERT_EQUAL_UINT16(0, t.vbus_mv);
+    TEST_ASSERT_EQUAL_UINT16(4900, t.vsys_mv);
+    TEST_ASSERT_EQUAL_INT8(100, t.battery_level);
+    TEST_ASSERT_EQUAL(BSP_POWER_CHARGE_STANDBY, t.charge);
+
+    /* Charge state is bits 6:5 of STATUS2, the reserved value 3 is reported as standby */
+    static const struct {
+        uint8_t status2;
+        bsp_power_charge_t charge;
+    } charges[] = {
+        { 0x00, BSP_POWER_CHARGE_STANDBY },
+        { 0x20, BSP_POWER_CHARGE_CHARGING },
+        { 0x40, BSP_POWER_CHARGE_DISCHARGING },
+        { 0x60, BSP_POWER_CHARGE_STANDBY },
+        { 0x9F, BSP_POWER_CHARGE_STANDBY },
+        { 0xBF, BSP_POWER_CHARGE_CHARGING },
+        { 0xFF, BSP_POWER_CHARGE_STANDBY },
+    };
+    for (size_t i = 0; i < sizeof(charges) / sizeof(charges[0]); i++) {
+        const uint8_t status[2] = { TEST_STATUS1_BATTERY, charges[i].status2 };
+        bsp_axp2101_decode(status, adc, 100, &t);
+        TEST_ASSERT_EQUAL(charges[i].charge, t.charge);
+    }
+}
@@ -0,0 +1,214 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * RGB565 kernels against the scalar reference
+ *
+ * Pixels are 16-bit aligned, so the offsets 0 to 7 pixels cover every position of the buffers within
+ * a 128-bit PIE vector (byte offsets 0, 2, ..., 14). Lengths cover empty buffers, odd lengths, tails
+ * of every size next to whole vectors and several loop iterations. Guard pixels around the destination
+ * catch writes out of bounds. On esp32s3 the fast kernels run the PIE path, on linux the generic one.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "bsp_rgb565.h"
+
+#define TEST_MAX_OFFSET     (8)     /* Pixels, 16 bytes */
+#define TEST_MAX_LEN        (80)
+#define TEST_GUARD          (16)
+#define TEST_BUF_LEN        (TEST_GUARD + TEST_MAX_OFFSET + 1100 + TEST_GUARD)
+#define TEST_GUARD_PIXEL    (0xA55A)
+
+static uint16_t src_buf[TEST_BUF_LEN] __attribute__((aligned(16)));
+static uint16_t dst_buf[TEST_BUF_LEN] __attribute__((aligned(16)));
+static uint16_t ref_buf[TEST_BUF_LEN] __attribute__((aligned(16)));
+
+static const size_t long_lens[] = { 127, 128, 129, 255, 256, 257, 1023, 1024, 1025 };
+
+static void test_fill_pattern(uint16_t *buf, size_t len, uint32_t seed)
+{
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = (uint16_t)(seed >> 16);
+    }
+}
+
+static void test_guard(uint16_t *buf)
+{
+    for (size_t i = 0; i < TEST_BUF_LEN; i++) {
+        buf[i] = TEST_GUARD_PIXEL;
+    }
+}
+
+/* Both destinations have the same guards, comparing whole buffers checks the guards too */
+static void test_compare(const char *kernel, size_t dst_off, size_t src_off, size_t len)
+{
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%s dst +%u src +%u len %u", kernel, (unsigned)dst_off, (unsigned)src_off, (unsigned)len);
+    TEST_ASSERT_EQUAL_HEX16_ARRAY_MESSAGE(ref_buf, dst_buf, TEST_BUF_LEN, msg);
+}
+
+static void test_lens(void (*check)(size_t len))
+{
+    for (size_t len = 0; len <= TEST_MAX_LEN; len++) {
+        check(len);
+    }
+    for (size_t i = 0; i < sizeof(long_lens) / sizeof(long_lens[0]); i++) {
+        check(long_lens[i]);
+    }
+}
+
+static void test_check_fill(size_t len)
+{
+    for (size_t dst_off = 0; dst_off < TEST_MAX_OFFSET; dst_off++) {
+        uint16_t *dst = &dst_buf[TEST_GUARD + dst_off];
+        uint16_t *ref = &ref_buf[TEST_GUARD + dst_off];
+        const uint16_t color = 0x1234 + len * 17 + dst_off;
+
+        test_guard(dst_buf);
+        test_guard(ref_buf);
+        bsp_rgb565_fill(dst, color, len);
+        bsp_rgb565_fill_scalar(ref, color, len);
+        test_compare("fill", dst_off, 0, len);
+        for (size_t i = 0; i < len; i++) {
+            TEST_ASSERT_EQUAL_HEX16(color, ref[i]);
+        }
+    }
+}
+
+static void test_check_copy(size_t len)
+{
+    for (size_t dst_off = 0; dst_off < TEST_MAX_OFFSET; dst_off++) {
+        for (size_t src_off = 0; src_off < TEST_MAX_OFFSET; src_off++) {
+            uint16_t *dst = &dst_buf[TEST_GUARD + dst_off];
+            uint16_t *ref = &ref_buf[TEST_GUARD + dst_off];
+            const uint16_t *src = &src_buf[TEST_GUARD + src_off];
+
+            test_guard(dst_buf);
+            test_guard(ref_buf);
+            bsp_rgb565_copy(dst, src, len);
+            bsp_rgb565_copy_scalar(ref, src, len);
+            test_compare("copy", dst_off, src_off, len);
+            TEST_ASSERT_EQUAL_MEMORY(src, ref, len * sizeof(uint16_t));
+        }
+    }
+}
+
+static void test_check_swap(size_t len)
+{
+    for (size_t dst_off = 0; dst_off < TEST_MAX_OFFSET; dst_off++) {
+        for (size_t src_off = 0; src_off < TEST_MAX_OFFSET; src_off++) {
+            uint16_t *dst = &dst_buf[TEST_GUARD + dst_off];
+            uint16_t *ref = &ref_buf[TEST_GUARD + dst_off];
+            const uint16_t *src = &src_buf[TEST_GUARD + src_off];
+
+            test_guard(dst_buf);
+            test_guard(ref_buf);
+            bsp_rgb565_swap(dst, src, len);
+            bsp_rgb565_swap_scalar(ref, src, len);
+            test_compare("swap", dst_off, src_off, len);
+            for (size_t i = 0; i < len; i++) {
+                TEST_ASSERT_EQUAL_HEX16((uint16_t)((src[i] >> 8) | (src[i] << 8)), ref[i]);
+            }
+        }
+    }
+}
+
+static void test_check_swap_in_place(size_t len)
+{
+    for (size_t off = 0; off < TEST_MAX_OFFSET; off++) {
+        uint16_t *dst = &dst_buf[TEST_GUARD + off];
+        uint16_t *ref = &ref_buf[TEST_GUARD + off];
+
+        test_guard(dst_buf);
+        test_guard(ref_buf);
+        test_fill_pattern(dst, len, len + off);
+        test_fill_pattern(ref, len, len + off);
+        bsp_rgb565_swap(dst, dst, len);
+        bsp_rgb565_swap_scalar(ref, ref, len);
+        test_compare("swap in place", off, off, len);
+    }
+}
+
+TEST_CASE("rgb565 fill matches the scalar kernel", "[rgb565]")
+{
+    test_lens(test_check_fill);
+}
+
+TEST_CASE("rgb565 copy matches the scalar kernel", "[rgb565]")
+{
+    test_fill_pattern(src_buf, TEST_BUF_LEN, 1);
+    test_lens(test_check_copy);
+}
+
+TEST_CASE("rgb565 swap matches the scalar kernel", "[rgb565]")
+{
+    test_fill_pattern(src_buf, TEST_BUF_LEN, 2);
+    test_lens(test_check_swap);
+}
+
+TEST_CASE("rgb565 swap in place matches the scalar kernel", "[rgb565]")
+{
+    test_lens(test_check_swap_in_place);
+}
+
+/*
+ * Benchmark
+ *
+ * One 40 line band of the 320 pixel wide display, the size of a typical partial draw buffer.
+ * Prints MB/s of the fast and the scalar kernels for aligned buffers and for a 2 byte offset
+ * destination, which takes the unaligned head path.
+ */
+#define BENCH_PX            (320 * 40)
+#define BENCH_ROUNDS        (50)
+
+static uint16_t bench_src[BENCH_PX + 8] __attribute__((aligned(16)));
+static uint16_t bench_dst[BENCH_PX + 8] __attribute__((aligned(16)));
+
+typedef enum {
+    BENCH_FILL,
+    BENCH_COPY,
+    BENCH_SWAP,
+} bench_kernel_t;
+
+static float bench_run(bench_kernel_t kernel, bool scalar, size_t dst_off)
+{
+    uint16_t *dst = &bench_dst[dst_off];
+    const int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        switch (kernel) {
+        case BENCH_FILL:
+            (scalar ? bsp_rgb565_fill_scalar : bsp_rgb565_fill)(dst, 0xF800 + i, BENCH_PX);
+            break;
+        case BENCH_COPY:
+            (scalar ? bsp_rgb565_copy_scalar : bsp_rgb565_copy)(dst, bench_src, BENCH_PX);
+            break;
+        case BENCH_SWAP:
+            (scalar ? bsp_rgb565_swap_scalar : bsp_rgb565_swap)(dst, bench_src, BENCH_PX);
+            break;
+        }
+    }
+    const int64_t time_us = esp_timer_get_time() - start;
+    return (time_us > 0) ? (float)BENCH_PX * sizeof(uint16_t) * BENCH_ROUNDS / time_us : 0.0f;
+}
+
+TEST_CASE("rgb565 kernels benchmark", "[rgb565][benchmark]")
+{
+    static const char *const names[] = { "fill", "copy", "swap" };
+
+    test_fill_pattern(bench_src, BENCH_PX, 3);
+    printf("rgb565 %d px x %d, MB/s   fast  scalar\n", BENCH_PX, BENCH_ROUNDS);
+    for (int kernel = BENCH_FILL; kernel <= BENCH_SWAP; kernel++) {
+        for (size_t dst_off = 0; dst_off <= 1; dst_off++) {
+            const float fast = bench_run(kernel, false, dst_off);
+            const float scalar = bench_run(kernel, true, dst_off);
+            printf("rgb565 %s dst +%u     %7.1f %7.1f\n", names[kernel], (unsigned)(dst_off * 2), fast, scalar);
+        }
+    }
+}
@@ -0,0 +1,200 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Touch ring buffer, one euro filter and prediction fed with a touch trace
+ *
+ * The trace goes through the same steps as in the touch sampler: samples are pushed into the ring,
+ * popped in batches, filtered, and the position is predicted to the time the frame is shown.
+ * The filter parameters are the Kconfig defaults.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unity.h"
+#include "bsp/touch_filter.h"
+
+#define TEST_MIN_CUTOFF_HZ  (1.0f)
+#define TEST_BETA           (0.05f)
+#define TEST_D_CUTOFF_HZ    (5.0f)
+#define TEST_PREDICT_US     (12000)
+#define TEST_PREDICT_MAX_US (50000)
+#define TEST_BATCH          (4)     /* Samples per LVGL read, 8 ms sample period and 30 ms read period */
+
+#define TEST_MIN(a, b)      ((a) < (b) ? (a) : (b))
+#define TEST_MAX(a, b)      ((a) > (b) ? (a) : (b))
+
+/*
+ * Synthesized trace at the 8 ms sample period of the sampler, with +-300 us timing jitter:
+ * a finger resting at (40, 120) with +-3 px of panel noise, a swipe to the right at 1000 px/s
+ * with +-1 px of noise, and a rest at (280, 120).
+ * Time in us, x and y in display pixels.
+ */
+static const int32_t trace[][3] = {
+    {      0,  39, 118 }, {   8104,  42, 117 }, {  15878,  43, 121 }, {  23674,  39, 121 },
+    {  31433,  41, 118 }, {  39171,  37, 120 }, {  47299,  37, 118 }, {  55091,  41, 120 },
+    {  62851,  43, 121 }, {  70677,  38, 122 }, {  78973,  37, 121 }, {  87272,  40, 117 },
+    {  95198,  37, 121 }, { 103034,  39, 120 }, { 110881,  41, 117 }, { 119165,  39, 121 },
+    { 127050,  37, 121 }, { 135334,  42, 118 }, { 143415,  37, 121 }, { 151179,  41, 117 },
+    { 159089,  40, 122 }, { 167333,  40, 123 }, { 175354,  40, 121 }, { 183518,  39, 119 },
+    { 191472,  43, 118 }, { 199421,  37, 121 }, { 207428,  41, 120 }, { 215479,  42, 120 },
+    { 223473,  41, 117 }, { 231293,  41, 120 }, { 239161,  43, 119 }, { 247016,  40, 120 },
+    { 254756,  42, 117 }, { 263027,  41, 123 }, { 271048,  39, 122 }, { 279106,  41, 120 },
+    { 287399,  43, 120 }, { 295169,  43, 117 }, { 303145,  40, 122 }, { 310911,  37, 122 },
+    { 318928,  49, 121 }, { 327084,  56, 121 }, { 335179,  65, 120 }, { 342902,  72, 120 },
+    { 350774,  81, 119 }, { 358979,  87, 119 }, { 366973,  95, 121 }, { 374926, 104, 120 },
+    { 383134, 111, 119 }, { 391293, 120, 121 }, { 399277, 127, 120 }, { 407540, 136, 121 },
+    { 415665, 144, 121 }, { 423754, 151, 119 }, { 431538, 159, 119 }, { 439475, 169, 119 },
+    { 447187, 176, 121 }, { 455073, 184, 120 }, { 462777, 191, 120 }, { 471024, 200, 121 },
+    { 479303, 208, 119 }, { 487530, 217, 121 }, { 495285, 224, 121 }, { 503557, 232, 120 },
+    { 511665, 240, 119 }, { 519858, 249, 120 }, { 527621, 255, 119 }, { 535534, 264, 119 },
+    { 543346, 272, 121 }, { 551099, 279, 119 }, { 559379, 278, 121 }, { 567182, 279, 121 },
+    { 574908, 277, 123 }, { 582820, 281, 120 }, { 590672, 282, 119 }, { 598727, 281, 119 },
+    { 606912, 277, 117 }, { 615111, 280, 120 }, { 623306, 279, 117 }, { 631153, 277, 122 },
+    { 639203, 282, 119 }, { 647393, 283, 122 }, { 655258, 281, 117 }, { 663168, 281, 119 },
+    { 671018, 282, 121 }, { 678745, 283, 121 }, { 686750, 282, 123 }, { 694543, 282, 123 },
+    { 702510, 281, 119 }, { 710381, 279, 123 },
+};
+
+#define TRACE_LEN           (sizeof(trace) / sizeof(trace[0]))
+#define TRACE_SWIPE_START   (40)
+#define TRACE_SWIPE_END     (70)
+#define TRACE_SPEED         (1000)  /* px/s of the swipe */
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t predict_x;
+    int16_t predict_y;
+} test_point_t;
+
+static test_point_t filtered[TRACE_LEN];
+
+static void test_sample(size_t i, bsp_touch_sample_t *sample)
+{
+    *sample = (bsp_touch_sample_t) {
+        .time_us = trace[i][0],
+        .x = trace[i][1],
+        .y = trace[i][2],
+        .pressed = true,
+        .count = 1,
+        .points[0] = { .x = trace[i][1], .y = trace[i][2] },
+    };
+}
+
+/* Whole trace through ring, filter and prediction, the result of every sample in filtered[] */
+static void test_run_trace(void)
+{
+    const bsp_touch_filter_cfg_t cfg = {
+        .min_cutoff_hz = TEST_MIN_CUTOFF_HZ,
+        .beta = TEST_BETA,
+        .d_cutoff_hz = TEST_D_CUTOFF_HZ,
+    };
+    static bsp_touch_ring_t ring;
+    bsp_touch_filter_t filter;
+    bsp_touch_sample_t sample;
+    size_t pushed = 0;
+    size_t popped = 0;
+
+    bsp_touch_ring_init(&ring);
+    bsp_touch_filter_init(&filter, &cfg);
+    while (popped < TRACE_LEN) {
+        for (int i = 0; i < TEST_BATCH && pushed < TRACE_LEN; i++) {
+            test_sample(pushed++, &sample);
+            TEST_ASSERT_TRUE(bsp_touch_ring_push(&ring, &sample));
+        }
+        while (bsp_touch_ring_pop(&ring, &sample)) {
+            TEST_ASSERT_EQUAL_INT32(trace[popped][0], (int32_t)sample.time_us);
+            bsp_touch_filter_update(&filter, &sample);
+            test_point_t *p = &filtered[popped++];
+            p->x = (int16_t)lroundf(filter.x);
+            p->y = (int16_t)lroundf(filter.y);
+            TEST_ASSERT_TRUE(bsp_touch_filter_predict(&filter, sample.time_us + TEST_PREDICT_US, TEST_PREDICT_MAX_US,
+                                                      &p->predict_x, &p->predict_y));
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, ring.dropped);
+}
+
+TEST_CASE("touch filter suppresses jitter of a resting finger", "[touch_filter]")
+{
+    int raw_min = INT16_MAX, raw_max = INT16_MIN;
+    int min = INT16_MAX, max = INT16_MIN;
+    int predict_min = INT16_MAX, predict_max = INT16_MIN;
+
+    test_run_trace();
+    /* First samples let the filter settle */
+    for (size_t i = 10; i < TRACE_SWIPE_START; i++) {
+        raw_min = TEST_MIN(raw_min, trace[i][1]);
+        raw_max = TEST_MAX(raw_max, trace[i][1]);
+        min = TEST_MIN(min, filtered[i].x);
+        max = TEST_MAX(max, filtered[i].x);
+        predict_min = TEST_MIN(predict_min, filtered[i].predict_x);
+        predict_max = TEST_MAX(predict_max, filtered[i].predict_x);
+        TEST_ASSERT_INT_WITHIN(1, 120, filtered[i].y);
+    }
+    printf("touch filter at rest: raw x %d..%d, filtered %d..%d, predicted %d..%d\n",
+           raw_min, raw_max, min, max, predict_min, predict_max);
+    TEST_ASSERT_GREATER_OR_EQUAL(5, raw_max - raw_min);
+    /* Noise of the speed estimate moves the prediction a little more than the filtered position */
+    TEST_ASSERT_LESS_OR_EQUAL((raw_max - raw_min) / 2, max - min);
+    TEST_ASSERT_LESS_THAN(raw_max - raw_min, predict_max - predict_min);
+}
+
+TEST_CASE("touch filter follows a swipe with little lag", "[touch_filter]")
+{
+    int max_lag = 0, max_error = 0, max_error_filtered = 0;
+
+    test_run_trace();
+    /* Filter needs a few samples to pick up the speed */
+    for (size_t i = TRACE_SWIPE_START + 6; i < TRACE_SWIPE_END - 1; i++) {
+        /* Finger position without the panel noise, now and when the frame is shown */
+        const int x = 40 + (int)(i - TRACE_SWIPE_START + 1) * TRACE_SPEED * 8 / 1000;
+        const int shown_x = x + TRACE_SPEED * TEST_PREDICT_US / 1000000;
+        max_lag = TEST_MAX(max_lag, x - filtered[i].x);
+        max_error = TEST_MAX(max_error, abs(shown_x - filtered[i].predict_x));
+        max_error_filtered = TEST_MAX(max_error_filtered, abs(shown_x - filtered[i].x));
+        TEST_ASSERT_INT_WITHIN(2, 120, filtered[i].y);
+    }
+    printf("touch filter at %d px/s: filtered lag up to %d px, error at display time %d px, %d px without prediction\n",
+           TRACE_SPEED, max_lag, max_error, max_error_filtered);
+    /* Less than the distance of one sample period */
+    TEST_ASSERT_LESS_THAN(TRACE_SPEED * 8 / 1000, max_lag);
+    TEST_ASSERT_LESS_OR_EQUAL(max_error_filtered / 2, max_error);
+    /* Settles at the end of the swipe */
+    TEST_ASSERT_INT_WITHIN(3, 280, filtered[TRACE_LEN - 1].x);
+    TEST_ASSERT_INT_WITHIN(3, 280, filtered[TRACE_LEN - 1].predict_x);
+}
+
+TEST_CASE("touch ring drops the newest samples when full", "[touch_filter]")
+{
+    static bsp_touch_ring_t ring;
+    bsp_touch_sample_t sample;
+    const size_t extra = 5;
+
+    bsp_touch_ring_init(&ring);
+    for (size_t i = 0; i < BSP_TOUCH_RING_SIZE + extra; i++) {
+        test_sample(i, &sample);
+        TEST_ASSERT_EQUAL(i < BSP_TOUCH_RING_SIZE, bsp_touch_ring_push(&ring, &sample));
+    }
+    TEST_ASSERT_EQUAL_UINT32(extra, ring.dropped);
+
+    /* Oldest samples are kept in order, the ones pushed into the full ring are gone */
+    for (size_t i = 0; i < BSP_TOUCH_RING_SIZE; i++) {
+        TEST_ASSERT_TRUE(bsp_touch_ring_pop(&ring, &sample));
+        TEST_ASSERT_EQUAL_INT32(trace[i][0], (int32_t)sample.time_us);
+        TEST_ASSERT_EQUAL_INT16(trace[i][1], sample.x);
+    }
+    TEST_ASSERT_FALSE(bsp_touch_ring_pop(&ring, &sample));
+
+    /* Room again after popping, indices keep counting across the wrap */
+    test_sample(TRACE_LEN - 1, &sample);
+    TEST_ASSERT_TRUE(bsp_touch_ring_push(&ring, &sample));
+    TEST_ASSERT_TRUE(bsp_touch_ring_pop(&ring, &sample));
+    TEST_ASSERT_EQUAL_INT32(trace[TRACE_LEN - 1][0], (int32_t)sample.time_us);
+    TEST_ASSERT_EQUAL_UINT32(extra, ring.dropped);
+}
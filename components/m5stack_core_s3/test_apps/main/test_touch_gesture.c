@@ -0,0 +1,283 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Touch gesture recognition fed with synthetic samples
+ *
+ * Samples come every 8 ms like from the touch sampler, the thresholds are the defaults.
+ * Two finger gestures are built around a center point, so the scale and the angle are known
+ * up to the rounding of the coordinates to whole pixels.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "unity.h"
+#include "bsp/touch_gesture.h"
+
+#define TEST_PERIOD_US      (8000)
+#define TEST_MAX_GESTURES   (128)
+#define TEST_CX             (160)
+#define TEST_CY             (120)
+
+typedef struct {
+    bsp_touch_gesture_t gestures[TEST_MAX_GESTURES];
+    int count;
+} test_log_t;
+
+static test_log_t gesture_log;
+static bsp_touch_gesture_engine_t engine;
+static int64_t now_us;
+
+static void test_gesture_cb(const bsp_touch_gesture_t *gesture, void *user_ctx)
+{
+    test_log_t *log = user_ctx;
+    TEST_ASSERT_LESS_THAN(TEST_MAX_GESTURES, log->count);
+    log->gestures[log->count++] = *gesture;
+}
+
+static void test_reset(void)
+{
+    const bsp_touch_gesture_cfg_t cfg = BSP_TOUCH_GESTURE_DEFAULT_CONFIG();
+    memset(&gesture_log, 0, sizeof(gesture_log));
+    bsp_touch_gesture_init(&engine, &cfg, test_gesture_cb, &gesture_log);
+    now_us = 0;
+}
+
+static void test_feed(const bsp_touch_sample_t *sample)
+{
+    bsp_touch_gesture_update(&engine, sample);
+    now_us += TEST_PERIOD_US;
+}
+
+static void test_one(int16_t x, int16_t y)
+{
+    const bsp_touch_sample_t sample = {
+        .time_us = now_us, .x = x, .y = y, .pressed = true, .count = 1,
+        .points = { { .x = x, .y = y, .id = 0 } },
+    };
+    test_feed(&sample);
+}
+
+static void test_two(uint8_t id_a, int16_t xa, int16_t ya, uint8_t id_b, int16_t xb, int16_t yb)
+{
+    const bsp_touch_sample_t sample = {
+        .time_us = now_us, .x = xa, .y = ya, .pressed = true, .count = 2,
+        .points = { { .x = xa, .y = ya, .id = id_a }, { .x = xb, .y = yb, .id = id_b } },
+    };
+    test_feed(&sample);
+}
+
+/* Fingers symmetric around the center, at the given distance and angle in degrees */
+static void test_two_polar(uint8_t id_a, uint8_t id_b, float dist, float angle_deg)
+{
+    const float rad = angle_deg * (float)M_PI / 180.0f;
+    const int16_t dx = (int16_t)lroundf(dist / 2 * cosf(rad));
+    const int16_t dy = (int16_t)lroundf(dist / 2 * sinf(rad));
+    test_two(id_a, TEST_CX - dx, TEST_CY - dy, id_b, TEST_CX + dx, TEST_CY + dy);
+}
+
+static void test_release(void)
+{
+    const bsp_touch_sample_t sample = { .time_us = now_us };
+    test_feed(&sample);
+}
+
+static int test_count(bsp_touch_gesture_type_t type, bsp_touch_gesture_phase_t phase)
+{
+    int count = 0;
+    for (int i = 0; i < gesture_log.count; i++) {
+        count += (gesture_log.gestures[i].type == type && gesture_log.gestures[i].phase == phase);
+    }
+    return count;
+}
+
+static const bsp_touch_gesture_t *test_last(bsp_touch_gesture_type_t type)
+{
+    for (int i = gesture_log.count - 1; i >= 0; i--) {
+        if (gesture_log.gestures[i].type == type) {
+            return &gesture_log.gestures[i];
+        }
+    }
+    TEST_FAIL_MESSAGE("Gesture not reported");
+    return NULL;
+}
+
+TEST_CASE("short press within the slop area is a tap", "[touch_gesture]")
+{
+    test_reset();
+    test_one(100, 100);
+    for (int i = 0; i < 10; i++) {
+        test_one(100 + (i & 3), 100 - (i & 1) * 2);
+    }
+    test_release();
+
+    TEST_ASSERT_EQUAL(1, gesture_log.count);
+    const bsp_touch_gesture_t *tap = &gesture_log.gestures[0];
+    TEST_ASSERT_EQUAL(BSP_TOUCH_GESTURE_TAP, tap->type);
+    TEST_ASSERT_EQUAL(BSP_TOUCH_GESTURE_END, tap->phase);
+    TEST_ASSERT_EQUAL(100, tap->start_x);
+    TEST_ASSERT_EQUAL(100, tap->start_y);
+    TEST_ASSERT_EQUAL_INT32(11 * TEST_PERIOD_US, (int32_t)tap->time_us);
+}
+
+TEST_CASE("held press is one long press and no tap", "[touch_gesture]")
+{
+    const bsp_touch_gesture_cfg_t cfg = BSP_TOUCH_GESTURE_DEFAULT_CONFIG();
+
+    test_reset();
+    while (now_us < 700 * 1000) {
+        test_one(200 + (now_us / TEST_PERIOD_US) % 3, 50);
+    }
+    test_release();
+
+    TEST_ASSERT_EQUAL(1, gesture_log.count);
+    const bsp_touch_gesture_t *press = &gesture_log.gestures[0];
+    TEST_ASSERT_EQUAL(BSP_TOUCH_GESTURE_LONG_PRESS, press->type);
+    /* Reported by the first sample past the long press time */
+    TEST_ASSERT_GREATER_OR_EQUAL(cfg.long_press_ms * 1000, (int32_t)press->time_us);
+    TEST_ASSERT_LESS_THAN(cfg.long_press_ms * 1000 + TEST_PERIOD_US, (int32_t)press->time_us);
+
+    /* Moving out of the slop area before the long press time cancels it */
+    test_reset();
+    for (int i = 0; i < 80; i++) {
+        test_one(200 + i * 2, 50);
+    }
+    test_release();
+    TEST_ASSERT_EQUAL(0, test_count(BSP_TOUCH_GESTURE_LONG_PRESS, BSP_TOUCH_GESTURE_END));
+    TEST_ASSERT_EQUAL(0, test_count(BSP_TOUCH_GESTURE_TAP, BSP_TOUCH_GESTURE_END));
+}
+
+TEST_CASE("fast release is a swipe in the direction of the movement", "[touch_gesture]")
+{
+    static const struct {
+        int dx;
+        int dy;
+        bsp_touch_dir_t dir;
+    } moves[] = {
+        { -16, 0, BSP_TOUCH_DIR_LEFT },
+        { 16, 3, BSP_TOUCH_DIR_RIGHT },
+        { 2, -16, BSP_TOUCH_DIR_UP },
+        { -5, 16, BSP_TOUCH_DIR_DOWN },
+    };
+
+    for (size_t m = 0; m < sizeof(moves) / sizeof(moves[0]); m++) {
+        test_reset();
+        /* 2000 px/s along the main axis */
+        for (int i = 0; i <= 12; i++) {
+            test_one(TEST_CX + moves[m].dx * i, TEST_CY + moves[m].dy * i);
+        }
+        test_release();
+
+        TEST_ASSERT_EQUAL(1, gesture_log.count);
+        const bsp_touch_gesture_t *swipe = &gesture_log.gestures[0];
+        TEST_ASSERT_EQUAL(BSP_TOUCH_GESTURE_SWIPE, swipe->type);
+        TEST_ASSERT_EQUAL(moves[m].dir, swipe->dir);
+        TEST_ASSERT_EQUAL(TEST_CX, swipe->start_x);
+        TEST_ASSERT_EQUAL(TEST_CX + moves[m].dx * 12, swipe->x);
+        TEST_ASSERT_TRUE(hypotf(swipe->vx, swipe->vy) > 1500.0f);
+    }
+
+    /* Same distance at 100 px/s is a drag, nothing is reported */
+    test_reset();
+    for (int i = 0; i <= 240; i++) {
+        test_one(TEST_CX + i * 8 / 10, TEST_CY);
+    }
+    test_release();
+    TEST_ASSERT_EQUAL(0, gesture_log.count);
+}
+
+TEST_CASE("spreading two fingers is a pinch with the distance ratio as scale", "[touch_gesture]")
+{
+    test_reset();
+    for (int i = 0; i <= 10; i++) {
+        test_two_polar(0, 1, 100 + i * 10, 0);
+    }
+    test_release();
+
+    TEST_ASSERT_EQUAL(1, test_count(BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_BEGIN));
+    TEST_ASSERT_EQUAL(9, test_count(BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_UPDATE));
+    TEST_ASSERT_EQUAL(1, test_count(BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_END));
+    TEST_ASSERT_EQUAL(BSP_TOUCH_GESTURE_PINCH, gesture_log.gestures[0].type);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.1f, gesture_log.gestures[0].scale);
+
+    const bsp_touch_gesture_t *end = test_last(BSP_TOUCH_GESTURE_PINCH);
+    TEST_ASSERT_EQUAL(BSP_TOUCH_GESTURE_END, end->phase);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.0f, end->scale);
+    TEST_ASSERT_TRUE(end->scale_speed > 0.0f);
+    TEST_ASSERT_EQUAL(TEST_CX, end->x);
+    TEST_ASSERT_EQUAL(TEST_CY, end->y);
+
+    /* Fingers stay horizontal, a two finger press gives no one finger gestures */
+    TEST_ASSERT_EQUAL(0, test_count(BSP_TOUCH_GESTURE_ROTATE, BSP_TOUCH_GESTURE_BEGIN));
+    TEST_ASSERT_EQUAL(0, test_count(BSP_TOUCH_GESTURE_TAP, BSP_TOUCH_GESTURE_END));
+    TEST_ASSERT_EQUAL(0, test_count(BSP_TOUCH_GESTURE_SWIPE, BSP_TOUCH_GESTURE_END));
+}
+
+TEST_CASE("rotation accumulates across the wrap of the angle at 180 degrees", "[touch_gesture]")
+{
+    static const float spans[][2] = {
+        { 150.0f, 210.0f },     /* atan2 wraps from +pi to -pi, clockwise on the screen */
+        { -150.0f, -210.0f },   /* and from -pi to +pi, counterclockwise */
+    };
+
+    for (int s = 0; s < 2; s++) {
+        const float step = (spans[s][1] > spans[s][0]) ? 5.0f : -5.0f;
+        test_reset();
+        for (float angle = spans[s][0]; fabsf(angle - spans[s][0]) <= 60.0f; angle += step) {
+            test_two_polar(3, 7, 100, angle);
+        }
+        test_release();
+
+        TEST_ASSERT_EQUAL(1, test_count(BSP_TOUCH_GESTURE_ROTATE, BSP_TOUCH_GESTURE_BEGIN));
+        TEST_ASSERT_EQUAL(1, test_count(BSP_TOUCH_GESTURE_ROTATE, BSP_TOUCH_GESTURE_END));
+        /* No jump by a whole turn at the wrap */
+        for (int i = 0; i < gesture_log.count; i++) {
+            TEST_ASSERT_TRUE(fabsf(gesture_log.gestures[i].angle) <= 61.0f);
+        }
+        const bsp_touch_gesture_t *end = test_last(BSP_TOUCH_GESTURE_ROTATE);
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, 60.0f * step / 5.0f, end->angle);
+        TEST_ASSERT_EQUAL_FLOAT(1.0f, end->scale);
+        /* Distance does not change beyond the rounding, it is not a pinch */
+        TEST_ASSERT_EQUAL(0, test_count(BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_BEGIN));
+    }
+}
+
+TEST_CASE("fingers are tracked by their touch IDs", "[touch_gesture]")
+{
+    test_reset();
+    test_two_polar(0, 1, 100, 0);
+    /* Points reported in the other order are the same fingers, the angle does not flip */
+    test_two(1, TEST_CX + 50, TEST_CY, 0, TEST_CX - 50, TEST_CY);
+    TEST_ASSERT_EQUAL(0, gesture_log.count);
+
+    for (int i = 1; i <= 5; i++) {
+        test_two_polar(0, 1, 100 + i * 10, 0);
+    }
+    TEST_ASSERT_EQUAL(1, test_count(BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_BEGIN));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.5f, test_last(BSP_TOUCH_GESTURE_PINCH)->scale);
+
+    /* Finger 1 lifted and finger 2 put down in the same sample ends the pinch */
+    test_two_polar(0, 2, 150, 0);
+    TEST_ASSERT_EQUAL(1, test_count(BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_END));
+    const int ended = gesture_log.count;
+
+    /* New pair starts from its own distance, holding still reports nothing */
+    for (int i = 0; i < 5; i++) {
+        test_two_polar(0, 2, 150, 0);
+    }
+    TEST_ASSERT_EQUAL(ended, gesture_log.count);
+
+    /* Pinching the new pair starts a new gesture with the scale relative to 150 px */
+    for (int i = 1; i <= 5; i++) {
+        test_two_polar(0, 2, 150 - i * 10, 0);
+    }
+    TEST_ASSERT_EQUAL(2, test_count(BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_BEGIN));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 100.0f / 150.0f, test_last(BSP_TOUCH_GESTURE_PINCH)->scale);
+    TEST_ASSERT_TRUE(test_last(BSP_TOUCH_GESTURE_PINCH)->scale_speed < 0.0f);
+    test_release();
+    TEST_ASSERT_EQUAL(2, test_count(BSP_TOUCH_GESTURE_PINCH, BSP_TOUCH_GESTURE_END));
+    TEST_ASSERT_EQUAL(0, test_count(BSP_TOUCH_GESTURE_ROTATE, BSP_TOUCH_GESTURE_BEGIN));
+}
@@ -0,0 +1,143 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Touch recording codec
+ *
+ * touch_swipe.btr is a short trace in the recording format: a tap, a slider drag and a swipe up
+ * with a throw. Decoding and encoding it again must give the same bytes. Single samples cover
+ * the varint and zigzag limits, damaged recordings must be rejected.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "bsp/touch_record.h"
+
+#define TEST_MAX_SAMPLES    (128)
+
+extern const uint8_t touch_swipe_start[] asm("_binary_touch_swipe_btr_start");
+extern const uint8_t touch_swipe_end[] asm("_binary_touch_swipe_btr_end");
+
+static bsp_touch_sample_t samples[TEST_MAX_SAMPLES];
+static uint8_t encoded[BSP_TOUCH_RECORD_HEADER_SIZE + TEST_MAX_SAMPLES * BSP_TOUCH_RECORD_SAMPLE_MAX];
+
+/* Encode samples into a recording, returns its length */
+static size_t test_encode(const bsp_touch_sample_t *in, size_t count)
+{
+    size_t len = bsp_touch_record_header(encoded);
+    for (size_t i = 0; i < count; i++) {
+        const size_t sample_len = bsp_touch_record_encode(i > 0 ? &in[i - 1] : NULL, &in[i], &encoded[len]);
+        TEST_ASSERT_LESS_OR_EQUAL(BSP_TOUCH_RECORD_SAMPLE_MAX, sample_len);
+        len += sample_len;
+    }
+    return len;
+}
+
+TEST_CASE("touch recording decodes and encodes to the same bytes", "[touch_record]")
+{
+    const size_t len = touch_swipe_end - touch_swipe_start;
+    size_t count = 0;
+    size_t presses = 0;
+
+    /* Counting only */
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_touch_record_decode(touch_swipe_start, len, NULL, &count));
+    TEST_ASSERT_GREATER_THAN(0, count);
+    TEST_ASSERT_LESS_OR_EQUAL(TEST_MAX_SAMPLES, count);
+
+    const size_t total = count;
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_touch_record_decode(touch_swipe_start, len, samples, &count));
+    TEST_ASSERT_EQUAL(total, count);
+    TEST_ASSERT_EQUAL_INT32(0, (int32_t)samples[0].time_us);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(samples[i].pressed ? 1 : 0, samples[i].count);
+        TEST_ASSERT_EQUAL_INT16(samples[i].x, samples[i].points[0].x);
+        TEST_ASSERT_EQUAL_INT16(samples[i].y, samples[i].points[0].y);
+        TEST_ASSERT_INT_WITHIN(BSP_LCD_H_RES / 2, BSP_LCD_H_RES / 2, samples[i].x);
+        TEST_ASSERT_INT_WITHIN(BSP_LCD_V_RES / 2, BSP_LCD_V_RES / 2, samples[i].y);
+        if (i > 0) {
+            TEST_ASSERT_TRUE(samples[i].time_us > samples[i - 1].time_us);
+            presses += (samples[i].pressed && !samples[i - 1].pressed);
+        }
+    }
+    /* Tap, drag and swipe, each ending with a release, the tap starts the recording */
+    TEST_ASSERT_EQUAL(2, presses);
+    TEST_ASSERT_FALSE(samples[count - 1].pressed);
+
+    TEST_ASSERT_EQUAL(len, test_encode(samples, count));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(touch_swipe_start, encoded, len);
+}
+
+TEST_CASE("touch recording round trips extreme samples", "[touch_record]")
+{
+    static const bsp_touch_sample_t in[] = {
+        { .time_us = 0, .x = 0, .y = 0, .pressed = true },
+        /* Same time and position, only the flags are encoded */
+        { .time_us = 0, .x = 0, .y = 0, .pressed = true },
+        { .time_us = 100, .x = -1, .y = 1, .pressed = true },
+        /* Whole int16_t range in one step, deltas need 17 bits */
+        { .time_us = 200, .x = INT16_MIN, .y = INT16_MAX, .pressed = true },
+        { .time_us = 300, .x = INT16_MAX, .y = INT16_MIN, .pressed = true },
+        { .time_us = 12800, .x = 63, .y = -64, .pressed = false },
+        { .time_us = 12900, .x = 64, .y = -65, .pressed = true },
+        /* Two days without touches, the time delta needs more than 32 bits with the flags */
+        { .time_us = 12900 + 172800000000LL, .x = 64, .y = -65, .pressed = false },
+        { .time_us = 13000 + 172800000000LL, .x = 0, .y = 0, .pressed = true },
+    };
+    const size_t total = sizeof(in) / sizeof(in[0]);
+    size_t count = TEST_MAX_SAMPLES;
+
+    const size_t len = test_encode(in, total);
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_touch_record_decode(encoded, len, samples, &count));
+    TEST_ASSERT_EQUAL(total, count);
+    for (size_t i = 0; i < total; i++) {
+        TEST_ASSERT_TRUE(in[i].time_us == samples[i].time_us);
+        TEST_ASSERT_EQUAL_INT16(in[i].x, samples[i].x);
+        TEST_ASSERT_EQUAL_INT16(in[i].y, samples[i].y);
+        TEST_ASSERT_EQUAL(in[i].pressed, samples[i].pressed);
+    }
+
+    /* Times are kept in 100 us units relative to the first sample */
+    const bsp_touch_sample_t late[] = {
+        { .time_us = 1000050, .x = 10, .y = 10, .pressed = true },
+        { .time_us = 1000199, .x = 10, .y = 10, .pressed = false },
+    };
+    count = TEST_MAX_SAMPLES;
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_touch_record_decode(encoded, test_encode(late, 2), samples, &count));
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL_INT32(0, (int32_t)samples[0].time_us);
+    TEST_ASSERT_EQUAL_INT32(100, (int32_t)samples[1].time_us);
+}
+
+TEST_CASE("touch recording rejects damaged data", "[touch_record]")
+{
+    const size_t len = touch_swipe_end - touch_swipe_start;
+    size_t count;
+
+    memcpy(encoded, touch_swipe_start, len);
+
+    /* Header only is an empty recording */
+    count = TEST_MAX_SAMPLES;
+    TEST_ASSERT_EQUAL(ESP_OK, bsp_touch_record_decode(encoded, BSP_TOUCH_RECORD_HEADER_SIZE, samples, &count));
+    TEST_ASSERT_EQUAL(0, count);
+
+    /* Last byte of a varint missing */
+    count = TEST_MAX_SAMPLES;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, bsp_touch_record_decode(encoded, BSP_TOUCH_RECORD_HEADER_SIZE + 2, samples, &count));
+
+    /* Too little room for the samples */
+    count = 4;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, bsp_touch_record_decode(encoded, len, samples, &count));
+
+    count = TEST_MAX_SAMPLES;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, bsp_touch_record_decode(encoded, BSP_TOUCH_RECORD_HEADER_SIZE - 1, samples, &count));
+    encoded[3]++;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, bsp_touch_record_decode(encoded, len, samples, &count));
+    encoded[3]--;
+    encoded[0] = 'X';
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, bsp_touch_record_decode(encoded, len, samples, &count));
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, bsp_touch_record_decode(NULL, len, samples, &count));
+}
@@ -5,21 +5,365 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
 #include "bsp/esp-bsp.h"
+#include "bsp/touch_record.h"
 #include "lvgl.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#if CONFIG_EXAMPLE_IMG_RLE
+#include "img_rle.h"
+#endif
+
+static const char *TAG = "example";
 
 extern void example_lvgl_demo_ui(lv_obj_t *scr);
 
+#if CONFIG_BSP_DISPLAY_LAYER_CACHE
+/* After the intro animation, which redraws the cached logo under the arcs */
+#define EXAMPLE_LAYER_STATS_DELAY_MS    (2000)
+
+static void example_layer_stats_cb(lv_timer_t *timer)
+{
+    bsp_display_layer_stats_t stats;
+    if (bsp_display_get_layer_stats(&stats) == ESP_OK) {
+        ESP_LOGI(TAG, "Layer cache: %"PRIu32" of %"PRIu32" layers opaque, %"PRIu32" blits, %"PRIu32" blends, %"PRIu32" snapshots",
+                 stats.opaque_layers, stats.layers, stats.blits, stats.blends, stats.misses);
+    }
+}
+#endif
+
+#if CONFIG_EXAMPLE_ROTATION_BENCHMARK
+static void example_rotation_benchmark(lv_disp_t *disp)
+{
+    static const char *names[] = {"0", "90", "180", "270"};
+
+    for (int rot = LV_DISP_ROT_NONE; rot <= LV_DISP_ROT_270; rot++) {
+        bsp_display_lock(0);
+        bsp_display_rotate(disp, rot);
+        bsp_display_unlock();
+        /* Let the first full screen redraw after rotation pass */
+        vTaskDelay(pdMS_TO_TICKS(500));
+
+        bsp_display_reset_flush_stats();
+        const int64_t start = esp_timer_get_time();
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_EXAMPLE_ROTATION_BENCHMARK_TIME_MS));
+        const int64_t elapsed = esp_timer_get_time() - start;
+
+        bsp_display_flush_stats_t stats;
+        ESP_ERROR_CHECK(bsp_display_get_flush_stats(&stats));
+        ESP_LOGI(TAG, "Rotation %3s: %.1f fps, %"PRIu32" flushes, SPI busy %.0f %%", names[rot],
+                 stats.frames * 1000000.0f / elapsed, stats.flushes, stats.dma_busy_us * 100.0f / elapsed);
+    }
+
+    bsp_display_lock(0);
+    bsp_display_rotate(disp, LV_DISP_ROT_NONE);
+    bsp_display_unlock();
+}
+#endif
+
+#if CONFIG_EXAMPLE_PARALLEL_BENCHMARK
+#define EXAMPLE_PARALLEL_FRAMES (50)
+
+/* Median render time of full screen redraws */
+static uint32_t example_parallel_measure(bool parallel)
+{
+    bsp_display_lock(0);
+    ESP_ERROR_CHECK(bsp_display_set_parallel_render(parallel));
+    bsp_display_unlock();
+
+    bsp_display_reset_latency();
+    for (int frame = 0; frame < EXAMPLE_PARALLEL_FRAMES; frame++) {
+        bsp_display_lock(0);
+        lv_obj_invalidate(lv_scr_act());
+        lv_refr_now(NULL);
+        bsp_display_unlock();
+    }
+
+    bsp_display_latency_t lat;
+    ESP_ERROR_CHECK(bsp_display_get_latency(BSP_DISPLAY_LATENCY_RENDER, &lat));
+    return lat.p50_us;
+}
+
+static void example_parallel_report(const char *scene)
+{
+    const uint32_t one_core = example_parallel_measure(false);
+    const uint32_t two_cores = example_parallel_measure(true);
+    ESP_LOGI(TAG, "%-8s: render p50 %"PRIu32" us on one core, %"PRIu32" us on two cores, speedup %.2f",
+             scene, one_core, two_cores, (float)one_core / LV_MAX(two_cores, 1));
+}
+
+static void example_parallel_benchmark(void)
+{
+    example_parallel_report("demo");
+
+    /* Full screen gradient under a translucent full screen layer */
+    bsp_display_lock(0);
+    lv_obj_t *prev_scr = lv_scr_act();
+    lv_obj_t *scr = lv_obj_create(NULL);
+    lv_obj_set_style_bg_color(scr, lv_palette_main(LV_PALETTE_BLUE), 0);
+    lv_obj_set_style_bg_grad_color(scr, lv_palette_main(LV_PALETTE_RED), 0);
+    lv_obj_set_style_bg_grad_dir(scr, LV_GRAD_DIR_VER, 0);
+    lv_obj_t *layer = lv_obj_create(scr);
+    lv_obj_remove_style_all(layer);
+    lv_obj_set_size(layer, LV_PCT(100), LV_PCT(100));
+    lv_obj_set_style_bg_color(layer, lv_color_white(), 0);
+    lv_obj_set_style_bg_opa(layer, LV_OPA_50, 0);
+    lv_scr_load(scr);
+    bsp_display_unlock();
+
+    example_parallel_report("gradient");
+
+    bsp_display_lock(0);
+    lv_scr_load(prev_scr);
+    lv_obj_del(scr);
+    ESP_ERROR_CHECK(bsp_display_set_parallel_render(true));
+    bsp_display_unlock();
+}
+#endif
+
+#if CONFIG_EXAMPLE_BLEND_BENCHMARK
+#define EXAMPLE_BLEND_FRAMES    (200)
+
+static void example_blend_benchmark(void)
+{
+    LV_IMG_DECLARE(esp_logo_straight);
+    LV_IMG_DECLARE(esp_logo_premul);
+    LV_IMG_DECLARE(esp_logo_flat);
+    static const struct {
+        const char *name;
+        const lv_img_dsc_t *img;
+    } variants[] = {
+        {"straight", &esp_logo_straight},
+        {"premul", &esp_logo_premul},
+        {"flat", &esp_logo_flat},
+    };
+
+    bsp_display_lock(0);
+    lv_obj_t *prev_scr = lv_scr_act();
+    lv_obj_t *scr = lv_obj_create(NULL);
+    lv_obj_t *img = lv_img_create(scr);
+    lv_obj_center(img);
+    lv_scr_load(scr);
+    bsp_display_unlock();
+
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        bsp_display_lock(0);
+        lv_img_set_src(img, variants[i].img);
+        /* Decoded image cache is filled by the first frame */
+        lv_refr_now(NULL);
+        bsp_display_unlock();
+
+        bsp_display_reset_latency();
+        for (int frame = 0; frame < EXAMPLE_BLEND_FRAMES; frame++) {
+            bsp_display_lock(0);
+            lv_obj_invalidate(img);
+            lv_refr_now(NULL);
+            bsp_display_unlock();
+        }
+
+        bsp_display_latency_t lat;
+        ESP_ERROR_CHECK(bsp_display_get_latency(BSP_DISPLAY_LATENCY_RENDER, &lat));
+        ESP_LOGI(TAG, "Logo %-8s: render p50 %"PRIu32" us, p99 %"PRIu32" us, %"PRIu32" frames",
+                 variants[i].name, lat.p50_us, lat.p99_us, lat.count);
+    }
+
+    img_rle_stats_t stats;
+    bsp_display_lock(0);
+    img_rle_get_stats(&stats);
+    lv_scr_load(prev_scr);
+    lv_obj_del(scr);
+    bsp_display_unlock();
+    ESP_LOGI(TAG, "Direct draws %"PRIu32", decoder hits %"PRIu32", misses %"PRIu32,
+             stats.direct_draws, stats.hits, stats.misses);
+}
+#endif
+
+#if CONFIG_EXAMPLE_TOUCH_RECORD || CONFIG_EXAMPLE_TOUCH_REPLAY
+#define EXAMPLE_TRACE_PATH          BSP_SD_MOUNT_POINT "/" CONFIG_EXAMPLE_TOUCH_TRACE_FILE
+#endif
+#if CONFIG_EXAMPLE_TOUCH_RECORD
+/* Samples of up to 4 bytes every 2 ms, recording stops earlier when the buffer is full */
+#define EXAMPLE_TRACE_RECORD_BYTES  (CONFIG_EXAMPLE_TOUCH_RECORD_TIME_S * 2000 + BSP_TOUCH_RECORD_HEADER_SIZE)
+
+static void example_record_touch(void)
+{
+    ESP_ERROR_CHECK(bsp_sdcard_mount());
+    ESP_ERROR_CHECK(bsp_touch_record_start(EXAMPLE_TRACE_RECORD_BYTES));
+    ESP_LOGI(TAG, "Recording the touch for %d s", CONFIG_EXAMPLE_TOUCH_RECORD_TIME_S);
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_EXAMPLE_TOUCH_RECORD_TIME_S * 1000));
+    ESP_ERROR_CHECK(bsp_touch_record_save(EXAMPLE_TRACE_PATH));
+}
+#endif
+
+#if CONFIG_EXAMPLE_TOUCH_REPLAY || (CONFIG_IDF_TARGET_LINUX && CONFIG_BSP_TOUCH_RECORD)
+static void example_replay_touch(bsp_touch_sample_t *samples, size_t count)
+{
+    bsp_touch_replay_report_t report;
+    ESP_ERROR_CHECK(bsp_touch_replay(samples, count, &report));
+    free(samples);
+
+    ESP_LOGI(TAG, "Replayed %"PRIu32" samples of %"PRIu32" ms, at most %"PRIu32" us late",
+             report.samples, report.duration_ms, report.max_late_us);
+    ESP_LOGI(TAG, "Frames: %"PRIu32", p50 %"PRIu32" us, p95 %"PRIu32" us, p99 %"PRIu32" us, max %"PRIu32" us",
+             report.frame.count, report.frame.p50_us, report.frame.p95_us, report.frame.p99_us, report.frame.max_us);
+    ESP_LOGI(TAG, "Touch to frame: %"PRIu32" contacts shown, p50 %"PRIu32" us, p95 %"PRIu32" us, max %"PRIu32" us",
+             report.touch.count, report.touch.p50_us, report.touch.p95_us, report.touch.max_us);
+}
+#endif
+
+#if CONFIG_EXAMPLE_TOUCH_REPLAY
+static void example_replay_touch_file(void)
+{
+    bsp_touch_sample_t *samples;
+    size_t count;
+
+    ESP_ERROR_CHECK(bsp_sdcard_mount());
+    ESP_ERROR_CHECK(bsp_touch_record_load(EXAMPLE_TRACE_PATH, &samples, &count));
+    /* Demo widgets are created at the end of the intro animation */
+    vTaskDelay(pdMS_TO_TICKS(1500));
+    example_replay_touch(samples, count);
+}
+#endif
+
+#if CONFIG_IDF_TARGET_LINUX
+#if CONFIG_BSP_TOUCH_RECORD
+#define EXAMPLE_TRACE_MAX_SAMPLES   (100000)
+
+/* Lines "time_us,pressed,x,y", lines starting with '#' are skipped */
+static bsp_touch_sample_t *example_host_load_csv(const char *path, size_t *count)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return NULL;
+    }
+
+    bsp_touch_sample_t *samples = NULL;
+    size_t capacity = 0;
+    char line[64];
+    *count = 0;
+    while (fgets(line, sizeof(line), f) && *count < EXAMPLE_TRACE_MAX_SAMPLES) {
+        int64_t time_us;
+        int pressed, x, y;
+        if (line[0] == '#' || sscanf(line, "%"SCNd64",%d,%d,%d", &time_us, &pressed, &x, &y) != 4) {
+            continue;
+        }
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            bsp_touch_sample_t *grown = realloc(samples, capacity * sizeof(bsp_touch_sample_t));
+            if (grown == NULL) {
+                break;
+            }
+            samples = grown;
+        }
+        samples[(*count)++] = (bsp_touch_sample_t) {
+            .time_us = time_us,
+            .pressed = pressed != 0,
+            .x = x,
+            .y = y,
+            .count = pressed ? 1 : 0,
+            .points = {{.x = x, .y = y}},
+        };
+    }
+    fclose(f);
+    return samples;
+}
+
+static void example_host_replay_touch(void)
+{
+    const char *path = CONFIG_EXAMPLE_HOST_TOUCH_TRACE;
+    const size_t len = strlen(path);
+    bsp_touch_sample_t *samples = NULL;
+    size_t count = 0;
+
+    if (len > 4 && strcmp(&path[len - 4], ".csv") == 0) {
+        samples = example_host_load_csv(path, &count);
+    } else if (bsp_touch_record_load(path, &samples, &count) != ESP_OK) {
+        samples = NULL;
+    }
+    if (samples == NULL || count == 0) {
+        free(samples);
+        return;
+    }
+
+    /* Demo widgets are created at the end of the intro animation */
+    vTaskDelay(pdMS_TO_TICKS(1500));
+    example_replay_touch(samples, count);
+}
+#endif
+
+static void example_host_save_frames(void)
+{
+    const int64_t start = esp_timer_get_time();
+    const uint32_t start_frames = bsp_display_host_get_frame_count();
+
+    for (int i = 0; i < CONFIG_EXAMPLE_HOST_FRAMES; i++) {
+        char path[32];
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_EXAMPLE_HOST_FRAME_PERIOD_MS));
+        snprintf(path, sizeof(path), "frame_%04d.ppm", i);
+        ESP_ERROR_CHECK(bsp_display_host_save_ppm(path));
+    }
+
+    const int64_t elapsed = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "%"PRIu32" frames rendered in %"PRId64" ms", bsp_display_host_get_frame_count() - start_frames, elapsed / 1000);
+    exit(0);
+}
+#endif
+
 void app_main(void)
 {
-    bsp_display_start();
+    lv_disp_t *disp = bsp_display_start();
 
-    ESP_LOGI("example", "Display LVGL animation");
+    ESP_LOGI(TAG, "Display LVGL animation");
     bsp_display_lock(0);
+#if CONFIG_EXAMPLE_IMG_RLE
+    ESP_ERROR_CHECK(img_rle_init(CONFIG_EXAMPLE_IMG_RLE_CACHE_KB * 1024));
+#endif
     lv_obj_t *scr = lv_disp_get_scr_act(NULL);
     example_lvgl_demo_ui(scr);
+#if CONFIG_BSP_DISPLAY_LAYER_CACHE
+    lv_timer_t *stats_timer = lv_timer_create(example_layer_stats_cb, EXAMPLE_LAYER_STATS_DELAY_MS, NULL);
+    lv_timer_set_repeat_count(stats_timer, 1);
+#endif
 
     bsp_display_unlock();
     bsp_display_backlight_on();
+
+#if CONFIG_EXAMPLE_BLEND_BENCHMARK
+    /* Runs on its own screen, the demo is shown again afterwards */
+    example_blend_benchmark();
+#endif
+#if CONFIG_EXAMPLE_PARALLEL_BENCHMARK
+    example_parallel_benchmark();
+#endif
+
+    bsp_display_task_info_t task_info;
+    if (bsp_display_get_task_info(&task_info) == ESP_OK) {
+        ESP_LOGI(TAG, "LVGL task: core %d, priority %d, stack %"PRIu32" B, %"PRIu32" B never used",
+                 task_info.lvgl_core_id, task_info.lvgl_priority, task_info.lvgl_stack_size, task_info.lvgl_stack_free);
+    }
+
+#if CONFIG_EXAMPLE_TOUCH_RECORD
+    example_record_touch();
+#elif CONFIG_EXAMPLE_TOUCH_REPLAY
+    example_replay_touch_file();
+#elif CONFIG_IDF_TARGET_LINUX && CONFIG_BSP_TOUCH_RECORD
+    if (CONFIG_EXAMPLE_HOST_TOUCH_TRACE[0] != '\0') {
+        example_host_replay_touch();
+    }
+#endif
+
+#if CONFIG_EXAMPLE_ROTATION_BENCHMARK
+    example_rotation_benchmark(disp);
+#elif CONFIG_IDF_TARGET_LINUX && CONFIG_EXAMPLE_HOST_FRAMES > 0
+    (void)disp;
+    example_host_save_frames();
+#else
+    (void)disp;
+#endif
 }
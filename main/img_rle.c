@@ -0,0 +1,381 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+/*
+ * LVGL decoder of RLE compressed ARGB8565 images with an LRU cache of decoded images
+ *
+ * See tools/lv_img_rle.py for the format. Images are decoded whole into LV_IMG_CF_TRUE_COLOR_ALPHA,
+ * LVGL opens and closes the image on every draw, so the cache keeps it from being decoded again.
+ *
+ * LVGL 8 has no pre-multiplied image format, so pre-multiplied and flattened images are drawn by
+ * a draw_img hook of the display's draw context straight from the compressed data. Whenever the
+ * hook cannot draw them (transformation, masks...), the decoder un-premultiplies them instead.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#if CONFIG_SPIRAM
+#include "esp_heap_caps.h"
+#endif
+#include "img_rle.h"
+
+#define IMG_RLE_CACHE_ENTRIES   (16)
+#define IMG_RLE_PX_BYTES        (3)
+
+typedef struct {
+    const lv_img_dsc_t *src;    /* Compressed image, NULL for free entry */
+    uint8_t *px;                /* Decoded pixels */
+    size_t size;
+    uint32_t last_use;
+    uint16_t users;             /* Number of open decoder descriptors */
+} img_rle_entry_t;
+
+static const char *TAG = "img_rle";
+
+static img_rle_entry_t cache[IMG_RLE_CACHE_ENTRIES];
+static uint32_t use_tick;
+static img_rle_stats_t stats;
+static lv_res_t (*draw_img_next)(lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc_t *dsc, const lv_area_t *coords, const void *src);
+
+static inline bool img_rle_is_rle(const void *src)
+{
+    if (lv_img_src_get_type(src) != LV_IMG_SRC_VARIABLE) {
+        return false;
+    }
+    const lv_img_cf_t cf = ((const lv_img_dsc_t *)src)->header.cf;
+    return cf == IMG_RLE_CF || cf == IMG_RLE_CF_PREMUL || cf == IMG_RLE_CF_FLAT;
+}
+
+static void *img_rle_alloc(size_t size)
+{
+#if CONFIG_SPIRAM
+    void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (p) {
+        return p;
+    }
+#endif
+    return malloc(size);
+}
+
+static inline void img_rle_put_px(uint8_t *out, const uint8_t *in, bool premul)
+{
+    const uint16_t c = in[0] | (in[1] << 8);
+    const uint8_t r5 = (c >> 11) & 0x1F;
+    const uint8_t g6 = (c >> 5) & 0x3F;
+    const uint8_t b5 = c & 0x1F;
+    uint32_t r = (r5 << 3) | (r5 >> 2);
+    uint32_t g = (g6 << 2) | (g6 >> 4);
+    uint32_t b = (b5 << 3) | (b5 >> 2);
+
+    if (premul && in[2] > 0 && in[2] < 255) {
+        r = LV_MIN(255, r * 255 / in[2]);
+        g = LV_MIN(255, g * 255 / in[2]);
+        b = LV_MIN(255, b * 255 / in[2]);
+    }
+    const lv_color_t color = lv_color_make(r, g, b);
+
+    memcpy(out, &color, sizeof(lv_color_t));
+    out[LV_IMG_PX_SIZE_ALPHA_BYTE - 1] = in[2];
+}
+
+static bool img_rle_decode(const lv_img_dsc_t *dsc, uint8_t *out)
+{
+    const uint8_t *in = dsc->data;
+    const uint8_t *end = in + dsc->data_size;
+    uint32_t left = (uint32_t)dsc->header.w * dsc->header.h;
+    const bool premul = dsc->header.cf == IMG_RLE_CF_PREMUL;
+
+    while (left > 0 && in < end) {
+        const uint8_t head = *in++;
+        const bool run = (head & 0x80) != 0;
+        const uint32_t count = run ? (uint32_t)(head - 0x7F) : (head + 1U);
+        const size_t in_bytes = (run ? 1 : count) * IMG_RLE_PX_BYTES;
+
+        if (count > left || in_bytes > (size_t)(end - in)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            img_rle_put_px(out, run ? in : in + i * IMG_RLE_PX_BYTES, premul);
+            out += LV_IMG_PX_SIZE_ALPHA_BYTE;
+        }
+        in += in_bytes;
+        left -= count;
+    }
+    return left == 0;
+}
+
+static img_rle_entry_t *img_rle_find(const lv_img_dsc_t *src)
+{
+    for (int i = 0; i < IMG_RLE_CACHE_ENTRIES; i++) {
+        if (cache[i].src == src) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+/* Evict least recently used images until size bytes and one entry are free, returns the free entry */
+static img_rle_entry_t *img_rle_make_room(size_t size)
+{
+    if (size > stats.size) {
+        return NULL;
+    }
+
+    while (true) {
+        img_rle_entry_t *free_entry = NULL;
+        img_rle_entry_t *lru = NULL;
+        for (int i = 0; i < IMG_RLE_CACHE_ENTRIES; i++) {
+            if (cache[i].src == NULL) {
+                free_entry = &cache[i];
+            } else if (cache[i].users == 0 && (lru == NULL || (int32_t)(cache[i].last_use - lru->last_use) < 0)) {
+                lru = &cache[i];
+            }
+        }
+        if (free_entry && stats.used + size <= stats.size) {
+            return free_entry;
+        }
+        if (lru == NULL) {
+            /* Everything left is in use */
+            return NULL;
+        }
+        free(lru->px);
+        stats.used -= lru->size;
+        stats.evictions++;
+        memset(lru, 0, sizeof(img_rle_entry_t));
+    }
+}
+
+static lv_res_t img_rle_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+    if (!img_rle_is_rle(src)) {
+        return LV_RES_INV;
+    }
+    *header = ((const lv_img_dsc_t *)src)->header;
+    header->cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+    return LV_RES_OK;
+}
+
+static lv_res_t img_rle_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    if (!img_rle_is_rle(dsc->src)) {
+        return LV_RES_INV;
+    }
+    const lv_img_dsc_t *src = dsc->src;
+
+    img_rle_entry_t *entry = img_rle_find(src);
+    if (entry) {
+        stats.hits++;
+        entry->users++;
+        entry->last_use = ++use_tick;
+        dsc->img_data = entry->px;
+        return LV_RES_OK;
+    }
+
+    stats.misses++;
+    const size_t size = (size_t)src->header.w * src->header.h * LV_IMG_PX_SIZE_ALPHA_BYTE;
+    uint8_t *px = img_rle_alloc(size);
+    if (px == NULL) {
+        ESP_LOGE(TAG, "Not enough memory for %dx%d image", src->header.w, src->header.h);
+        return LV_RES_INV;
+    }
+    if (!img_rle_decode(src, px)) {
+        ESP_LOGE(TAG, "Corrupted image %p", src);
+        free(px);
+        return LV_RES_INV;
+    }
+
+    entry = img_rle_make_room(size);
+    if (entry == NULL) {
+        /* Does not fit, decoded again on every draw */
+        ESP_LOGD(TAG, "Image %p not cached", src);
+        dsc->user_data = px;
+    } else {
+        entry->src = src;
+        entry->px = px;
+        entry->size = size;
+        entry->users = 1;
+        entry->last_use = ++use_tick;
+        stats.used += size;
+    }
+    dsc->img_data = px;
+    return LV_RES_OK;
+}
+
+static void img_rle_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    if (dsc->user_data) {
+        free(dsc->user_data);
+        dsc->user_data = NULL;
+        return;
+    }
+    img_rle_entry_t *entry = img_rle_find(dsc->src);
+    if (entry && entry->users > 0) {
+        entry->users--;
+    }
+}
+
+#if LV_COLOR_DEPTH == 16
+/* RGB565 of the images to lv_color_t and back */
+static inline uint16_t img_rle_native(uint16_t c)
+{
+#if LV_COLOR_16_SWAP
+    return (c >> 8) | (c << 8);
+#else
+    return c;
+#endif
+}
+
+/* src + dst * (255 - a) / 255 per RGB565 channel */
+static inline uint16_t img_rle_blend_premul(uint16_t dst, uint16_t src, uint8_t a)
+{
+    const uint32_t inv = 255 - a;
+    const uint32_t r = ((src >> 11) & 0x1F) + LV_UDIV255(((dst >> 11) & 0x1F) * inv + 127);
+    const uint32_t g = ((src >> 5) & 0x3F) + LV_UDIV255(((dst >> 5) & 0x3F) * inv + 127);
+    const uint32_t b = (src & 0x1F) + LV_UDIV255((dst & 0x1F) * inv + 127);
+
+    return (LV_MIN(r, 0x1F) << 11) | (LV_MIN(g, 0x3F) << 5) | LV_MIN(b, 0x1F);
+}
+
+static void img_rle_blend_span(lv_color_t *dst, const uint8_t *src, int32_t len, bool run)
+{
+    const uint8_t a = src[2];
+
+    if (run && a == 255) {
+        const uint16_t c = img_rle_native(src[0] | (src[1] << 8));
+        for (int32_t i = 0; i < len; i++) {
+            dst[i].full = c;
+        }
+        return;
+    }
+    for (int32_t i = 0; i < len; i++, src += run ? 0 : IMG_RLE_PX_BYTES) {
+        const uint16_t c = src[0] | (src[1] << 8);
+        if (src[2] == 255) {
+            dst[i].full = img_rle_native(c);
+        } else if (src[2] > 0) {
+            dst[i].full = img_rle_native(img_rle_blend_premul(img_rle_native(dst[i].full), c, src[2]));
+        }
+    }
+}
+
+/* Draw the clipped part of the image straight from the compressed data into the draw buffer */
+static void img_rle_draw_direct(lv_draw_ctx_t *draw_ctx, const lv_img_dsc_t *img, const lv_area_t *coords, const lv_area_t *clip)
+{
+    const int32_t w = img->header.w;
+    const int32_t clip_x1 = clip->x1 - coords->x1;
+    const int32_t clip_x2 = clip->x2 - coords->x1;
+    const uint32_t first = (uint32_t)(clip->y1 - coords->y1) * w;
+    const uint32_t last = (uint32_t)(clip->y2 - coords->y1 + 1) * w;
+    const lv_coord_t buf_w = lv_area_get_width(draw_ctx->buf_area);
+    lv_color_t *buf = draw_ctx->buf;
+    const uint8_t *in = img->data;
+    const uint8_t *end = in + img->data_size;
+    uint32_t p = 0;
+
+    while (p < last && in < end) {
+        const uint8_t head = *in++;
+        const bool run = (head & 0x80) != 0;
+        uint32_t count = run ? (uint32_t)(head - 0x7F) : (head + 1U);
+        const uint8_t *px = in;
+        const size_t in_bytes = (run ? 1 : count) * IMG_RLE_PX_BYTES;
+
+        if (in_bytes > (size_t)(end - in)) {
+            return;
+        }
+        in += in_bytes;
+        if (p + count <= first || (run && px[2] == 0)) {
+            p += count;
+            continue;
+        }
+
+        /* Split the packet at row ends */
+        while (count > 0 && p < last) {
+            const int32_t y = p / w;
+            const int32_t x = p % w;
+            const int32_t seg = LV_MIN((int32_t)count, w - x);
+            const int32_t x1 = LV_MAX(x, clip_x1);
+            const int32_t x2 = LV_MIN(x + seg - 1, clip_x2);
+
+            if (p >= first && x1 <= x2) {
+                lv_color_t *dst = buf + (coords->y1 + y - draw_ctx->buf_area->y1) * buf_w + coords->x1 + x1 - draw_ctx->buf_area->x1;
+                img_rle_blend_span(dst, run ? px : px + (x1 - x) * IMG_RLE_PX_BYTES, x2 - x1 + 1, run);
+            }
+            p += seg;
+            count -= seg;
+            if (!run) {
+                px += seg * IMG_RLE_PX_BYTES;
+            }
+        }
+    }
+}
+
+static lv_res_t img_rle_draw_img(lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc_t *dsc, const lv_area_t *coords, const void *src)
+{
+    if (!img_rle_is_rle(src)) {
+        goto next;
+    }
+    const lv_img_dsc_t *img = src;
+    if (img->header.cf == IMG_RLE_CF ||
+            dsc->angle != 0 || dsc->zoom != LV_IMG_ZOOM_NONE || dsc->recolor_opa > LV_OPA_MIN ||
+            dsc->opa < LV_OPA_MAX || dsc->blend_mode != LV_BLEND_MODE_NORMAL ||
+            lv_area_get_width(coords) != img->header.w || lv_area_get_height(coords) != img->header.h) {
+        goto next;
+    }
+#if LV_DRAW_COMPLEX
+    if (lv_draw_mask_is_any(coords)) {
+        goto next;
+    }
+#endif
+    /* Layers of widgets with opacity or transformation have ARGB buffers, direct drawing writes only lv_color_t */
+    const lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    if (disp == NULL || disp->driver->screen_transp) {
+        goto next;
+    }
+
+    lv_area_t clip;
+    if (_lv_area_intersect(&clip, coords, draw_ctx->clip_area)) {
+        img_rle_draw_direct(draw_ctx, img, coords, &clip);
+    }
+    stats.direct_draws++;
+    return LV_RES_OK;
+
+next:
+    /* LV_RES_INV makes LVGL decode and blend the image */
+    return draw_img_next ? draw_img_next(draw_ctx, dsc, coords, src) : LV_RES_INV;
+}
+#endif // LV_COLOR_DEPTH == 16
+
+esp_err_t img_rle_init(size_t cache_size)
+{
+#if LV_COLOR_DEPTH == 16
+    lv_disp_t *disp = lv_disp_get_default();
+    if (disp == NULL || disp->driver->draw_ctx == NULL) {
+        ESP_LOGE(TAG, "No display, initialize the display first");
+        return ESP_ERR_INVALID_STATE;
+    }
+#endif
+
+    lv_img_decoder_t *decoder = lv_img_decoder_create();
+    if (decoder == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    lv_img_decoder_set_info_cb(decoder, img_rle_info);
+    lv_img_decoder_set_open_cb(decoder, img_rle_open);
+    lv_img_decoder_set_close_cb(decoder, img_rle_close);
+    stats.size = cache_size;
+
+#if LV_COLOR_DEPTH == 16
+    draw_img_next = disp->driver->draw_ctx->draw_img;
+    disp->driver->draw_ctx->draw_img = img_rle_draw_img;
+#endif
+    return ESP_OK;
+}
+
+void img_rle_get_stats(img_rle_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include "lvgl.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Color formats of images generated by tools/lv_img_rle.py */
+#define IMG_RLE_CF          LV_IMG_CF_USER_ENCODED_0    /* Straight alpha */
+#define IMG_RLE_CF_PREMUL   LV_IMG_CF_USER_ENCODED_1    /* Colors multiplied by alpha (--premultiply) */
+#define IMG_RLE_CF_FLAT     LV_IMG_CF_USER_ENCODED_2    /* Flattened onto a known background, alpha 0 or 255 (--flatten) */
+
+/**
+ * @brief Statistics of the decoded image cache
+ */
+typedef struct {
+    uint32_t hits;          /*!< Images served from the cache */
+    uint32_t misses;        /*!< Images decoded */
+    uint32_t evictions;     /*!< Images evicted to make room for others */
+    uint32_t direct_draws;  /*!< Pre-multiplied or flattened images drawn straight from the compressed data */
+    size_t   used;          /*!< Bytes of decoded pixels in the cache */
+    size_t   size;          /*!< Cache size in bytes */
+} img_rle_stats_t;
+
+/**
+ * @brief Register LVGL decoder of RLE compressed images
+ *
+ * Decoded pixels are kept in a cache in PSRAM (internal RAM without PSRAM), least recently used
+ * images are evicted when it is full.
+ *
+ * Pre-multiplied (IMG_RLE_CF_PREMUL) and flattened (IMG_RLE_CF_FLAT) images drawn without
+ * transformation, recolor, opacity and masks skip the decoder and LVGL's alpha blending:
+ * transparent runs are skipped, opaque runs are filled and copied, the rest is blended as
+ * dst = src + dst * (255 - alpha). Images inside layers with alpha, such as children of widgets
+ * with style opacity or transformation, are decoded and blended by LVGL.
+ * The default display must be registered already. Must be called with LVGL mutex taken.
+ *
+ * @param[in] cache_size Cache size in bytes
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_STATE No default display
+ *      - ESP_ERR_NO_MEM        Decoder could not be registered
+ */
+esp_err_t img_rle_init(size_t cache_size);
+
+/**
+ * @brief Get statistics of the decoded image cache
+ *
+ * Must be called with LVGL mutex taken.
+ *
+ * @param[out] stats Cache statistics
+ */
+void img_rle_get_stats(img_rle_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,12 +1,18 @@
-#include <math.h>
 #include "lvgl.h"
 #include "esp_err.h"
 
+#include "bsp/esp-bsp.h"
 #include "bsp/display.h"
 
-#ifndef PI
-#define PI  (3.14159f)
-#endif
+/*
+ * Intro animation is evaluated from the time elapsed since its start, so late frames skip ahead
+ * instead of slowing it down. Phase is in 1/16 degree: it goes from -90 to 220 degrees in 1240 ms.
+ */
+#define INTRO_PHASE_FRAC        (4)
+#define INTRO_PHASE(deg)        ((deg) * (1 << INTRO_PHASE_FRAC))
+#define INTRO_PHASE_PER_MS      (4)     /* 1/4 degree per ms */
+#define INTRO_ARCS_END          INTRO_PHASE(90)
+#define INTRO_END               INTRO_PHASE(220)
 
 // LVGL image declare
 LV_IMG_DECLARE(esp_logo);
@@ -14,9 +20,23 @@ LV_IMG_DECLARE(esp_text);
 
 typedef struct {
     lv_obj_t *scr;
-    int count_val;
+    uint32_t start_ms;
+    int32_t last_phase;
+    bool arcs_done;
 } my_timer_context_t;
 
+/* Easing curve sampled once per degree, evaluated with linear interpolation */
+typedef struct {
+    int16_t *lut;
+    int32_t first_deg;
+    int32_t last_deg;
+} anim_curve_t;
+
+static int16_t arc_start_lut[91];   /* (1 - cos(x)) * 270 for x in [0, 90] */
+static int16_t arc_len_lut[181];    /* (sin(x) + 1) * 135 for x in [-90, 90] */
+static const anim_curve_t arc_start_curve = {arc_start_lut, 0, 90};
+static const anim_curve_t arc_len_curve = {arc_len_lut, -90, 90};
+
 static lv_obj_t *arc[3];
 static lv_obj_t *img_logo;
 static lv_obj_t *img_text;
@@ -29,6 +49,15 @@ static lv_color_t arc_color[] = {
     LV_COLOR_MAKE(90, 202, 228),
 };
 
+#if CONFIG_EXAMPLE_GESTURE_CHART
+#define CHART_POINTS            (120)
+#define CHART_ZOOM_MAX          (LV_IMG_ZOOM_NONE * 8)
+
+static lv_obj_t *chart;
+static lv_chart_series_t *chart_series;
+static uint16_t chart_pinch_zoom; // Zoom when the pinch began
+#endif
+
 static void slider_event_handler(lv_event_t *e) {
     lv_obj_t *slider = lv_event_get_target(e);
     char buf[16];
@@ -36,8 +65,60 @@ static void slider_event_handler(lv_event_t *e) {
     snprintf(buf, sizeof(buf), "Teplota: %d°C", value);
     lv_label_set_text(label_value, buf);
     lv_obj_align(label_value, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+#if CONFIG_EXAMPLE_GESTURE_CHART
+    // Plotted only on changes, a periodic timer would keep the display busy while idle
+    if (chart) {
+        lv_chart_set_next_value(chart, chart_series, value);
+    }
+#endif
+}
+
+#if CONFIG_EXAMPLE_GESTURE_CHART
+// Temperature history, the horizontal axis is zoomed by pinching and scrolled with one finger
+static void chart_gesture_handler(lv_event_t *e) {
+    const bsp_touch_gesture_t *gesture = lv_event_get_param(e);
+    if (gesture->type != BSP_TOUCH_GESTURE_PINCH) {
+        return;
+    }
+
+    const uint16_t old_zoom = lv_chart_get_zoom_x(chart);
+    if (gesture->phase == BSP_TOUCH_GESTURE_BEGIN) {
+        chart_pinch_zoom = old_zoom;
+    }
+    const int32_t zoom = LV_CLAMP(LV_IMG_ZOOM_NONE, (int32_t)(chart_pinch_zoom * gesture->scale), CHART_ZOOM_MAX);
+    if (zoom == old_zoom) {
+        return;
+    }
+
+    // Keep the data under the centre of the fingers in place
+    lv_area_t content;
+    lv_obj_get_content_coords(chart, &content);
+    const int32_t cx = gesture->x - content.x1;
+    const int32_t scroll_x = (lv_obj_get_scroll_x(chart) + cx) * zoom / old_zoom - cx;
+    lv_chart_set_zoom_x(chart, zoom);
+    lv_obj_scroll_to_x(chart, LV_MAX(scroll_x, 0), LV_ANIM_OFF);
 }
 
+static void chart_create(lv_obj_t *scr) {
+    lv_event_code_t gesture_event;
+    if (bsp_touch_get_gesture_event(&gesture_event) != ESP_OK) {
+        return;
+    }
+
+    chart = lv_chart_create(scr);
+    lv_obj_set_size(chart, 180, 50);
+    lv_obj_align(chart, LV_ALIGN_TOP_LEFT, 5, 5);
+    lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
+    lv_chart_set_point_count(chart, CHART_POINTS);
+    lv_chart_set_range(chart, LV_CHART_AXIS_PRIMARY_Y, -20, 40);
+    lv_chart_set_div_line_count(chart, 3, 0);
+    lv_obj_set_style_size(chart, 0, LV_PART_INDICATOR);
+    chart_series = lv_chart_add_series(chart, lv_palette_main(LV_PALETTE_RED), LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_all_value(chart, chart_series, lv_slider_get_value(slider));
+    lv_obj_add_event_cb(chart, chart_gesture_handler, gesture_event, NULL);
+}
+#endif
+
 // Slider for screen brightness adjustment
 static void brightness_slider_event_handler(lv_event_t *e) {
     lv_obj_t *slider = lv_event_get_target(e);
@@ -115,24 +196,58 @@ void start_battery_update_timer(lv_obj_t *battery_label) {
 // Make sure to call `start_battery_update_timer` after creating the battery label in your UI setup
 
 
+// Fixed-point tables from LVGL's sine table, no libm at runtime
+static void anim_curves_init(void) {
+    for (int deg = 0; deg <= 90; deg++) {
+        arc_start_lut[deg] = (270 * (LV_TRIGO_SIN_MAX - lv_trigo_cos(deg)) + (1 << (LV_TRIGO_SHIFT - 1))) >> LV_TRIGO_SHIFT;
+    }
+    for (int deg = -90; deg <= 90; deg++) {
+        arc_len_lut[deg + 90] = (135 * (lv_trigo_sin(deg) + LV_TRIGO_SIN_MAX) + (1 << (LV_TRIGO_SHIFT - 1))) >> LV_TRIGO_SHIFT;
+    }
+}
+
+static int32_t anim_curve_eval(const anim_curve_t *curve, int32_t phase) {
+    if (phase <= INTRO_PHASE(curve->first_deg)) {
+        return curve->lut[0];
+    }
+    if (phase >= INTRO_PHASE(curve->last_deg)) {
+        return curve->lut[curve->last_deg - curve->first_deg];
+    }
+    const int32_t idx = (phase >> INTRO_PHASE_FRAC) - curve->first_deg;
+    const int32_t frac = phase & ((1 << INTRO_PHASE_FRAC) - 1);
+    return curve->lut[idx] + (((curve->lut[idx + 1] - curve->lut[idx]) * frac) >> INTRO_PHASE_FRAC);
+}
+
+// Update all arcs with one invalidation, they are concentric and arc[0] is the largest
+static void anim_arcs_update(int32_t phase) {
+    lv_disp_t *disp = lv_obj_get_disp(arc[0]);
+    const lv_coord_t arc_start = anim_curve_eval(&arc_start_curve, phase);
+    const lv_coord_t arc_len = anim_curve_eval(&arc_len_curve, phase);
+    const int32_t rotation = phase >> INTRO_PHASE_FRAC;
+
+    lv_disp_enable_invalidation(disp, false);
+    for (size_t i = 0; i < sizeof(arc) / sizeof(arc[0]); i++) {
+        lv_arc_set_bg_angles(arc[i], arc_start, arc_len);
+        lv_arc_set_rotation(arc[i], (rotation + 120 * (i + 1) + 360) % 360);
+    }
+    lv_disp_enable_invalidation(disp, true);
+    lv_obj_invalidate(arc[0]);
+}
+
 static void anim_timer_cb(lv_timer_t *timer) {
     my_timer_context_t *timer_ctx = (my_timer_context_t *) timer->user_data;
-    int count = timer_ctx->count_val;
+    const int32_t phase = INTRO_PHASE(-90) + (int32_t)lv_tick_elaps(timer_ctx->start_ms) * INTRO_PHASE_PER_MS;
     lv_obj_t *scr = timer_ctx->scr;
 
     // Play arc animation
-    if (count < 90) {
-        lv_coord_t arc_start = count > 0 ? (1 - cosf(count / 180.0f * PI)) * 270 : 0;
-        lv_coord_t arc_len = (sinf(count / 180.0f * PI) + 1) * 135;
-
-        for (size_t i = 0; i < sizeof(arc) / sizeof(arc[0]); i++) {
-            lv_arc_set_bg_angles(arc[i], arc_start, arc_len);
-            lv_arc_set_rotation(arc[i], (count + 120 * (i + 1)) % 360);
-        }
+    if (phase < INTRO_ARCS_END && phase != timer_ctx->last_phase) {
+        anim_arcs_update(phase);
+        timer_ctx->last_phase = phase;
     }
 
     // Delete arcs and create rotary knob when animation finished
-    if (count == 90) {
+    if (phase >= INTRO_ARCS_END && !timer_ctx->arcs_done) {
+        timer_ctx->arcs_done = true;
         for (size_t i = 0; i < sizeof(arc) / sizeof(arc[0]); i++) {
             lv_obj_del(arc[i]);
         }
@@ -157,6 +272,9 @@ static void anim_timer_cb(lv_timer_t *timer) {
 
         // Add event callback to the slider
         lv_obj_add_event_cb(slider, slider_event_handler, LV_EVENT_VALUE_CHANGED, NULL);
+#if CONFIG_EXAMPLE_GESTURE_CHART
+        chart_create(scr);
+#endif
 
         // Vertical slider for screen brightness adjustment
         lv_obj_t *slider2 = lv_slider_create(scr);
@@ -181,10 +299,8 @@ static void anim_timer_cb(lv_timer_t *timer) {
 
 
     // Delete timer when all animation finished
-    if ((count += 5) == 220) {
+    if (phase >= INTRO_END) {
         lv_timer_del(timer);
-    } else {
-        timer_ctx->count_val = count;
     }
 }
 
@@ -193,6 +309,12 @@ void example_lvgl_demo_ui(lv_obj_t *scr) {
     img_logo = lv_img_create(scr);
     lv_img_set_src(img_logo, &esp_logo);
     lv_obj_center(img_logo);
+#if !CONFIG_EXAMPLE_LOGO_PREMULTIPLIED && !CONFIG_EXAMPLE_LOGO_FLATTENED
+    // Arcs animate over the logo, redraws under them come from a snapshot without the image decoder.
+    // The logo is composited onto the screen background, so the snapshot is opaque and copied without blending.
+    // Pre-multiplied and flattened logos are drawn directly from their data, a snapshot would not be faster.
+    bsp_display_layer_cache(img_logo);
+#endif
 
     // Create arcs
     for (size_t i = 0; i < sizeof(arc) / sizeof(arc[0]); i++) {
@@ -207,9 +329,11 @@ void example_lvgl_demo_ui(lv_obj_t *scr) {
     }
 
     // Create timer for animation
-    static my_timer_context_t my_tim_ctx = {
-        .count_val = -90,
-    };
+    static my_timer_context_t my_tim_ctx;
+    anim_curves_init();
     my_tim_ctx.scr = scr;
+    my_tim_ctx.start_ms = lv_tick_get();
+    my_tim_ctx.last_phase = INT32_MIN;
+    my_tim_ctx.arcs_done = false;
     lv_timer_create(anim_timer_cb, 20, &my_tim_ctx);
 }
@@ -0,0 +1,168 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: CC0-1.0
+#
+# Convert an image to the RLE compressed ARGB8565 format decoded by img_rle.c
+#
+# Input is either an LVGL image C file in LV_IMG_CF_TRUE_COLOR_ALPHA format (its 16-bit, not swapped
+# section is used) or a PNG file (requires Pillow). Output is a C file defining an lv_img_dsc_t of
+# color format IMG_RLE_CF with the same name as the input image.
+#
+# Pixels are 3 bytes: RGB565 little endian and 8-bit alpha. Color of fully transparent pixels is dropped.
+# Packets start with one byte n: n >= 0x80 is a run of (n - 0x7F) copies of the following pixel,
+# n < 0x80 is followed by n + 1 literal pixels.
+#
+# Variants, which img_rle.c draws without LVGL's per pixel alpha blending:
+#  --premultiply       colors are multiplied by alpha (IMG_RLE_CF_PREMUL)
+#  --flatten RRGGBB    semi-transparent pixels are blended onto a known background color and become
+#                      opaque, alpha is either 0 or 255 (IMG_RLE_CF_FLAT)
+
+import argparse
+import os
+import re
+import sys
+
+MAX_PACKET = 128
+
+
+def read_lvgl_c(path):
+    with open(path, 'r') as f:
+        src = f.read()
+    section = re.search(r'#if LV_COLOR_DEPTH == 16 && LV_COLOR_16_SWAP == 0\n(.*?)#endif', src, re.S)
+    w = re.search(r'\.header\.w\s*=\s*(\d+)', src)
+    h = re.search(r'\.header\.h\s*=\s*(\d+)', src)
+    name = re.search(r'const\s+lv_img_dsc_t\s+(\w+)\s*=', src)
+    if not (section and w and h and name):
+        sys.exit('{}: not an LVGL true color alpha image'.format(path))
+    data = bytes(int(b, 16) for b in re.findall(r'0x([0-9a-fA-F]{2})', re.sub(r'/\*.*?\*/', '', section.group(1), flags=re.S)))
+    w, h = int(w.group(1)), int(h.group(1))
+    if len(data) != w * h * 3:
+        sys.exit('{}: expected {} bytes of pixel data, found {}'.format(path, w * h * 3, len(data)))
+    return name.group(1), w, h, [data[i:i + 3] for i in range(0, len(data), 3)]
+
+
+def read_png(path):
+    from PIL import Image
+    img = Image.open(path).convert('RGBA')
+    pixels = [pack565(r, g, b, a) for r, g, b, a in img.getdata()]
+    name = re.sub(r'\W', '_', os.path.splitext(os.path.basename(path))[0])
+    return name, img.width, img.height, pixels
+
+
+def unpack565(p):
+    c = p[0] | (p[1] << 8)
+    r, g, b = (c >> 11) & 0x1F, (c >> 5) & 0x3F, c & 0x1F
+    return (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)
+
+
+def pack565(r, g, b, a):
+    c = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+    return bytes((c & 0xFF, c >> 8, a))
+
+
+def premultiply(pixels):
+    out = []
+    for p in pixels:
+        r, g, b = unpack565(p)
+        a = p[2]
+        out.append(pack565((r * a + 127) // 255, (g * a + 127) // 255, (b * a + 127) // 255, a))
+    return out
+
+
+def flatten(pixels, bg):
+    bg_r, bg_g, bg_b = (bg >> 16) & 0xFF, (bg >> 8) & 0xFF, bg & 0xFF
+    out = []
+    for p in pixels:
+        r, g, b = unpack565(p)
+        a = p[2]
+        if a == 0:
+            out.append(p)
+            continue
+        out.append(pack565((r * a + bg_r * (255 - a) + 127) // 255,
+                           (g * a + bg_g * (255 - a) + 127) // 255,
+                           (b * a + bg_b * (255 - a) + 127) // 255, 255))
+    return out
+
+
+def encode(pixels):
+    pixels = [p if p[2] else b'\x00\x00\x00' for p in pixels]
+    out = bytearray()
+    literal = []
+
+    def flush_literal():
+        while literal:
+            chunk = literal[:MAX_PACKET]
+            del literal[:MAX_PACKET]
+            out.append(len(chunk) - 1)
+            for p in chunk:
+                out.extend(p)
+
+    i = 0
+    while i < len(pixels):
+        run = 1
+        while i + run < len(pixels) and run < MAX_PACKET and pixels[i + run] == pixels[i]:
+            run += 1
+        # Run of two pixels costs the same as two literals, but breaks a literal packet
+        if run >= 3 or (run == 2 and not literal):
+            flush_literal()
+            out.append(0x7F + run)
+            out += pixels[i]
+        else:
+            literal.extend(pixels[i:i + run])
+        i += run
+    flush_literal()
+    return bytes(out)
+
+
+def write_c(path, name, w, h, cf, data):
+    lines = []
+    for i in range(0, len(data), 24):
+        lines.append('    ' + ', '.join('0x{:02x}'.format(b) for b in data[i:i + 24]) + ',')
+    with open(path, 'w') as f:
+        f.write('/* Generated by lv_img_rle.py, do not edit */\n')
+        f.write('#include "lvgl.h"\n#include "img_rle.h"\n\n')
+        f.write('static const LV_ATTRIBUTE_LARGE_CONST uint8_t {}_rle[] = {{\n'.format(name))
+        f.write('\n'.join(lines))
+        f.write('\n};\n\n')
+        f.write('const lv_img_dsc_t {} = {{\n'.format(name))
+        f.write('    .header.always_zero = 0,\n')
+        f.write('    .header.w = {},\n'.format(w))
+        f.write('    .header.h = {},\n'.format(h))
+        f.write('    .data_size = sizeof({}_rle),\n'.format(name))
+        f.write('    .header.cf = {},\n'.format(cf))
+        f.write('    .data = {}_rle,\n'.format(name))
+        f.write('};\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert an image to RLE compressed ARGB8565")
+    parser.add_argument('input', help='LVGL image C file or PNG file')
+    parser.add_argument('output', help='Generated C file')
+    parser.add_argument('--name', help='Name of the image, name of the input image by default')
+    variant = parser.add_mutually_exclusive_group()
+    variant.add_argument('--premultiply', action='store_true', help='Multiply colors by alpha')
+    variant.add_argument('--flatten', metavar='RRGGBB', help='Blend semi-transparent pixels onto this background color')
+    args = parser.parse_args()
+
+    if args.input.lower().endswith('.png'):
+        name, w, h, pixels = read_png(args.input)
+    else:
+        name, w, h, pixels = read_lvgl_c(args.input)
+    name = args.name or name
+
+    cf = 'IMG_RLE_CF'
+    if args.premultiply:
+        pixels = premultiply(pixels)
+        cf = 'IMG_RLE_CF_PREMUL'
+    elif args.flatten:
+        pixels = flatten(pixels, int(args.flatten, 16))
+        cf = 'IMG_RLE_CF_FLAT'
+    data = encode(pixels)
+    write_c(args.output, name, w, h, cf, data)
+    print('{}: {}x{}, {} -> {} bytes'.format(name, w, h, w * h * 3, len(data)))
+
+
+if __name__ == '__main__':
+    main()